@@ -0,0 +1,99 @@
+// ArenaBench.cpp : builds and destroys the same skeleton over and over, the
+// way a tool going through many files does, and checks that the resident set
+// stays flat.  The links and bone geometry come from each skeleton's arena.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+//resident set size of the process in bytes, 0 where it can't be read
+static size_t ResidentBytes()
+{
+#if defined(__linux__)
+	FILE* f = fopen("/proc/self/statm", "r");
+	if (f == NULL)
+	{
+		return 0;
+	}
+	long pages = 0, resident = 0;
+	int read = fscanf(f, "%ld %ld", &pages, &resident);
+	fclose(f);
+	return read == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+	return 0;
+#endif
+}
+
+int RunArenaBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int iterations = argc > 1 ? atoi(argv[1]) : 10000;
+	if (iterations < 2) iterations = 2;
+
+	std::string text;
+	if (!BenchReadFile(src, text))
+	{
+		fprintf(stderr, "could not read %s\n", src.c_str());
+		return 1;
+	}
+	const char* begin = text.data();
+	const char* end = begin + text.size();
+
+	//the first tenth warms up the heap, after that nothing should grow
+	int warmup = iterations / 10;
+	size_t warmRss = 0, endRss = 0;
+	ArenaStats stats = {};
+	int numLinks = 0;
+	bool loaded = true;
+	BenchTimer timer;
+	double warmMs = 0;
+	for (int i = 0; i < iterations; i++)
+	{
+		if (i == warmup)
+		{
+			warmRss = ResidentBytes();
+			warmMs = timer.ElapsedMs();
+		}
+		BenchQuiet quiet;
+		Skeleton skel;
+		AnimRec rec;
+		BVHReader reader;
+		int numFrames = 0;
+		loaded = loaded && reader.BuildSkelFromBufferHeader(begin, end, &skel, &rec, false, &numFrames) != NULL;
+		skel.AddGeometry();
+		stats = skel.GetMemoryStats();
+		numLinks = skel.GetNumLinks();
+	}
+	double perLoadUs = (timer.ElapsedMs() - warmMs) * 1000.0 / (iterations - warmup);
+	endRss = ResidentBytes();
+
+	printf("file: %s, skeleton of %d links built and destroyed %d times\n", src.c_str(), numLinks, iterations);
+	printf("  build + AddGeometry + destroy  %8.2f us\n", perLoadUs);
+	printf("  arena per skeleton: %zu allocations in %zu blocks, %.1f KB used of %.1f KB, peak %.1f KB\n",
+		stats.numAllocations, stats.numBlocks, stats.bytesUsed / 1024.0, stats.bytesReserved / 1024.0, stats.peakBytes / 1024.0);
+	bool flat = true;
+	if (warmRss != 0 && endRss != 0)
+	{
+		long long growth = (long long)endRss - (long long)warmRss;
+		flat = growth < 256 * 1024;
+		printf("  resident after %d: %.1f MB, after %d: %.1f MB, growth %lld KB\n",
+			warmup, warmRss / (1024.0 * 1024.0), iterations, endRss / (1024.0 * 1024.0), growth / 1024);
+	}
+	else
+	{
+		printf("  resident set size not available on this platform\n");
+	}
+	bool ok = loaded && flat && stats.numBlocks > 0;
+	printf("  flat memory: %s\n", ok ? "yes" : "NO");
+	return ok ? 0 : 1;
+}
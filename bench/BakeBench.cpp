@@ -0,0 +1,126 @@
+// BakeBench.cpp : world transforms for every frame of a long take, the
+// single threaded link loop vs Skeleton::BakeClip on 1..N threads.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "Link.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+//Every task of a badly unbalanced job must run exactly once, on a valid thread
+static bool CheckStealing(ThreadPool& pool)
+{
+	const int numTasks = 5000;
+	std::vector<std::atomic<int> > runs(numTasks);
+	for (int i = 0; i < numTasks; i++) runs[i] = 0;
+	std::atomic<int> badThread(0);
+	std::atomic<unsigned> sink(0);
+
+	pool.RunWithThreadIndex(numTasks, [&](int task, int thread)
+	{
+		if (thread < 0 || thread >= pool.GetNumThreads()) badThread++;
+		//the first tenth of the tasks is far more expensive than the rest
+		unsigned v = task;
+		for (int i = 0; i < (task < numTasks / 10 ? 20000 : 10); i++) v = v * 1664525u + 1013904223u;
+		sink += v;
+		runs[task]++;
+	});
+
+	for (int i = 0; i < numTasks; i++)
+	{
+		if (runs[i] != 1) return false;
+	}
+	return badThread == 0;
+}
+
+int RunBakeBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int scale = argc > 1 ? atoi(argv[1]) : 20;
+	if (scale < 1) scale = 1;
+
+	std::string scaled = "bvh_bench_scaled.bvh";
+	if (BenchWriteScaledBVH(src, scaled, scale) == 0)
+	{
+		fprintf(stderr, "could not read %s\n", src.c_str());
+		return 1;
+	}
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		reader.BuildSkelFromFile(scaled.c_str(), &skel, &rec, false);
+	}
+	remove(scaled.c_str());
+
+	int numFrames = rec.GetNumFrames();
+	int numJoints = skel.GetNumLinks();
+	std::vector<mat4x4> out((size_t)numFrames * numJoints);
+
+	//what a caller had to do before: pose the links frame by frame and read
+	//the matrices (and the bone vertices) back out
+	double loopMs;
+	{
+		skel.AddGeometry();
+		std::vector<double> state(rec.GetNumDOFs() > 6 ? rec.GetNumDOFs() : 6);
+		int maxEntries = skel.GetNumVertices();
+		VERTEX* verts = new VERTEX[maxEntries];
+		BenchTimer timer;
+		for (int f = 0; f < numFrames; f++)
+		{
+			rec.GetFrame(f, state.data());
+			skel.SetSkelState(state.data());
+			skel.UpdateLinks();
+			int vertCount = 0;
+			skel.CalcVertexLocations(maxEntries, &vertCount, &verts);
+			for (int j = 0; j < numJoints; j++)
+			{
+				skel.GetLink(j)->GetLToWTransMat(out[(size_t)f * numJoints + j]);
+			}
+		}
+		loopMs = timer.ElapsedMs();
+		delete[] verts;
+	}
+
+	int hw = (int)std::thread::hardware_concurrency();
+	int maxThreads = hw > 4 ? hw : 4;
+	printf("file: %s x%d (%d joints, %d frames, %.1f MB of matrices), %d hardware threads\n", src.c_str(), scale,
+		numJoints, numFrames, out.size() * sizeof(mat4x4) / (1024.0 * 1024.0), hw);
+	printf("  link loop, 1 thread : %9.2f ms  %10.0f frames/s\n", loopMs, numFrames / (loopMs / 1000.0));
+
+	std::vector<mat4x4> ref((size_t)numFrames * numJoints);
+	double oneMs = 0;
+	bool allSame = true, stealingOk = true;
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		ThreadPool pool(threads);
+		std::vector<mat4x4>& dst = threads == 1 ? ref : out;
+		double best = 1e30;
+		for (int r = 0; r < 3; r++)
+		{
+			BenchTimer timer;
+			skel.BakeClip(&rec, dst.data(), &pool);
+			best = fmin(best, timer.ElapsedMs());
+		}
+		if (threads == 1) oneMs = best;
+		bool same = memcmp(dst.data(), ref.data(), ref.size() * sizeof(mat4x4)) == 0;
+		bool stealing = CheckStealing(pool);
+		allSame = allSame && same;
+		stealingOk = stealingOk && stealing;
+		printf("  BakeClip %2d threads: %9.2f ms  %10.0f frames/s  vs link loop %5.1fx  scaling %.2fx  identical: %s  tasks once: %s\n",
+			threads, best, numFrames / (best / 1000.0), loopMs / best, oneMs / best, same ? "yes" : "NO", stealing ? "yes" : "NO");
+	}
+	return allSame && stealingOk ? 0 : 1;
+}
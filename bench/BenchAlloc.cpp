@@ -0,0 +1,113 @@
+// BenchAlloc.cpp : counts the heap allocations made through operator new, so
+// suites can report allocations per operation.  Replacing the global
+// operators here covers the whole bvh_bench executable, the core library
+// included.  Memory from AlignedAlloc (frame storage, arena blocks) goes
+// straight to the C allocator and is not counted.
+
+#include "BenchUtil.h"
+#include "AlignedAlloc.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+static std::atomic<uint64_t> s_numAllocations(0);
+
+uint64_t BenchAllocationCount()
+{
+	return s_numAllocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t bytes)
+{
+	s_numAllocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(bytes ? bytes : 1);
+	if (p == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t bytes)
+{
+	return operator new(bytes);
+}
+
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept
+{
+	s_numAllocations.fetch_add(1, std::memory_order_relaxed);
+	return malloc(bytes ? bytes : 1);
+}
+
+void* operator new[](size_t bytes, const std::nothrow_t& tag) noexcept
+{
+	return operator new(bytes, tag);
+}
+
+//over-aligned types, e.g. vectors of SIMD registers
+void* operator new(size_t bytes, std::align_val_t alignment)
+{
+	s_numAllocations.fetch_add(1, std::memory_order_relaxed);
+	void* p = AlignedAlloc(bytes ? bytes : 1, (size_t)alignment);
+	if (p == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t bytes, std::align_val_t alignment)
+{
+	return operator new(bytes, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	AlignedFree(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+	AlignedFree(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+	AlignedFree(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept
+{
+	AlignedFree(p);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept
+{
+	free(p);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <string>
+#include <stdint.h>
+
+#ifndef BVH_DATA_DIR
+#define BVH_DATA_DIR "."
+#endif
+
+//Small helpers shared by the benchmark suites.
+
+//Wall clock stopwatch, reports milliseconds
+class BenchTimer
+{
+public:
+	BenchTimer() { Reset(); }
+	void Reset() { m_start = std::chrono::steady_clock::now(); }
+	double ElapsedMs()
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+	}
+
+private:
+	std::chrono::steady_clock::time_point m_start;
+};
+
+//Swallows everything written to std::cout while in scope so the loaders'
+//progress messages don't drown out the timings.  The text is dropped, not
+//kept, so it neither allocates nor piles up over many loads.
+class BenchQuiet
+{
+public:
+	BenchQuiet() { m_old = std::cout.rdbuf(&m_sink); }
+	~BenchQuiet() { std::cout.rdbuf(m_old); }
+
+private:
+	class NullBuffer : public std::streambuf
+	{
+	protected:
+		int overflow(int c) override { return traits_type::not_eof(c); }
+		std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+	};
+
+	NullBuffer m_sink;
+	std::streambuf* m_old;
+};
+
+//Returns the path of one of the bvh files that ship with the repository
+inline std::string BenchDataPath(const char* name)
+{
+	return std::string(BVH_DATA_DIR) + "/" + name;
+}
+
+//Reads a whole file into text, returns false if it can't be opened
+inline bool BenchReadFile(const std::string& path, std::string& text)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in.good())
+	{
+		return false;
+	}
+	text.assign((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	return true;
+}
+
+class Skeleton;
+class AnimRec;
+
+//Writes a copy of src to dst with the MOTION rows repeated scale times.
+//Returns the number of bytes written, 0 on failure.  (LoadBench.cpp)
+size_t BenchWriteScaledBVH(const std::string& src, const std::string& dst, int scale);
+
+//Writes a synthetic rig of numJoints joints, with hubs of many children, and
+//numFrames frames of motion.  Returns the bytes written, 0 on failure.
+//(StressBench.cpp)
+size_t BenchWriteSyntheticBVH(const std::string& dst, int numJoints, int numFrames);
+
+//number of operator new calls so far, from every thread.  (BenchAlloc.cpp)
+uint64_t BenchAllocationCount();
+
+//true if both loads produced the same skeleton size and bit identical frames
+bool BenchSameRecords(Skeleton& skelA, AnimRec& recA, Skeleton& skelB, AnimRec& recB);
+
+//Suites, each takes the arguments after the suite name
+int RunLoadBench(int argc, char** argv);
+int RunParallelLoadBench(int argc, char** argv);
+int RunMotionParseBench(int argc, char** argv);
+int RunStorageBench(int argc, char** argv);
+int RunCacheBench(int argc, char** argv);
+int RunFKBench(int argc, char** argv);
+int RunEulerBench(int argc, char** argv);
+int RunBatchFKBench(int argc, char** argv);
+int RunBakeBench(int argc, char** argv);
+int RunLookupBench(int argc, char** argv);
+int RunStressBench(int argc, char** argv);
+int RunRenderBench(int argc, char** argv);
+int RunPipelineBench(int argc, char** argv);
+int RunThumbBench(int argc, char** argv);
+int RunSampleBench(int argc, char** argv);
+int RunQuatBench(int argc, char** argv);
+int RunCompressBench(int argc, char** argv);
+int RunStreamBench(int argc, char** argv);
+int RunArenaBench(int argc, char** argv);
+int RunStagesBench(int argc, char** argv);
+int RunTraceBench(int argc, char** argv);
+int RunHudBench(int argc, char** argv);
+int RunCrowdBench(int argc, char** argv);
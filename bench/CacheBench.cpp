@@ -0,0 +1,176 @@
+// CacheBench.cpp : parsing a bvh file vs loading it from its binary motion
+// cache, plus the cache's fallback behaviour when the bvh changes.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "MotionCache.h"
+#include "AlignedAlloc.h"
+
+#include <fstream>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+//Loads path through a cache object, returns the time taken
+static double LoadWithCache(MotionCache& cache, const std::string& path, Skeleton* skel, AnimRec* rec)
+{
+	BenchQuiet quiet;
+	BenchTimer timer;
+	cache.Load(path.c_str(), skel, rec, false);
+	return timer.ElapsedMs();
+}
+
+int RunCacheBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int scale = argc > 1 ? atoi(argv[1]) : 100;
+	int reps = 3;
+	if (scale < 1) scale = 1;
+
+	std::string scaled = "bvh_bench_scaled.bvh";
+	std::string cachePath = MotionCache::GetCachePath(scaled.c_str());
+	size_t bytes = BenchWriteScaledBVH(src, scaled, scale);
+	if (bytes == 0)
+	{
+		fprintf(stderr, "could not read %s\n", src.c_str());
+		return 1;
+	}
+	remove(cachePath.c_str());
+
+	//text parse with the cache out of the picture
+	Skeleton refSkel;
+	AnimRec refRec;
+	double bestParse = 1e30;
+	for (int r = 0; r < reps; r++)
+	{
+		Skeleton skel;
+		AnimRec rec;
+		MotionCache cache;
+		cache.SetEnabled(false);
+		bestParse = fmin(bestParse, LoadWithCache(cache, scaled, &skel, &rec));
+	}
+	{
+		MotionCache cache;
+		cache.SetEnabled(false);
+		LoadWithCache(cache, scaled, &refSkel, &refRec);
+	}
+
+	//first load parses and writes the cache
+	double firstLoad;
+	bool wrote;
+	{
+		Skeleton skel;
+		AnimRec rec;
+		MotionCache cache;
+		firstLoad = LoadWithCache(cache, scaled, &skel, &rec);
+		struct stat st;
+		wrote = !cache.LoadedFromCache() && stat(cachePath.c_str(), &st) == 0;
+	}
+
+	//every later load maps the cache.  Mapping is lazy, so also time reading
+	//every frame once, which is what playback ends up paying for
+	double bestCached = 1e30, bestTouched = 1e30;
+	bool same = wrote;
+	for (int r = 0; r < reps && same; r++)
+	{
+		Skeleton skel;
+		AnimRec rec;
+		MotionCache cache;
+		BenchTimer timer;
+		bestCached = fmin(bestCached, LoadWithCache(cache, scaled, &skel, &rec));
+		float sum = 0;
+		for (int f = 0; f < rec.GetNumFrames(); f++)
+		{
+			sum += rec.GetFrameData(f)[0];
+		}
+		bestTouched = fmin(bestTouched, timer.ElapsedMs() + (sum == 12345.f ? 1e-9 : 0));
+		same = cache.LoadedFromCache() && BenchSameRecords(refSkel, refRec, skel, rec);
+	}
+
+	//a newer time stamp on unchanged contents is caught by the hash
+	bool touchedHit = false;
+	double touchedMs = 0;
+	{
+		struct stat st;
+		stat(scaled.c_str(), &st);
+		struct utimbuf times;
+		times.actime = st.st_atime;
+		times.modtime = st.st_mtime + 10;
+		utime(scaled.c_str(), &times);
+
+		Skeleton skel;
+		AnimRec rec;
+		MotionCache cache;
+		touchedMs = LoadWithCache(cache, scaled, &skel, &rec);
+		touchedHit = cache.LoadedFromCache() && BenchSameRecords(refSkel, refRec, skel, rec);
+	}
+
+	//A cache whose numDOFs disagrees with its links' channels must not be
+	//used, or posing reads past the end of every frame.  The count is
+	//changed without changing the padded stride, so only that check can
+	//catch it.  numDOFs is the uint32 44 bytes into the header, the stride
+	//the one 8 bytes after it.
+	bool tamperedMiss = false;
+	{
+		std::fstream f(cachePath.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		uint32_t numDOFs = 0, stride = 0;
+		f.seekg(44);
+		f.read((char*)&numDOFs, sizeof(numDOFs));
+		f.seekg(52);
+		f.read((char*)&stride, sizeof(stride));
+		uint32_t tampered = (uint32_t)PadToCacheLine(numDOFs + 1) == stride ? numDOFs + 1 : numDOFs - 1;
+		f.seekp(44);
+		f.write((const char*)&tampered, sizeof(tampered));
+		f.close();
+
+		Skeleton skel;
+		AnimRec rec;
+		MotionCache cache;
+		LoadWithCache(cache, scaled, &skel, &rec);
+		tamperedMiss = f.good() && numDOFs == (uint32_t)refRec.GetNumDOFs() && (uint32_t)PadToCacheLine(tampered) == stride
+			&& !cache.LoadedFromCache() && BenchSameRecords(refSkel, refRec, skel, rec);
+	}
+
+	//changed contents (same size) must go back to the text
+	bool editedMiss = false;
+	{
+		std::fstream f(scaled.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+		f.seekg(-3, std::ios::end);
+		char c = (char)f.get();
+		f.seekp(-3, std::ios::end);
+		f.put(c == '7' ? '8' : '7');
+		f.close();
+
+		Skeleton skel;
+		AnimRec rec;
+		MotionCache cache;
+		LoadWithCache(cache, scaled, &skel, &rec);
+		editedMiss = !cache.LoadedFromCache() && rec.GetNumFrames() == refRec.GetNumFrames();
+	}
+
+	struct stat cacheStat;
+	double cacheMb = stat(cachePath.c_str(), &cacheStat) == 0 ? cacheStat.st_size / (1024.0 * 1024.0) : 0;
+	remove(scaled.c_str());
+	remove(cachePath.c_str());
+
+	double mb = bytes / (1024.0 * 1024.0);
+	printf("file: %s x%d (%.1f MB, %d frames), cache %.1f MB\n", src.c_str(), scale, mb, refRec.GetNumFrames(), cacheMb);
+	printf("  parse bvh (cache disabled)  : %9.2f ms\n", bestParse);
+	printf("  parse + write cache         : %9.2f ms\n", firstLoad);
+	printf("  load from cache (mmap)      : %9.2f ms  speedup %.1fx\n", bestCached, bestParse / bestCached);
+	printf("  load + touch every frame    : %9.2f ms  speedup %.1fx\n", bestTouched, bestParse / bestTouched);
+	printf("  load from cache, new mtime  : %9.2f ms  (content hash checked)\n", touchedMs);
+	printf("  cache hit + identical: %s   touched file hit: %s   edited file reparsed: %s   bad numDOFs reparsed: %s\n",
+		same ? "yes" : "NO", touchedHit ? "yes" : "NO", editedMiss ? "yes" : "NO", tamperedMiss ? "yes" : "NO");
+	return same && touchedHit && editedMiss && tamperedMiss ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+// CompressBench.cpp : CompressedClip at a few error bounds.  Size against
+// the text file and the AnimRec frames, the world space error actually
+// reached, and random access sampling speed.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "QuatClip.h"
+#include "CompressedClip.h"
+#include "BVHReader.h"
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+int RunCompressBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int numSamples = argc > 1 ? atoi(argv[1]) : 20000;
+	if (numSamples < 1) numSamples = 1;
+
+	std::string text;
+	if (!BenchReadFile(src, text))
+	{
+		fprintf(stderr, "could not read %s\n", src.c_str());
+		return 1;
+	}
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		if (!reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false) || rec.GetNumFrames() < 2)
+		{
+			fprintf(stderr, "could not read %s\n", src.c_str());
+			return 1;
+		}
+	}
+	int numFrames = rec.GetNumFrames();
+	size_t recBytes = (size_t)numFrames * rec.GetNumDOFs() * sizeof(float);
+	double duration = rec.GetFrameTime() * (numFrames - 1);
+
+	std::vector<double> times(numSamples);
+	for (int i = 0; i < numSamples; i++)
+	{
+		times[i] = duration * ((i * 0.618033988749895) - floor(i * 0.618033988749895));
+	}
+
+	QuatClip quats;
+	quats.Build(&skel, &rec);
+	std::vector<float> pose(skel.GetQuatPoseSize());
+	BenchTimer timer;
+	for (int i = 0; i < numSamples; i++)
+	{
+		quats.Sample(times[i], pose.data());
+	}
+	double quatNs = timer.ElapsedMs() * 1e6 / numSamples;
+
+	printf("file: %s, %d frames of %d channels\n", src.c_str(), numFrames, rec.GetNumDOFs());
+	printf("  text %.1f KB, AnimRec channels %.1f KB, quaternion clip sample %.1f ns/pose\n",
+		text.size() / 1024.0, recBytes / 1024.0, quatNs);
+	printf("  bound      tracks    keys  kept      KB  vs text  vs AnimRec  max error  build ms  sample ns\n");
+
+	//the bounds are in the clip's units, metres for the shipped files
+	const float bounds[] = { 0.0005f, 0.001f, 0.005f, 0.01f };
+	bool ok = true;
+	double sink = 0;
+	for (float bound : bounds)
+	{
+		CompressedClip clip;
+		timer.Reset();
+		bool built = clip.Build(&skel, &rec, bound);
+		double buildMs = timer.ElapsedMs();
+
+		timer.Reset();
+		for (int i = 0; i < numSamples; i++)
+		{
+			clip.Sample(times[i], pose.data());
+			sink += pose[pose.size() - 1];
+		}
+		double sampleNs = timer.ElapsedMs() * 1e6 / numSamples;
+
+		size_t bytes = clip.GetMemoryUsage();
+		double kept = 100.0 * clip.GetNumKeys() / ((double)clip.GetNumTracks() * numFrames);
+		printf("  %-9g  %6d  %6d  %3.0f%%  %6.1f  %6.1fx  %9.1fx  %9.2g  %8.1f  %9.1f\n", bound, clip.GetNumTracks(),
+			clip.GetNumKeys(), kept, bytes / 1024.0, (double)text.size() / bytes, (double)recBytes / bytes,
+			clip.GetMaxError(), buildMs, sampleNs);
+		ok = ok && built && clip.GetMaxError() <= bound;
+	}
+	printf("  every bound held: %s (checksum %g)\n", ok ? "yes" : "NO", sink);
+	return ok ? 0 : 1;
+}
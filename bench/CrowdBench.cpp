@@ -0,0 +1,167 @@
+// CrowdBench.cpp : many instances of one rig playing one clip through Crowd.
+// Checks instances against posing the skeleton by hand, and measures what
+// an instance costs in memory and time: how many fit in a 60 Hz frame on
+// one thread and on the shared pool.
+
+#include "BenchUtil.h"
+
+#include "Crowd.h"
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+#include "ThreadPool.h"
+
+#include <vector>
+#include <string>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//largest difference between two runs of matrices
+static float MaxDiff(const mat4x4* a, const mat4x4* b, size_t count)
+{
+	float diff = 0;
+	for (size_t m = 0; m < count; m++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+			{
+				float d = fabsf(a[m][c][r] - b[m][c][r]);
+				diff = d > diff ? d : diff;
+			}
+		}
+	}
+	return diff;
+}
+
+//ms per Evaluate of the whole crowd, best of a few runs of at least 100 ms
+static double TimeEvaluate(Crowd& crowd, mat4x4* world, mat4x4* instances, ThreadPool* pool)
+{
+	double best = 1e30;
+	double time = 0;
+	for (int run = 0; run < 3; run++)
+	{
+		int count = 0;
+		BenchTimer timer;
+		do
+		{
+			crowd.Evaluate(time, world, instances, pool);
+			time += 1.0 / 60.0;
+			count++;
+		} while (timer.ElapsedMs() < 100.0);
+		double ms = timer.ElapsedMs() / count;
+		best = ms < best ? ms : best;
+	}
+	return best;
+}
+
+int RunCrowdBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int maxInstances = argc > 1 ? atoi(argv[1]) : 10000;
+	if (maxInstances < 1) maxInstances = 1;
+
+	std::string text;
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		if (!BenchReadFile(src, text) || !reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false) || rec.GetNumFrames() == 0)
+		{
+			fprintf(stderr, "could not read %s\n", src.c_str());
+			return 1;
+		}
+	}
+	skel.AddGeometry();
+	int numLinks = skel.GetNumLinks();
+	int numBones = skel.GetNumBones();
+
+	//what a skeleton per character would cost instead
+	size_t copyBytes = 0;
+	uint64_t copyAllocs = 0;
+	{
+		BenchQuiet quiet;
+		uint64_t before = BenchAllocationCount();
+		Skeleton copy;
+		AnimRec header;
+		BVHReader reader;
+		int numFrames = 0;
+		reader.BuildSkelFromBufferHeader(text.data(), text.data() + text.size(), &copy, &header, false, &numFrames);
+		copy.AddGeometry();
+		copy.PrepareForSharing();
+		copyAllocs = BenchAllocationCount() - before;
+		copyBytes = copy.GetMemoryStats().bytesReserved;
+	}
+
+	//every instance at its own time and place against the skeleton posed
+	//by hand, and the same crowd split over the pool
+	const int numChecked = 37;
+	Crowd crowd;
+	crowd.Create(&skel, &rec, numChecked);
+	for (int i = 0; i < numChecked; i++)
+	{
+		crowd.SetTimeOffset(i, i * 0.37 - 2.0);
+		crowd.SetPosition(i, (float)(i % 6) * 100.0f, 0.0f, (float)(i / 6) * -100.0f);
+	}
+	const double checkTime = 1.234;
+	std::vector<mat4x4> world((size_t)numLinks * numChecked), instances((size_t)numBones * numChecked);
+	std::vector<mat4x4> pooledWorld(world.size()), pooledInstances(instances.size());
+	crowd.Evaluate(checkTime, world.data(), instances.data());
+	crowd.Evaluate(checkTime, pooledWorld.data(), pooledInstances.data(), &ThreadPool::Shared());
+
+	std::vector<float> frame(rec.GetFrameStride());
+	std::vector<mat4x4> ref(numLinks), refInstances(numBones);
+	float maxDiff = 0;
+	for (int i = 0; i < numChecked; i++)
+	{
+		double duration = rec.GetEndTime();
+		double t = fmod(checkTime + crowd.GetTimeOffset(i), duration);
+		rec.Sample(t < 0 ? t + duration : t, frame.data());
+		skel.ComputePose(frame.data());
+		memcpy(ref.data(), skel.GetWorldMatrices(), numLinks * sizeof(mat4x4));
+		for (int l = 0; l < numLinks; l++)
+		{
+			ref[l][3][0] += (float)(i % 6) * 100.0f;
+			ref[l][3][2] += (float)(i / 6) * -100.0f;
+		}
+		skel.CalcBoneInstances(ref.data(), refInstances.data());
+		float d = MaxDiff(ref.data(), &world[(size_t)i * numLinks], numLinks);
+		float e = MaxDiff(refInstances.data(), &instances[(size_t)i * numBones], numBones);
+		maxDiff = d > maxDiff ? d : maxDiff;
+		maxDiff = e > maxDiff ? e : maxDiff;
+	}
+	bool matches = maxDiff < 1e-3f;
+	bool pooledSame = memcmp(world.data(), pooledWorld.data(), world.size() * sizeof(mat4x4)) == 0
+		&& memcmp(instances.data(), pooledInstances.data(), instances.size() * sizeof(mat4x4)) == 0;
+
+	printf("file: %s, %d links, %d bones, shared by every instance\n", src.c_str(), numLinks, numBones);
+	printf("  per instance: %zu bytes (time offset, position, sampled frame, world and bone matrices)\n",
+		crowd.GetBytesPerInstance());
+	printf("  a skeleton per character instead: %.1f KB in its arena alone, %llu allocations to build\n",
+		copyBytes / 1024.0, (unsigned long long)copyAllocs);
+	printf("  %d instances vs posing by hand: max difference %g, pooled result %s\n",
+		numChecked, maxDiff, pooledSame ? "identical" : "DIFFERENT");
+
+	ThreadPool& pool = ThreadPool::Shared();
+	printf("  %10s %12s %14s %12s %14s %10s\n", "instances", "ms 1 thread", "per 60 Hz", "ms pool", "per 60 Hz", "MB");
+	bool noAllocs = true;
+	for (int n = 100; ; n *= 10)
+	{
+		if (n > maxInstances) n = maxInstances;
+		crowd.Create(&skel, &rec, n);
+		std::vector<mat4x4> crowdWorld((size_t)numLinks * n), crowdInstances((size_t)numBones * n);
+		uint64_t allocsBefore = BenchAllocationCount();
+		double single = TimeEvaluate(crowd, crowdWorld.data(), crowdInstances.data(), NULL);
+		double pooled = TimeEvaluate(crowd, crowdWorld.data(), crowdInstances.data(), &pool);
+		noAllocs = noAllocs && BenchAllocationCount() == allocsBefore;
+		printf("  %10d %12.3f %14.0f %12.3f %14.0f %10.1f\n", n, single, n * (1000.0 / 60.0) / single,
+			pooled, n * (1000.0 / 60.0) / pooled, n * (double)crowd.GetBytesPerInstance() / (1024.0 * 1024.0));
+		if (n == maxInstances) break;
+	}
+	printf("  (per 60 Hz: instances evaluated in 16.7 ms at that rate, pool of %d threads)\n", pool.GetNumThreads());
+	printf("  allocations while evaluating: %s\n", noAllocs ? "none" : "SOME");
+	return matches && pooledSame && noAllocs ? 0 : 1;
+}
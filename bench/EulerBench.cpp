@@ -0,0 +1,111 @@
+// EulerBench.cpp : per joint cost of building a rotation from Euler angles,
+// generic axis-angle mat4x4_rotate per axis vs the closed form kernels.
+
+#include "BenchUtil.h"
+
+#include "EulerKernels.h"
+
+#include <vector>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+//What Link::MakeLinkRotMatrixLocal used to do: a switch on the axis and a
+//full axis-angle rotation for every channel
+static void RotateGeneric(const int* axisOrder, const float* angles, mat4x4 rot)
+{
+	mat4x4_identity(rot);
+	for (int i = 0; i < 3; i++)
+	{
+		switch (axisOrder[i])
+		{
+		case 0:
+			mat4x4_rotate(rot, rot, 1.0f, 0.0f, 0.0f, angles[i]);
+			break;
+		case 1:
+			mat4x4_rotate(rot, rot, 0.0f, 1.0f, 0.0f, angles[i]);
+			break;
+		case 2:
+			mat4x4_rotate(rot, rot, 0.0f, 0.0f, 1.0f, angles[i]);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+int RunEulerBench(int argc, char** argv)
+{
+	int count = argc > 0 ? atoi(argv[0]) : 1000000;
+	if (count < 1) count = 1;
+
+	//the 6 Tait-Bryan orders followed by the 6 proper Euler orders
+	static const int orders[12][3] =
+	{
+		{ 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 },
+		{ 0, 1, 0 }, { 0, 2, 0 }, { 1, 0, 1 }, { 1, 2, 1 }, { 2, 0, 2 }, { 2, 1, 2 },
+	};
+	static const char axisNames[] = "XYZ";
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+	std::vector<float> angles(count * 3);
+	for (size_t i = 0; i < angles.size(); i++)
+	{
+		angles[i] = angle(rng);
+	}
+
+	printf("%d rotations per order, ns per joint\n", count);
+	printf("  order   generic   kernel  speedup   max |diff|\n");
+	double totalGeneric = 0, totalKernel = 0, worstDiff = 0;
+	float sink = 0;
+	for (int o = 0; o < 12; o++)
+	{
+		const int* order = orders[o];
+		EulerKernel kernel = GetEulerKernel(3, order);
+
+		double bestGeneric = 1e30, bestKernel = 1e30;
+		for (int r = 0; r < 3; r++)
+		{
+			mat4x4 m;
+			BenchTimer timer;
+			for (int i = 0; i < count; i++)
+			{
+				RotateGeneric(order, &angles[i * 3], m);
+				sink += m[0][1];
+			}
+			bestGeneric = fmin(bestGeneric, timer.ElapsedMs());
+
+			timer.Reset();
+			for (int i = 0; i < count; i++)
+			{
+				kernel(&angles[i * 3], m);
+				sink += m[0][1];
+			}
+			bestKernel = fmin(bestKernel, timer.ElapsedMs());
+		}
+
+		double maxDiff = 0;
+		for (int i = 0; i < count; i += 97)
+		{
+			mat4x4 a, b;
+			RotateGeneric(order, &angles[i * 3], a);
+			kernel(&angles[i * 3], b);
+			for (int c = 0; c < 4; c++)
+				for (int k = 0; k < 4; k++)
+					maxDiff = fmax(maxDiff, fabs(a[c][k] - b[c][k]));
+		}
+
+		double nsGeneric = bestGeneric * 1e6 / count;
+		double nsKernel = bestKernel * 1e6 / count;
+		totalGeneric += nsGeneric;
+		totalKernel += nsKernel;
+		worstDiff = fmax(worstDiff, maxDiff);
+		printf("  %c%c%c    %7.2f  %7.2f    %5.2fx   %g\n", axisNames[order[0]], axisNames[order[1]], axisNames[order[2]],
+			nsGeneric, nsKernel, nsGeneric / nsKernel, maxDiff);
+	}
+	printf("  mean    %7.2f  %7.2f    %5.2fx%s\n", totalGeneric / 12, totalKernel / 12, totalGeneric / totalKernel,
+		sink == 12345.f ? " " : "");
+	return worstDiff <= 1e-6 ? 0 : 1;
+}
@@ -0,0 +1,186 @@
+// FKBench.cpp : forward kinematics throughput, recursive link update vs the
+// flattened single loop, with a check that both give the same matrices.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "Link.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+//Largest difference between the links' matrices (after SetSkelState and
+//UpdateLinks) and ComputePose over every frame of the clip
+static double CompareWithLinks(Skeleton& skel, AnimRec& rec)
+{
+	std::vector<double> state(rec.GetNumDOFs() > 6 ? rec.GetNumDOFs() : 6);
+	double maxDiff = 0;
+	for (int f = 0; f < rec.GetNumFrames(); f++)
+	{
+		rec.GetFrame(f, state.data());
+		skel.SetSkelState(state.data());
+		skel.UpdateLinks();
+		skel.ComputePose(rec.GetFrameData(f));
+
+		const mat4x4* world = skel.GetWorldMatrices();
+		for (int j = 0; j < skel.GetNumLinks(); j++)
+		{
+			mat4x4 m;
+			skel.GetLink(j)->GetLToWTransMat(m);
+			for (int c = 0; c < 4; c++)
+				for (int r = 0; r < 4; r++)
+					maxDiff = fmax(maxDiff, fabs(m[c][r] - world[j][c][r]));
+		}
+	}
+	return maxDiff;
+}
+
+int RunFKBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int numPoses = argc > 1 ? atoi(argv[1]) : 200000;
+	if (numPoses < 1) numPoses = 1;
+
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		if (!reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false) || rec.GetNumFrames() == 0)
+		{
+			fprintf(stderr, "could not read %s\n", src.c_str());
+			return 1;
+		}
+	}
+	int numFrames = rec.GetNumFrames();
+	std::vector<double> state(rec.GetNumDOFs() > 6 ? rec.GetNumDOFs() : 6);
+
+	//recursive update, including the copy of the frame into the links
+	double bestLinks = 1e30, bestLinksFK = 1e30, bestFlat = 1e30;
+	float sink = 0;
+	for (int r = 0; r < 3; r++)
+	{
+		BenchTimer timer;
+		for (int i = 0; i < numPoses; i++)
+		{
+			rec.GetFrame(i % numFrames, state.data());
+			skel.SetSkelState(state.data());
+			skel.UpdateLinks();
+		}
+		bestLinks = fmin(bestLinks, timer.ElapsedMs());
+
+		//the recursion alone, on whatever pose the links hold
+		timer.Reset();
+		for (int i = 0; i < numPoses; i++)
+		{
+			skel.UpdateLinks();
+		}
+		bestLinksFK = fmin(bestLinksFK, timer.ElapsedMs());
+
+		//flattened loop straight from the stored frames
+		timer.Reset();
+		for (int i = 0; i < numPoses; i++)
+		{
+			skel.ComputePose(rec.GetFrameData(i % numFrames));
+			sink += skel.GetWorldMatrices()[skel.GetNumLinks() - 1][3][0];
+		}
+		bestFlat = fmin(bestFlat, timer.ElapsedMs());
+	}
+
+	double maxDiff = CompareWithLinks(skel, rec);
+
+	printf("file: %s (%d joints, %d frames), %d poses per run\n", src.c_str(), skel.GetNumLinks(), numFrames, numPoses);
+	printf("  SetSkelState + UpdateLinks : %9.2f ms  %10.0f poses/s\n", bestLinks, numPoses / (bestLinks / 1000.0));
+	printf("  UpdateLinks only           : %9.2f ms  %10.0f poses/s\n", bestLinksFK, numPoses / (bestLinksFK / 1000.0));
+	printf("  ComputePose (flat loop)    : %9.2f ms  %10.0f poses/s  speedup %.2fx\n",
+		bestFlat, numPoses / (bestFlat / 1000.0), bestLinks / bestFlat);
+	printf("  max |difference| to links over all frames: %g%s\n", maxDiff, sink == 12345.f ? " " : "");
+	return maxDiff <= 1e-5 ? 0 : 1;
+}
+
+//ComputePoses on every instruction set, each checked against the links
+int RunBatchFKBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int numPoses = argc > 1 ? atoi(argv[1]) : 16384;
+	if (numPoses < 1) numPoses = 1;
+
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		if (!reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false) || rec.GetNumFrames() == 0)
+		{
+			fprintf(stderr, "could not read %s\n", src.c_str());
+			return 1;
+		}
+	}
+	int numFrames = rec.GetNumFrames();
+	int numJoints = skel.GetNumLinks();
+
+	//reference matrices from Link::UpdateAndRecurse for every frame
+	std::vector<double> state(rec.GetNumDOFs() > 6 ? rec.GetNumDOFs() : 6);
+	std::vector<float> ref((size_t)numFrames * numJoints * 16);
+	for (int f = 0; f < numFrames; f++)
+	{
+		rec.GetFrame(f, state.data());
+		skel.SetSkelState(state.data());
+		skel.UpdateLinks();
+		for (int j = 0; j < numJoints; j++)
+		{
+			skel.GetLink(j)->GetLToWTransMat(*(mat4x4*)&ref[((size_t)f * numJoints + j) * 16]);
+		}
+	}
+
+	std::vector<const float*> frames(numPoses);
+	for (int p = 0; p < numPoses; p++)
+	{
+		frames[p] = rec.GetFrameData(p % numFrames);
+	}
+	std::vector<mat4x4> out((size_t)numPoses * numJoints);
+
+	static const char* names[] = { "scalar", "SSE", "AVX2" };
+	int best = Skeleton::GetBestFKInstructionSet();
+	printf("file: %s (%d joints), %d poses per run, best instruction set %s\n", src.c_str(), numJoints, numPoses, names[best]);
+	printf("  path         ms      poses/s   speedup   max |rot diff|  max |pos diff|\n");
+	double scalarMs = 0;
+	bool ok = true;
+	for (int isa = FK_SCALAR; isa <= best; isa++)
+	{
+		double bestMs = 1e30;
+		for (int r = 0; r < 3; r++)
+		{
+			BenchTimer timer;
+			skel.ComputePoses(frames.data(), numPoses, out.data(), isa);
+			bestMs = fmin(bestMs, timer.ElapsedMs());
+		}
+		if (isa == FK_SCALAR) scalarMs = bestMs;
+
+		//rotation entries are unit scale, positions are compared relative to
+		//their distance from the origin
+		double rotDiff = 0, posDiff = 0;
+		for (int p = 0; p < numPoses; p++)
+		{
+			for (int j = 0; j < numJoints; j++)
+			{
+				const float* a = &out[(size_t)p * numJoints + j][0][0];
+				const float* b = &ref[((size_t)(p % numFrames) * numJoints + j) * 16];
+				for (int e = 0; e < 12; e++)
+					rotDiff = fmax(rotDiff, fabs(a[e] - b[e]));
+				for (int e = 12; e < 16; e++)
+					posDiff = fmax(posDiff, fabs(a[e] - b[e]) / (1.0 + fabs(b[e])));
+			}
+		}
+		ok = ok && rotDiff <= 1e-5 && posDiff <= 1e-5;
+		printf("  %-7s %8.2f %12.0f   %6.2fx   %12.3g   %12.3g\n", names[isa], bestMs, numPoses / (bestMs / 1000.0),
+			scalarMs / bestMs, rotDiff, posDiff);
+	}
+	printf("  within tolerance (1e-5) of Link::UpdateAndRecurse: %s\n", ok ? "yes" : "NO");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+// HudBench.cpp : the player's performance overlay without a window.  Plays a
+// clip on the animation thread, feeds every picked up pose to the Hud the
+// way the render loop does, and checks that building the overlay allocates
+// nothing, fits GetMaxVertices and counts late and dropped frames right.
+
+#include "BenchUtil.h"
+
+#include "Hud.h"
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+#include "AnimationThread.h"
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+int RunHudBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int numFrames = argc > 1 ? atoi(argv[1]) : 2000;
+	if (numFrames < HUD_HISTORY) numFrames = HUD_HISTORY;
+
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		if (!reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false) || rec.GetNumFrames() == 0)
+		{
+			fprintf(stderr, "could not read %s\n", src.c_str());
+			return 1;
+		}
+	}
+	skel.AddGeometry();
+
+	std::vector<unsigned char> atlas(HUD_ATLAS_WIDTH * HUD_ATLAS_HEIGHT);
+	Hud::MakeFontAtlas(atlas.data());
+	int lit = 0;
+	for (size_t i = 0; i < atlas.size(); i++) lit += atlas[i] != 0 ? 1 : 0;
+
+	//every 10th frame misses a vsync; frames between poses are dropped ones
+	std::vector<HudVertex> verts(Hud::GetMaxVertices());
+	Hud hud;
+	hud.SetRefreshRate(60.0);
+	AnimationThread animThread;
+	animThread.Start(&skel, &rec);
+	size_t uploadBytes = skel.GetNumBones() * sizeof(mat4x4);
+	int expectLate = 0, expectDropped = 0, maxVerts = 0;
+	uint64_t lastSequence = 0;
+	double buildMs = 0;
+	uint64_t allocsBefore = BenchAllocationCount();
+	for (int f = 0; f < numFrames; f++)
+	{
+		const PoseFrame* pose = animThread.Acquire();
+		HudSample sample;
+		sample.frameMs = f % 10 == 9 ? 33.4 : 16.7;
+		sample.poseSequence = pose->sequence;
+		sample.fkMs = pose->simMs;
+		sample.clipTime = pose->time;
+		sample.numClipFrames = rec.GetNumFrames();
+		sample.clipFrame = (int)(pose->time / rec.GetFrameTime()) % sample.numClipFrames;
+		sample.uploadBytes = uploadBytes;
+		expectLate += f % 10 == 9 ? 1 : 0;
+		expectDropped += f > 0 && pose->sequence != lastSequence + 1 ? 1 : 0;
+		lastSequence = pose->sequence;
+
+		BenchTimer timer;
+		hud.AddFrame(sample);
+		int count = hud.Build(verts.data(), (int)verts.size(), 1280, 720);
+		buildMs += timer.ElapsedMs();
+		maxVerts = count > maxVerts ? count : maxVerts;
+	}
+	uint64_t allocs = BenchAllocationCount() - allocsBefore;
+	animThread.Stop();
+
+	//everything inside the framebuffer
+	int count = hud.Build(verts.data(), (int)verts.size(), 1280, 720);
+	bool inside = count > 0;
+	for (int i = 0; i < count; i++)
+	{
+		inside = inside && verts[i].x >= 0 && verts[i].x <= 1280 && verts[i].y >= 0 && verts[i].y <= 720
+			&& verts[i].u >= 0 && verts[i].u <= 1 && verts[i].v >= 0 && verts[i].v <= 1;
+	}
+	hud.ToggleVisible();
+	bool hidden = hud.Build(verts.data(), (int)verts.size(), 1280, 720) == 0;
+	bool counted = hud.GetNumLateFrames() == expectLate && hud.GetNumDroppedFrames() == expectDropped;
+
+	printf("file: %s, %d frames through the overlay at 1280x720\n", src.c_str(), numFrames);
+	printf("  font atlas %dx%d, %d texels lit\n", HUD_ATLAS_WIDTH, HUD_ATLAS_HEIGHT, lit);
+	printf("  AddFrame + Build          %8.2f us, up to %d of %d vertices, %.1f KB\n",
+		buildMs * 1000.0 / numFrames, maxVerts, Hud::GetMaxVertices(), maxVerts * sizeof(HudVertex) / 1024.0);
+	printf("  late %d (expected %d), dropped %d (expected %d)\n",
+		hud.GetNumLateFrames(), expectLate, hud.GetNumDroppedFrames(), expectDropped);
+	printf("  allocations in the frame loop %llu, in the framebuffer %s, hidden draws nothing %s\n",
+		(unsigned long long)allocs, inside ? "yes" : "NO", hidden ? "yes" : "NO");
+	bool ok = lit > 0 && allocs == 0 && inside && hidden && counted && maxVerts <= Hud::GetMaxVertices();
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+// LoadBench.cpp : compares the line based BVHReader path against the
+// memory mapped reader on a motion file scaled up by repeating its frames.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+
+#include <fstream>
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+size_t BenchWriteScaledBVH(const std::string& src, const std::string& dst, int scale)
+{
+	std::string text;
+	if (!BenchReadFile(src, text))
+	{
+		return 0;
+	}
+
+	size_t motion = text.find("MOTION");
+	size_t frames = text.find("Frames:", motion);
+	size_t frameTime = text.find("Frame Time:", frames);
+	if (motion == std::string::npos || frames == std::string::npos || frameTime == std::string::npos)
+	{
+		return 0;
+	}
+	size_t rows = text.find('\n', frameTime);
+	if (rows == std::string::npos)
+	{
+		return 0;
+	}
+	rows++;
+
+	int numFrames = atoi(text.c_str() + frames + strlen("Frames:"));
+	std::string body = text.substr(rows);
+	if (!body.empty() && body[body.size() - 1] != '\n')
+	{
+		body += "\r\n";
+	}
+
+	std::string header = text.substr(0, frames);
+	header += "Frames: " + std::to_string((long long)numFrames * scale) + "\r\n";
+	header += text.substr(frameTime, rows - frameTime);
+
+	std::ofstream out(dst.c_str(), std::ios::binary);
+	out << header;
+	for (int i = 0; i < scale; i++)
+	{
+		out << body;
+	}
+	if (!out.good())
+	{
+		return 0;
+	}
+	return header.size() + body.size() * scale;
+}
+
+static double LoadLineReader(const std::string& path, Skeleton* skel, AnimRec* rec)
+{
+	BenchQuiet quiet;
+	BenchTimer timer;
+	BVHReader reader;
+	std::ifstream file(path.c_str());
+	reader.BuildSkelFromHeader(file, skel, rec, false);
+	return timer.ElapsedMs();
+}
+
+static double LoadMapped(const std::string& path, Skeleton* skel, AnimRec* rec)
+{
+	BenchQuiet quiet;
+	BenchTimer timer;
+	BVHReader reader;
+	reader.BuildSkelFromFile(path.c_str(), skel, rec, false);
+	return timer.ElapsedMs();
+}
+
+bool BenchSameRecords(Skeleton& skelA, AnimRec& recA, Skeleton& skelB, AnimRec& recB)
+{
+	if (skelA.GetNumLinks() != skelB.GetNumLinks() || recA.GetNumFrames() != recB.GetNumFrames()
+		|| recA.GetNumDOFs() != recB.GetNumDOFs())
+	{
+		return false;
+	}
+	std::vector<double> a(recA.GetNumDOFs()), b(recB.GetNumDOFs());
+	for (int f = 0; f < recA.GetNumFrames(); f++)
+	{
+		recA.GetFrame(f, a.data());
+		recB.GetFrame(f, b.data());
+		if (memcmp(a.data(), b.data(), a.size() * sizeof(double)) != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int RunLoadBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int scale = argc > 1 ? atoi(argv[1]) : 100;
+	int reps = 3;
+	if (scale < 1) scale = 1;
+
+	std::string scaled = "bvh_bench_scaled.bvh";
+	size_t bytes = BenchWriteScaledBVH(src, scaled, scale);
+	if (bytes == 0)
+	{
+		fprintf(stderr, "could not read %s\n", src.c_str());
+		return 1;
+	}
+
+	double bestLine = 1e30, bestMapped = 1e30;
+	bool same = true;
+	int numFrames = 0;
+	for (int r = 0; r < reps; r++)
+	{
+		Skeleton skelA, skelB;
+		AnimRec recA, recB;
+		bestLine = fmin(bestLine, LoadLineReader(scaled, &skelA, &recA));
+		bestMapped = fmin(bestMapped, LoadMapped(scaled, &skelB, &recB));
+		if (r == 0)
+		{
+			same = BenchSameRecords(skelA, recA, skelB, recB);
+			numFrames = recB.GetNumFrames();
+		}
+	}
+	remove(scaled.c_str());
+
+	double mb = bytes / (1024.0 * 1024.0);
+	printf("file: %s x%d (%.1f MB, %d frames)\n", src.c_str(), scale, mb, numFrames);
+	printf("  line reader (ifstream/getline/strtok): %9.2f ms  %8.1f MB/s\n", bestLine, mb / (bestLine / 1000.0));
+	printf("  mapped reader (mmap/pointer tokens)  : %9.2f ms  %8.1f MB/s\n", bestMapped, mb / (bestMapped / 1000.0));
+	printf("  speedup: %.2fx   output identical: %s\n", bestLine / bestMapped, same ? "yes" : "NO");
+	return same ? 0 : 1;
+}
+
+//Mapped reader with the MOTION rows decoded on 1, 2, 4, ... threads.
+//Every run is checked against the single threaded result.
+int RunParallelLoadBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int scale = argc > 1 ? atoi(argv[1]) : 100;
+	if (scale < 1) scale = 1;
+
+	std::string scaled = "bvh_bench_scaled.bvh";
+	size_t bytes = BenchWriteScaledBVH(src, scaled, scale);
+	if (bytes == 0)
+	{
+		fprintf(stderr, "could not read %s\n", src.c_str());
+		return 1;
+	}
+	double mb = bytes / (1024.0 * 1024.0);
+
+	int hw = (int)std::thread::hardware_concurrency();
+	//always exercise a few thread counts so the result check means something
+	int maxThreads = hw > 4 ? hw : 4;
+
+	Skeleton refSkel;
+	AnimRec refRec;
+	double refMs = 0;
+	bool allSame = true;
+	printf("file: %s x%d (%.1f MB), %d hardware threads\n", src.c_str(), scale, mb, hw);
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		double best = 1e30;
+		bool same = true;
+		for (int r = 0; r < 3; r++)
+		{
+			Skeleton skel;
+			AnimRec rec;
+			BVHReader reader;
+			reader.SetNumThreads(threads);
+			{
+				BenchQuiet quiet;
+				BenchTimer timer;
+				reader.BuildSkelFromFile(scaled.c_str(), &skel, &rec, false);
+				best = fmin(best, timer.ElapsedMs());
+			}
+			if (threads == 1 && r == 0)
+			{
+				BVHReader refReader;
+				refReader.SetNumThreads(1);
+				BenchQuiet quiet;
+				refReader.BuildSkelFromFile(scaled.c_str(), &refSkel, &refRec, false);
+			}
+			if (r == 0)
+			{
+				same = BenchSameRecords(refSkel, refRec, skel, rec);
+			}
+		}
+		if (threads == 1) refMs = best;
+		allSame = allSame && same;
+		printf("  %2d threads: %9.2f ms  %8.1f MB/s  speedup %.2fx  identical: %s\n",
+			threads, best, mb / (best / 1000.0), refMs / best, same ? "yes" : "NO");
+	}
+	remove(scaled.c_str());
+	return allSame ? 0 : 1;
+}
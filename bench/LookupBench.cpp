@@ -0,0 +1,109 @@
+// LookupBench.cpp : joint lookup by name, the recursive FindNode search vs
+// the hash table behind Skeleton::FindJointIndex.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "Link.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+//keeps the timed lookups from being optimized away
+static volatile size_t s_lookupSink;
+
+//a tree of numJoints named joints, every joint has up to three children
+static void BuildTreeRig(Skeleton& skel, int numJoints)
+{
+	for (int i = 0; i < numJoints; i++)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "Joint%d", i);
+		Link* link = skel.NewLink();
+		link->SetName(name);
+		link->SetJointType(i == 0 ? "free" : "ball");
+		link->SetParTranslation(0, 1, 0);
+		skel.AddToSkeleton(link, i == 0 ? -1 : (i - 1) / 3);
+	}
+}
+
+//times looking up every named joint of skel both ways, false if they disagree
+static bool LookupAll(const char* label, Skeleton& skel, int repeats)
+{
+	std::vector<std::string> names;
+	for (int i = 0; i < skel.GetNumLinks(); i++)
+	{
+		if (skel.GetLink(i)->GetName()[0] != '\0')
+		{
+			names.push_back(skel.GetLink(i)->GetName());
+		}
+	}
+	Link* root = skel.GetLink(0);
+
+	bool same = true;
+	for (size_t n = 0; n < names.size(); n++)
+	{
+		Link* found = skel.FindNode((char*)names[n].c_str(), root);
+		int index = skel.FindJointIndex(names[n]);
+		same = same && found != NULL && index >= 0 && skel.GetLink(index) == found;
+	}
+	same = same && skel.FindJointIndex("no such joint") == -1;
+
+	size_t sink = 0;
+	BenchTimer timer;
+	for (int r = 0; r < repeats; r++)
+	{
+		for (size_t n = 0; n < names.size(); n++)
+		{
+			sink += (size_t)skel.FindNode((char*)names[n].c_str(), root);
+		}
+	}
+	double findNodeNs = timer.ElapsedMs() * 1e6 / ((double)repeats * names.size());
+
+	timer.Reset();
+	for (int r = 0; r < repeats; r++)
+	{
+		for (size_t n = 0; n < names.size(); n++)
+		{
+			sink += (size_t)skel.FindJointIndex(names[n]);
+		}
+	}
+	double hashNs = timer.ElapsedMs() * 1e6 / ((double)repeats * names.size());
+
+	s_lookupSink = sink;
+
+	printf("  %-28s %4d names  FindNode %8.1f ns  FindJointIndex %6.1f ns  %6.1fx  agree: %s\n", label, (int)names.size(),
+		findNodeNs, hashNs, findNodeNs / hashNs, same ? "yes" : "NO");
+	return same;
+}
+
+int RunLookupBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int repeats = argc > 1 ? atoi(argv[1]) : 2000;
+	if (repeats < 1) repeats = 1;
+
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false);
+	}
+	if (skel.GetNumLinks() == 0)
+	{
+		fprintf(stderr, "could not read %s\n", src.c_str());
+		return 1;
+	}
+	printf("file: %s, %d repeats\n", src.c_str(), repeats);
+	bool ok = LookupAll(src.substr(src.find_last_of("/\\") + 1).c_str(), skel, repeats);
+
+	Skeleton tree;
+	BuildTreeRig(tree, 2000);
+	ok = LookupAll("synthetic 2000 joint tree", tree, repeats / 10 > 0 ? repeats / 10 : 1) && ok;
+	return ok ? 0 : 1;
+}
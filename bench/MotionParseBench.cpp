@@ -0,0 +1,173 @@
+// MotionParseBench.cpp : throughput of converting MOTION rows to floats,
+// strtok/atof (what AnimRec::StoreLine(char*) does) against AnimRec::ParseFrame.
+
+#include "BenchUtil.h"
+
+#include "AnimRec.h"
+#include "FastFloat.h"
+#include "defs.h"
+
+#include <vector>
+#include <string>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+struct MotionRows
+{
+	std::string text;
+	std::vector<size_t> rowStart;
+	std::vector<size_t> rowEnd;
+};
+
+//Collects the rows after "Frame Time:" repeated scale times
+static bool LoadMotionRows(const std::string& path, int scale, MotionRows& rows, int& numDOFs)
+{
+	std::string file;
+	if (!BenchReadFile(path, file))
+	{
+		return false;
+	}
+	size_t frameTime = file.find("Frame Time:");
+	if (frameTime == std::string::npos)
+	{
+		return false;
+	}
+	size_t body = file.find('\n', frameTime) + 1;
+	std::string block = file.substr(body);
+	for (int i = 0; i < scale; i++)
+	{
+		rows.text += block;
+		if (!block.empty() && block[block.size() - 1] != '\n') rows.text += '\n';
+	}
+
+	numDOFs = 0;
+	size_t p = 0;
+	while (p < rows.text.size())
+	{
+		size_t nl = rows.text.find('\n', p);
+		if (nl == std::string::npos) nl = rows.text.size();
+		size_t e = nl;
+		while (e > p && (rows.text[e - 1] == '\r' || rows.text[e - 1] == ' ')) e--;
+		if (e > p)
+		{
+			rows.rowStart.push_back(p);
+			rows.rowEnd.push_back(e);
+		}
+		p = nl + 1;
+	}
+	if (!rows.rowStart.empty())
+	{
+		//count the values in the first row
+		std::string first = rows.text.substr(rows.rowStart[0], rows.rowEnd[0] - rows.rowStart[0]);
+		for (char* tok = strtok(&first[0], " \t"); tok; tok = strtok(NULL, " \t")) numDOFs++;
+	}
+	return numDOFs > 0;
+}
+
+//The loop from AnimRec::StoreLine(char*), minus the per frame allocation
+static void ParseRowStrtok(char* line, float* data)
+{
+	int index = 0;
+	char* str = strtok(line, " \t");
+	while (str != NULL && str[0] != 13)
+	{
+		double val = atof(str);
+		data[index] = val;
+		if (index >= 3) data[index] = (data[index] / 180.0) * PI;
+		index++;
+		str = strtok(NULL, " \t");
+	}
+}
+
+//Random numbers in the shapes the parser has to handle, compared with strtod
+static int FuzzParseDouble(int count)
+{
+	std::mt19937 rng(1234);
+	char buf[64];
+	int mismatches = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int shape = rng() % 6;
+		double mag = pow(10.0, (double)(rng() % 12) - 4);
+		double v = ((double)rng() / rng.max() - 0.5) * mag;
+		switch (shape)
+		{
+		case 0: snprintf(buf, sizeof(buf), "%.6f", v); break;
+		case 1: snprintf(buf, sizeof(buf), "%.3f", v); break;
+		case 2: snprintf(buf, sizeof(buf), "%.17g", v); break;
+		case 3: snprintf(buf, sizeof(buf), "%e", v); break;
+		case 4: snprintf(buf, sizeof(buf), "%d", (int)(v * 1000)); break;
+		default: snprintf(buf, sizeof(buf), "%.12f", v); break;
+		}
+		size_t len = strlen(buf);
+		//pad so the fast path is taken whenever the shape allows it
+		std::string padded = std::string(buf) + "                  ";
+		double fast = 0;
+		const char* stop = ParseDouble(padded.c_str(), padded.c_str() + padded.size(), fast);
+		double ref = strtod(buf, NULL);
+		if (memcmp(&fast, &ref, sizeof(double)) != 0 || (size_t)(stop - padded.c_str()) != len)
+		{
+			if (mismatches < 5) fprintf(stderr, "  mismatch: '%s' -> %.17g (strtod %.17g)\n", buf, fast, ref);
+			mismatches++;
+		}
+	}
+	return mismatches;
+}
+
+int RunMotionParseBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int scale = argc > 1 ? atoi(argv[1]) : 100;
+	if (scale < 1) scale = 1;
+
+	MotionRows rows;
+	int numDOFs = 0;
+	if (!LoadMotionRows(src, scale, rows, numDOFs))
+	{
+		fprintf(stderr, "could not read motion from %s\n", src.c_str());
+		return 1;
+	}
+	size_t numRows = rows.rowStart.size();
+	std::vector<float> outA(numRows * numDOFs), outB(numRows * numDOFs);
+	double gb = rows.text.size() / 1e9;
+
+	//strtok writes into the line, so work on a copy made outside the timing
+	double bestA = 1e30;
+	for (int r = 0; r < 3; r++)
+	{
+		std::string scratch = rows.text;
+		BenchTimer timer;
+		for (size_t i = 0; i < numRows; i++)
+		{
+			scratch[rows.rowEnd[i]] = '\0';
+			ParseRowStrtok(&scratch[rows.rowStart[i]], &outA[i * numDOFs]);
+		}
+		bestA = fmin(bestA, timer.ElapsedMs());
+	}
+
+	double bestB = 1e30;
+	const char* base = rows.text.c_str();
+	for (int r = 0; r < 3; r++)
+	{
+		BenchTimer timer;
+		for (size_t i = 0; i < numRows; i++)
+		{
+			AnimRec::ParseFrame(base + rows.rowStart[i], base + rows.rowEnd[i], &outB[i * numDOFs], numDOFs, false);
+		}
+		bestB = fmin(bestB, timer.ElapsedMs());
+	}
+
+	bool same = memcmp(outA.data(), outB.data(), outA.size() * sizeof(float)) == 0;
+	int fuzzCount = 1000000;
+	int mismatches = FuzzParseDouble(fuzzCount);
+
+	printf("motion text: %.1f MB, %zu rows x %d channels\n", rows.text.size() / (1024.0 * 1024.0), numRows, numDOFs);
+	printf("  strtok + atof       : %9.2f ms  %6.3f GB/s\n", bestA, gb / (bestA / 1000.0));
+	printf("  AnimRec::ParseFrame : %9.2f ms  %6.3f GB/s\n", bestB, gb / (bestB / 1000.0));
+	printf("  speedup: %.2fx   output identical: %s\n", bestA / bestB, same ? "yes" : "NO");
+	printf("  ParseDouble vs strtod on %d random numbers: %d mismatches\n", fuzzCount, mismatches);
+	return (same && mismatches == 0) ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+// PipelineBench.cpp : frame time with the animation evaluated on the render
+// thread vs on an AnimationThread one pose ahead.  There is no GL context,
+// so the render stage is the instance copy plus a sleep standing in for the
+// time the GL thread spends blocked on the driver and the swap.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+#include "AnimationThread.h"
+#include "MotionCache.h"
+
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int RunPipelineBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int numCharacters = argc > 1 ? atoi(argv[1]) : 2000;
+	double renderMs = argc > 2 ? atof(argv[2]) : 4.0;
+	if (numCharacters < 1) numCharacters = 1;
+	const int numFrames = 200;
+
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		if (!reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false) || rec.GetNumFrames() == 0)
+		{
+			fprintf(stderr, "could not read %s\n", src.c_str());
+			return 1;
+		}
+	}
+	skel.AddGeometry();
+	int numLinks = skel.GetNumLinks();
+	int numBones = skel.GetNumBones();
+	size_t instanceBytes = (size_t)numBones * numCharacters * sizeof(mat4x4);
+	std::vector<char> upload(instanceBytes);
+	std::chrono::microseconds renderWait((long long)(renderMs * 1000.0));
+
+	//serial: sample, pose and draw one after the other on one thread
+	std::vector<mat4x4> world((size_t)numLinks * numCharacters);
+	std::vector<mat4x4> instances((size_t)numBones * numCharacters);
+	std::vector<const float*> frames(numCharacters);
+	double serialSimMs = 0;
+	BenchTimer total;
+	for (int f = 0; f < numFrames; f++)
+	{
+		BenchTimer sim;
+		for (int c = 0; c < numCharacters; c++)
+		{
+			frames[c] = rec.GetFrameData((f + c * 7) % rec.GetNumFrames());
+		}
+		skel.ComputePoses(frames.data(), numCharacters, world.data());
+		for (int c = 0; c < numCharacters; c++)
+		{
+			skel.CalcBoneInstances(&world[(size_t)c * numLinks], &instances[(size_t)c * numBones]);
+		}
+		serialSimMs += sim.ElapsedMs();
+
+		memcpy(upload.data(), instances.data(), instanceBytes);
+		std::this_thread::sleep_for(renderWait);
+	}
+	double serialFrameMs = total.ElapsedMs() / numFrames;
+	serialSimMs /= numFrames;
+
+	//pipelined: the animation thread works on the next pose during the render
+	AnimationThread anim;
+	anim.Start(&skel, &rec, numCharacters);
+	uint64_t lastSequence = 0;
+	int repeats = 0;
+	bool ordered = true;
+	double renderSum = 0;
+	total.Reset();
+	for (int f = 0; f < numFrames; f++)
+	{
+		BenchTimer render;
+		const PoseFrame* pose = anim.Acquire();
+		ordered = ordered && pose != NULL && pose->sequence >= lastSequence;
+		repeats += pose->sequence == lastSequence;
+		lastSequence = pose->sequence;
+		memcpy(upload.data(), pose->instances, instanceBytes);
+		std::this_thread::sleep_for(renderWait);
+		renderSum += render.ElapsedMs();
+	}
+	double pipelinedFrameMs = total.ElapsedMs() / numFrames;
+	double pipelinedSimMs = anim.GetAverageSimMs();
+	anim.Stop();
+
+	//The same with the instances written straight into three regions of one
+	//buffer, as the player does with a mapped stream buffer.  Every other
+	//frame the "GPU" is still reading the last pose's region, so the pose is
+	//kept, and a kept pose's region must not change until it is let go.
+	size_t slotMatrices = (size_t)numBones * numCharacters;
+	std::vector<mat4x4> regionMemory(slotMatrices * 3);
+	mat4x4* regions[3] = { &regionMemory[0], &regionMemory[slotMatrices], &regionMemory[slotMatrices * 2] };
+	AnimationThread direct;
+	direct.SetInstanceStorage(regions);
+	direct.Start(&skel, &rec, numCharacters);
+	const PoseFrame* held = NULL;
+	uint64_t heldHash = 0;
+	int kept = 0;
+	bool inRegions = true, keptSame = true, untouched = true;
+	for (int f = 0; f < numFrames; f++)
+	{
+		bool idle = held == NULL || f % 2 == 0;
+		const PoseFrame* pose = direct.Acquire(idle);
+		inRegions = inRegions && pose != NULL && pose->instances == regions[pose->slot];
+		keptSame = keptSame && (idle || pose == held);
+		kept += !idle;
+		std::this_thread::sleep_for(renderWait);
+		uint64_t hash = MotionCache::HashBytes(pose->instances, instanceBytes);
+		untouched = untouched && (pose != held || hash == heldHash);
+		held = pose;
+		heldHash = hash;
+	}
+	direct.Stop();
+	bool handoff = inRegions && keptSame && untouched;
+
+	double renderStageMs = renderSum / numFrames;
+	printf("file: %s, %d characters, render stage %.1f ms, %d hardware threads\n", src.c_str(), numCharacters, renderMs,
+		(int)std::thread::hardware_concurrency());
+	printf("  serial     frame %7.3f ms  (sim %.3f ms + render)\n", serialFrameMs, serialSimMs);
+	printf("  pipelined  frame %7.3f ms  (sim %.3f ms on the animation thread, render %.3f ms)  %.2fx\n",
+		pipelinedFrameMs, pipelinedSimMs, renderStageMs, serialFrameMs / pipelinedFrameMs);
+	printf("  poses in order: %s   frames that reused the previous pose: %d\n", ordered ? "yes" : "NO", repeats);
+	printf("  caller's instance storage: used %s, %d poses kept for the GPU, kept poses unchanged %s\n",
+		inRegions ? "yes" : "NO", kept, keptSame && untouched ? "yes" : "NO");
+	return ordered && handoff ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+// QuatBench.cpp : Euler angle clip vs quaternion clip.  Quality is the
+// angle between each joint's blended rotation and the exact slerp a quarter
+// of the way between frames, throughput is sampling plus FK per pose.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "QuatClip.h"
+#include "BVHReader.h"
+#include "Link.h"
+#include "defs.h"
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+//angle in degrees of the rotation between unit quaternions a and b.  Taken
+//from the chord |a - b| rather than acos of the dot product, which can't
+//resolve small angles in float.
+static double QuatAngle(const float* a, const float* b)
+{
+	double minus = 0, plus = 0;
+	for (int k = 0; k < 4; k++)
+	{
+		minus += ((double)a[k] - b[k]) * ((double)a[k] - b[k]);
+		plus += ((double)a[k] + b[k]) * ((double)a[k] + b[k]);
+	}
+	double chord = sqrt(fmin(minus, plus));
+	return 4.0 * asin(fmin(chord * 0.5, 1.0)) * 180.0 / PI;
+}
+
+static double MaxMatrixDiff(const mat4x4* a, const mat4x4* b, int count)
+{
+	double diff = 0;
+	for (int j = 0; j < count; j++)
+		for (int c = 0; c < 4; c++)
+			for (int r = 0; r < 4; r++)
+				diff = fmax(diff, fabs(a[j][c][r] - b[j][c][r]));
+	return diff;
+}
+
+int RunQuatBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int numSamples = argc > 1 ? atoi(argv[1]) : 20000;
+	if (numSamples < 1) numSamples = 1;
+
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		if (!reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false) || rec.GetNumFrames() < 2)
+		{
+			fprintf(stderr, "could not read %s\n", src.c_str());
+			return 1;
+		}
+	}
+	int numFrames = rec.GetNumFrames();
+	int numLinks = skel.GetNumLinks();
+	double frameTime = rec.GetFrameTime();
+	double duration = frameTime * (numFrames - 1);
+
+	BenchTimer timer;
+	QuatClip clip;
+	clip.Build(&skel, &rec);
+	double buildMs = timer.ElapsedMs();
+
+	//on the frames both clips must give the same world matrices, through the
+	//flattened loop and through the links
+	std::vector<mat4x4> euler(numLinks);
+	std::vector<float> pose(clip.GetPoseSize());
+	double frameDiff = 0, linkDiff = 0;
+	for (int f = 0; f < numFrames; f += 7)
+	{
+		skel.ComputePose(rec.GetFrameData(f));
+		memcpy(euler.data(), skel.GetWorldMatrices(), sizeof(mat4x4) * numLinks);
+		clip.Sample(f * frameTime, pose.data());
+		skel.ComputePoseQuat(pose.data());
+		frameDiff = fmax(frameDiff, MaxMatrixDiff(euler.data(), skel.GetWorldMatrices(), numLinks));
+
+		skel.SetSkelStateQuat(pose.data());
+		skel.UpdateLinks();
+		for (int j = 0; j < numLinks; j++)
+		{
+			mat4x4 m;
+			skel.GetLink(j)->GetLToWTransMat(m);
+			linkDiff = fmax(linkDiff, MaxMatrixDiff(&m, &skel.GetWorldMatrices()[j], 1));
+		}
+	}
+
+	//a quarter of the way between frames, against slerp
+	std::vector<float> exact(clip.GetPoseSize()), nlerp(clip.GetPoseSize()), fromEuler(clip.GetPoseSize());
+	std::vector<float> eulerFrame(rec.GetFrameStride());
+	double eulerMax = 0, eulerSum = 0, nlerpMax = 0, nlerpSum = 0;
+	int numJoints = 0;
+	for (int f = 0; f + 1 < numFrames; f++)
+	{
+		double t = (f + 0.25) * frameTime;
+		clip.SampleSlerp(t, exact.data());
+		clip.Sample(t, nlerp.data());
+		rec.Sample(t, eulerFrame.data());
+		skel.EulerToQuatPose(eulerFrame.data(), fromEuler.data());
+		for (int q = 4; q < clip.GetPoseSize(); q += 4)
+		{
+			double e = QuatAngle(&exact[q], &fromEuler[q]);
+			double n = QuatAngle(&exact[q], &nlerp[q]);
+			eulerMax = fmax(eulerMax, e);
+			nlerpMax = fmax(nlerpMax, n);
+			eulerSum += e;
+			nlerpSum += n;
+			numJoints++;
+		}
+	}
+
+	//sampling alone and sampling plus FK, at times spread over the clip
+	std::vector<double> times(numSamples);
+	for (int i = 0; i < numSamples; i++)
+	{
+		times[i] = duration * ((i * 0.618033988749895) - floor(i * 0.618033988749895));
+	}
+	double sink = 0;
+	double ns[3][2];
+	for (int path = 0; path < 3; path++)
+	{
+		timer.Reset();
+		for (int i = 0; i < numSamples; i++)
+		{
+			if (path == 0) rec.Sample(times[i], eulerFrame.data());
+			else if (path == 1) clip.Sample(times[i], pose.data());
+			else clip.SampleSlerp(times[i], pose.data());
+		}
+		ns[path][0] = timer.ElapsedMs() * 1e6 / numSamples;
+
+		timer.Reset();
+		for (int i = 0; i < numSamples; i++)
+		{
+			if (path == 0)
+			{
+				rec.Sample(times[i], eulerFrame.data());
+				skel.ComputePose(eulerFrame.data());
+			}
+			else
+			{
+				if (path == 1) clip.Sample(times[i], pose.data());
+				else clip.SampleSlerp(times[i], pose.data());
+				skel.ComputePoseQuat(pose.data());
+			}
+			sink += skel.GetWorldMatrices()[numLinks - 1][3][1];
+		}
+		ns[path][1] = timer.ElapsedMs() * 1e6 / numSamples;
+	}
+
+	printf("file: %s, %d frames, %d links (checksum %g)\n", src.c_str(), numFrames, numLinks, sink);
+	printf("  quaternion clip built in %.2f ms, %.1f KB (Euler frames %.1f KB)\n", buildMs,
+		clip.GetMemoryUsage() / 1024.0, (double)numFrames * rec.GetFrameStride() * sizeof(float) / 1024.0);
+	printf("  on frames, max |difference| of world matrices: %g  (links %g)\n", frameDiff, linkDiff);
+	printf("  quarter way, degrees off slerp     max      mean\n");
+	printf("    Euler lerp                %8.4f  %8.5f\n", eulerMax, eulerSum / numJoints);
+	printf("    nlerp                     %8.4f  %8.5f\n", nlerpMax, nlerpSum / numJoints);
+	printf("  path                  sample ns/pose  sample+FK ns/pose\n");
+	printf("    Euler Sample          %10.1f  %16.1f\n", ns[0][0], ns[0][1]);
+	printf("    quaternion nlerp      %10.1f  %16.1f\n", ns[1][0], ns[1][1]);
+	printf("    quaternion slerp      %10.1f  %16.1f\n", ns[2][0], ns[2][1]);
+	bool ok = frameDiff < 1e-4 && linkDiff < 1e-4 && nlerpMax <= eulerMax + 1e-3;
+	return ok ? 0 : 1;
+}
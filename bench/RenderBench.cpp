@@ -0,0 +1,164 @@
+// RenderBench.cpp : CPU side of drawing a crowd, per vertex bone pyramids
+// built on the CPU vs one instance matrix per bone for instanced drawing.
+// Only the work up to the buffer upload is timed, there is no GL context.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "Link.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+//Largest difference between the player's old CPU vertices (without the root's
+//pyramid) and the unit pyramid transformed by the bone instance matrices
+static double CompareInstances(Skeleton& skel, AnimRec& rec, int frame)
+{
+	std::vector<double> state(rec.GetNumDOFs());
+	rec.GetFrame(frame, state.data());
+	skel.SetSkelState(state.data());
+	skel.UpdateLinks();
+	int maxEntries = skel.GetNumVertices();
+	std::vector<VERTEX> verts(maxEntries);
+	VERTEX* vertData = verts.data();
+	int vertCount = 0;
+	skel.CalcVertexLocations(maxEntries, &vertCount, &vertData);
+
+	skel.ComputePose(rec.GetFrameData(frame));
+	std::vector<mat4x4> instances(skel.GetNumBones());
+	skel.CalcBoneInstances(skel.GetWorldMatrices(), instances.data());
+
+	VERTEX mesh[12];
+	Link::MakeBonePyramid(1.0f, mesh);
+	double maxDiff = 0;
+	for (int b = 0; b < skel.GetNumBones(); b++)
+	{
+		for (int v = 0; v < 12; v++)
+		{
+			vec4 in = { mesh[v].x, mesh[v].y, mesh[v].z, 1.0f };
+			vec4 out;
+			mat4x4_mul_vec4(out, instances[b], in);
+			const VERTEX& cpu = verts[(b + 1) * 12 + v];
+			maxDiff = fmax(maxDiff, fabs(out[0] - cpu.x));
+			maxDiff = fmax(maxDiff, fabs(out[1] - cpu.y));
+			maxDiff = fmax(maxDiff, fabs(out[2] - cpu.z));
+		}
+	}
+	return maxDiff;
+}
+
+int RunRenderBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int numCharacters = argc > 1 ? atoi(argv[1]) : 200;
+	if (numCharacters < 1) numCharacters = 1;
+	const int numSteps = 60;
+
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		if (!reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false) || rec.GetNumFrames() == 0)
+		{
+			fprintf(stderr, "could not read %s\n", src.c_str());
+			return 1;
+		}
+	}
+	skel.AddGeometry();
+	int numFrames = rec.GetNumFrames();
+	int numLinks = skel.GetNumLinks();
+	int numBones = skel.GetNumBones();
+
+	//every character plays the clip from a different start
+	std::vector<int> start(numCharacters);
+	for (int c = 0; c < numCharacters; c++)
+	{
+		start[c] = (int)((long long)c * 7919 % numFrames);
+	}
+
+	//per vertex: pose the links and transform 12 vertices per link
+	int maxEntries = skel.GetNumVertices();
+	std::vector<VERTEX> verts((size_t)maxEntries * numCharacters);
+	std::vector<double> state(rec.GetNumDOFs());
+	BenchTimer timer;
+	for (int s = 0; s < numSteps; s++)
+	{
+		for (int c = 0; c < numCharacters; c++)
+		{
+			rec.GetFrame((start[c] + s) % numFrames, state.data());
+			skel.SetSkelState(state.data());
+			skel.UpdateLinks();
+			VERTEX* dst = &verts[(size_t)c * maxEntries];
+			int vertCount = 0;
+			skel.CalcVertexLocations(maxEntries, &vertCount, &dst);
+		}
+	}
+	double vertexMs = timer.ElapsedMs() / numSteps;
+	size_t vertexBytes = verts.size() * sizeof(VERTEX);
+
+	//instanced: world matrices, then one matrix per bone
+	std::vector<mat4x4> world((size_t)numLinks * numCharacters);
+	std::vector<mat4x4> instances((size_t)numBones * numCharacters);
+	timer.Reset();
+	for (int s = 0; s < numSteps; s++)
+	{
+		for (int c = 0; c < numCharacters; c++)
+		{
+			skel.ComputePose(rec.GetFrameData((start[c] + s) % numFrames));
+			skel.CalcBoneInstances(skel.GetWorldMatrices(), &instances[(size_t)c * numBones]);
+		}
+	}
+	double instanceMs = timer.ElapsedMs() / numSteps;
+
+	//the same with all the characters' poses computed in one batch
+	std::vector<const float*> frames(numCharacters);
+	timer.Reset();
+	for (int s = 0; s < numSteps; s++)
+	{
+		for (int c = 0; c < numCharacters; c++)
+		{
+			frames[c] = rec.GetFrameData((start[c] + s) % numFrames);
+		}
+		skel.ComputePoses(frames.data(), numCharacters, world.data());
+		for (int c = 0; c < numCharacters; c++)
+		{
+			skel.CalcBoneInstances(&world[(size_t)c * numLinks], &instances[(size_t)c * numBones]);
+		}
+	}
+	double batchMs = timer.ElapsedMs() / numSteps;
+	size_t instanceBytes = instances.size() * sizeof(mat4x4);
+
+	//Without a persistent mapping the player copies the animation thread's
+	//finished instances into the stream buffer's staging memory.  With one
+	//they are written in place and this is saved.
+	std::vector<char> regions(instanceBytes * 3);
+	timer.Reset();
+	for (int s = 0; s < numSteps; s++)
+	{
+		memcpy(&regions[(size_t)(s % 3) * instanceBytes], instances.data(), instanceBytes);
+	}
+	double copyMs = timer.ElapsedMs() / numSteps;
+
+	double maxDiff = 0;
+	for (int f = 0; f < numFrames; f += numFrames / 8 + 1)
+	{
+		maxDiff = fmax(maxDiff, CompareInstances(skel, rec, f));
+	}
+
+	printf("file: %s, %d characters of %d bones, per frame:\n", src.c_str(), numCharacters, numBones);
+	printf("  path                                ms   CPU vertices  upload KB\n");
+	printf("  CPU vertices (links)          %8.3f   %12d  %9.1f\n", vertexMs, maxEntries * numCharacters, vertexBytes / 1024.0);
+	printf("  instances (ComputePose)       %8.3f   %12d  %9.1f  %5.2fx\n", instanceMs, 0, instanceBytes / 1024.0, vertexMs / instanceMs);
+	printf("  instances (ComputePoses)      %8.3f   %12d  %9.1f  %5.2fx\n", batchMs, 0, instanceBytes / 1024.0, vertexMs / batchMs);
+	printf("  copy, glBufferSubData path    %8.3f   (%.1f%% of ComputePoses, none when mapped)\n",
+		copyMs, 100.0 * copyMs / batchMs);
+	printf("  max |difference| of instanced vertices to CPU vertices: %g\n", maxDiff);
+	return maxDiff < 1e-4 ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+// SampleBench.cpp : poses at arbitrary times.  Truncating to the frame
+// before (what the player used to do), the old per channel Interpolate with
+// its angle wrap branches, and AnimRec::Sample on the unwrapped sample view.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+#include "defs.h"
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+//AnimRec::Interpolate as it was, for comparison
+static bool LegacyInterpolate(AnimRec& rec, double time, double* val)
+{
+	int startFrame = time / rec.GetFrameTime();
+	double weight = time / rec.GetFrameTime() - startFrame;
+	int size = rec.GetNumFrames();
+	if (startFrame >= size)
+	{
+		return false;
+	}
+	const float* low = rec.GetFrameData(startFrame);
+	const float* high = startFrame + 1 < size ? rec.GetFrameData(startFrame + 1) : low;
+	for (int i = 0; i < rec.GetNumDOFs(); i++)
+	{
+		val[i] = (1 - weight) * low[i] + weight * high[i];
+		if (fabs(low[i] - high[i]) > 6)
+		{
+			float useLow = low[i], useHigh = high[i];
+			if ((low[i] < 0 && high[i] > 0) || low[i] < -3)
+			{
+				useLow = low[i] + 2 * PI;
+			}
+			else if ((low[i] > 0 && high[i] < 0) || high[i] < -3)
+			{
+				useHigh = high[i] + 2 * PI;
+			}
+			val[i] = (1 - weight) * useLow + weight * useHigh;
+		}
+	}
+	return true;
+}
+
+//difference of two channel values, angles compared modulo a whole turn
+static double ChannelDiff(int dof, double a, double b)
+{
+	double d = a - b;
+	return fabs(dof < 3 ? d : remainder(d, 2 * PI));
+}
+
+int RunSampleBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int numSamples = argc > 1 ? atoi(argv[1]) : 200000;
+	if (numSamples < 1) numSamples = 1;
+
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		if (!reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false) || rec.GetNumFrames() < 2)
+		{
+			fprintf(stderr, "could not read %s\n", src.c_str());
+			return 1;
+		}
+	}
+	int numFrames = rec.GetNumFrames();
+	int numDOFs = rec.GetNumDOFs();
+	double frameTime = rec.GetFrameTime();
+	double duration = frameTime * (numFrames - 1);
+
+	//sample times spread over the clip, off the frame grid
+	std::vector<double> times(numSamples);
+	for (int i = 0; i < numSamples; i++)
+	{
+		times[i] = duration * ((i * 0.618033988749895) - floor(i * 0.618033988749895));
+	}
+
+	//angles that jump by more than half a turn between frames
+	int wraps = 0;
+	for (int f = 1; f < numFrames; f++)
+	{
+		for (int d = 3; d < numDOFs; d++)
+		{
+			wraps += fabs(rec.GetFrameData(f)[d] - rec.GetFrameData(f - 1)[d]) > PI;
+		}
+	}
+
+	std::vector<double> state(numDOFs);
+	double sink = 0;
+	BenchTimer timer;
+	for (int i = 0; i < numSamples; i++)
+	{
+		rec.GetFrame((int)(times[i] / frameTime), state.data());
+		sink += state[numDOFs - 1];
+	}
+	double truncNs = timer.ElapsedMs() * 1e6 / numSamples;
+
+	timer.Reset();
+	for (int i = 0; i < numSamples; i++)
+	{
+		LegacyInterpolate(rec, times[i], state.data());
+		sink += state[numDOFs - 1];
+	}
+	double legacyNs = timer.ElapsedMs() * 1e6 / numSamples;
+
+	timer.Reset();
+	rec.BuildSampleView();
+	double buildMs = timer.ElapsedMs();
+
+	std::vector<float> pose(rec.GetFrameStride());
+	timer.Reset();
+	for (int i = 0; i < numSamples; i++)
+	{
+		rec.Sample(times[i], pose.data());
+		sink += pose[numDOFs - 1];
+	}
+	double sampleNs = timer.ElapsedMs() * 1e6 / numSamples;
+
+	//on a frame the sample is that frame, half way it is the blend of the
+	//two frames along the short way round
+	double frameDiff = 0, midDiff = 0;
+	for (int f = 0; f + 1 < numFrames; f++)
+	{
+		const float* lo = rec.GetFrameData(f);
+		const float* hi = rec.GetFrameData(f + 1);
+		rec.Sample(f * frameTime, pose.data());
+		for (int d = 0; d < numDOFs; d++)
+		{
+			frameDiff = fmax(frameDiff, ChannelDiff(d, pose[d], lo[d]));
+		}
+		rec.Sample((f + 0.5) * frameTime, pose.data());
+		for (int d = 0; d < numDOFs; d++)
+		{
+			double step = d < 3 ? hi[d] - lo[d] : remainder((double)hi[d] - lo[d], 2 * PI);
+			midDiff = fmax(midDiff, ChannelDiff(d, pose[d], lo[d] + 0.5 * step));
+		}
+	}
+	bool interpolated = rec.Interpolate(0.5 * frameTime, state.data()) && !rec.Interpolate(numFrames * frameTime, state.data());
+
+	printf("file: %s, %d frames of %d channels, %d samples (checksum %g)\n", src.c_str(), numFrames, numDOFs, numSamples, sink);
+	printf("  angle channels wrapping between frames: %d\n", wraps);
+	printf("  GetFrame, frame before    %8.1f ns/sample\n", truncNs);
+	printf("  old Interpolate           %8.1f ns/sample\n", legacyNs);
+	printf("  Sample                    %8.1f ns/sample  %5.2fx  (sample view built in %.2f ms)\n", sampleNs, legacyNs / sampleNs, buildMs);
+	printf("  max |difference| on frames: %g, half way between frames: %g\n", frameDiff, midDiff);
+	bool ok = interpolated && frameDiff < 1e-4 && midDiff < 1e-4;
+	return ok ? 0 : 1;
+}
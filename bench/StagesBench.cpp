@@ -0,0 +1,318 @@
+// StagesBench.cpp : every stage the player goes through, from reading the
+// file to the bone vertices, timed on its own over the bundled files and
+// synthetic rigs.  Reports ns/op with percentiles and heap allocations per
+// op, as a table or (with --json) as one JSON document for tracking
+// regressions from build to build:
+//
+//   bvh_bench stages --json [file.bvh ...] > stages.json
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+#include "defs.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+//a timed batch of calls should take at least this long, so the clock's own
+//cost doesn't show in the fast stages
+#define STAGE_MIN_BATCH_US 20.0
+//samples per stage, fewer for stages slow enough to blow STAGE_BUDGET_MS
+#define STAGE_SAMPLES 100
+#define STAGE_MIN_SAMPLES 5
+#define STAGE_BUDGET_MS 300.0
+
+//synthetic rigs measured after the bundled files
+#define STAGE_SYNTHETIC_FRAMES 120
+static const int s_syntheticJoints[] = { 500, 2000 };
+
+struct StageResult
+{
+	std::string input;
+	int numLinks;
+	int numFrames;
+	const char* stage;
+	long long ops;
+	int samples;
+	//over the samples, each one a batch's time divided by its calls
+	double meanNs, minNs, p50Ns, p90Ns, p99Ns;
+	double allocsPerOp;
+};
+
+//nearest rank percentile of sorted values
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+	int rank = (int)ceil(p * sorted.size());
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+//Calls op(i) with a running i in timed batches, after one untimed call for
+//anything built on first use
+template <class Op> static void MeasureStage(StageResult& r, Op op)
+{
+	op(0);
+	long long next = 1;
+
+	long long batch = 1;
+	double batchMs = 0;
+	for (;;)
+	{
+		BenchTimer timer;
+		for (long long i = 0; i < batch; i++) op(next++);
+		batchMs = timer.ElapsedMs();
+		if (batchMs * 1000.0 >= STAGE_MIN_BATCH_US || batch >= (1 << 20)) break;
+		batch *= 2;
+	}
+	int samples = batchMs * STAGE_SAMPLES > STAGE_BUDGET_MS ? (int)(STAGE_BUDGET_MS / batchMs) : STAGE_SAMPLES;
+	samples = std::max(samples, STAGE_MIN_SAMPLES);
+
+	std::vector<double> ns(samples);
+	double total = 0;
+	uint64_t allocsBefore = BenchAllocationCount();
+	for (int s = 0; s < samples; s++)
+	{
+		BenchTimer timer;
+		for (long long i = 0; i < batch; i++) op(next++);
+		ns[s] = timer.ElapsedMs() * 1e6 / batch;
+		total += ns[s];
+	}
+	uint64_t allocs = BenchAllocationCount() - allocsBefore;
+
+	std::sort(ns.begin(), ns.end());
+	r.ops = batch * samples;
+	r.samples = samples;
+	r.meanNs = total / samples;
+	r.minNs = ns[0];
+	r.p50Ns = Percentile(ns, 0.50);
+	r.p90Ns = Percentile(ns, 0.90);
+	r.p99Ns = Percentile(ns, 0.99);
+	r.allocsPerOp = (double)allocs / r.ops;
+}
+
+//Measures every stage on one file, appending a result per stage.  name is
+//what the results are reported under.
+static bool MeasureFile(const std::string& path, const std::string& name, std::vector<StageResult>& results)
+{
+	BenchQuiet quiet;
+	Skeleton skel;
+	AnimRec rec;
+	BVHReader reader;
+	if (!reader.BuildSkelFromFile(path.c_str(), &skel, &rec, false) || rec.GetNumFrames() == 0)
+	{
+		return false;
+	}
+	skel.AddGeometry();
+	int numFrames = rec.GetNumFrames();
+	int numDOFs = rec.GetNumDOFs();
+	double duration = numFrames * (double)rec.GetFrameTime();
+
+	StageResult base;
+	base.input = name;
+	base.numLinks = skel.GetNumLinks();
+	base.numFrames = numFrames;
+
+	//a few frames' states to cycle through, so SetSkelState doesn't see the
+	//same values every time
+	const int numStates = std::min(numFrames, 64);
+	std::vector<double> states((size_t)numStates * numDOFs);
+	for (int f = 0; f < numStates; f++)
+	{
+		rec.GetFrame((int)((long long)f * numFrames / numStates), &states[(size_t)f * numDOFs]);
+	}
+	std::vector<double> state(numDOFs);
+	int maxEntries = skel.GetNumVertices();
+	std::vector<VERTEX> verts(maxEntries);
+
+	StageResult r = base;
+	r.stage = "BuildSkelFromHeader";
+	MeasureStage(r, [&](long long)
+	{
+		Skeleton s;
+		AnimRec a;
+		BVHReader lineReader;
+		std::ifstream file(path.c_str());
+		lineReader.BuildSkelFromHeader(file, &s, &a, false);
+	});
+	results.push_back(r);
+
+	r = base;
+	r.stage = "BuildSkelFromFile";
+	MeasureStage(r, [&](long long)
+	{
+		Skeleton s;
+		AnimRec a;
+		BVHReader mappedReader;
+		mappedReader.BuildSkelFromFile(path.c_str(), &s, &a, false);
+	});
+	results.push_back(r);
+
+	r = base;
+	r.stage = "GetFrame";
+	MeasureStage(r, [&](long long i)
+	{
+		rec.GetFrame((int)(i % numFrames), state.data());
+	});
+	results.push_back(r);
+
+	r = base;
+	r.stage = "Interpolate";
+	MeasureStage(r, [&](long long i)
+	{
+		rec.Interpolate(fmod(i * 0.0123, duration), state.data());
+	});
+	results.push_back(r);
+
+	r = base;
+	r.stage = "SetSkelState";
+	MeasureStage(r, [&](long long i)
+	{
+		skel.SetSkelState(&states[(size_t)(i % numStates) * numDOFs]);
+	});
+	results.push_back(r);
+
+	r = base;
+	r.stage = "UpdateLinks";
+	MeasureStage(r, [&](long long)
+	{
+		skel.UpdateLinks();
+	});
+	results.push_back(r);
+
+	r = base;
+	r.stage = "CalcVertexLocations";
+	MeasureStage(r, [&](long long)
+	{
+		VERTEX* out = verts.data();
+		int count = 0;
+		skel.CalcVertexLocations(maxEntries, &count, &out);
+	});
+	results.push_back(r);
+
+	r = base;
+	r.stage = "ComputePose";
+	MeasureStage(r, [&](long long i)
+	{
+		skel.ComputePose(rec.GetFrameData((int)(i % numFrames)));
+	});
+	results.push_back(r);
+	return true;
+}
+
+//file name without the directories
+static std::string BaseName(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static void PrintJsonString(const std::string& s)
+{
+	putchar('"');
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		unsigned char c = (unsigned char)s[i];
+		if (c == '"' || c == '\\') printf("\\%c", c);
+		else if (c < 0x20) printf("\\u%04x", c);
+		else putchar(c);
+	}
+	putchar('"');
+}
+
+static void PrintJson(const std::vector<StageResult>& results)
+{
+	printf("{\n  \"suite\": \"stages\",\n  \"hardware_threads\": %d,\n  \"results\": [\n",
+		(int)std::thread::hardware_concurrency());
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const StageResult& r = results[i];
+		printf("    { \"input\": ");
+		PrintJsonString(r.input);
+		printf(", \"links\": %d, \"frames\": %d, \"stage\": \"%s\", \"ops\": %lld, \"samples\": %d, "
+			"\"ns_per_op\": %.2f, \"min_ns\": %.2f, \"p50_ns\": %.2f, \"p90_ns\": %.2f, \"p99_ns\": %.2f, "
+			"\"allocs_per_op\": %.3f }%s\n",
+			r.numLinks, r.numFrames, r.stage, r.ops, r.samples, r.meanNs, r.minNs, r.p50Ns, r.p90Ns, r.p99Ns,
+			r.allocsPerOp, i + 1 < results.size() ? "," : "");
+	}
+	printf("  ]\n}\n");
+}
+
+static void PrintTable(const std::vector<StageResult>& results)
+{
+	std::string input;
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const StageResult& r = results[i];
+		if (r.input != input)
+		{
+			input = r.input;
+			printf("%s: %d links, %d frames\n", r.input.c_str(), r.numLinks, r.numFrames);
+			printf("  stage                         ns/op         p50         p90         p99  allocs/op\n");
+		}
+		printf("  %-20s %12.1f %11.1f %11.1f %11.1f %10.2f\n", r.stage, r.meanNs, r.p50Ns, r.p90Ns, r.p99Ns, r.allocsPerOp);
+	}
+}
+
+int RunStagesBench(int argc, char** argv)
+{
+	bool json = argc > 0 && strcmp(argv[0], "--json") == 0;
+	if (json)
+	{
+		argc--;
+		argv++;
+	}
+
+	std::vector<StageResult> results;
+	bool ok = true;
+	if (argc > 0)
+	{
+		for (int i = 0; i < argc; i++)
+		{
+			if (!MeasureFile(argv[i], BaseName(argv[i]), results))
+			{
+				fprintf(stderr, "could not read %s\n", argv[i]);
+				ok = false;
+			}
+		}
+	}
+	else
+	{
+		static const char* bundled[] = { "ZooExcited.bvh", "TestBlank.bvh", "TestX45.bvh", "TestZ45.bvh", "TestZ45Y90.bvh" };
+		for (size_t i = 0; i < sizeof(bundled) / sizeof(bundled[0]); i++)
+		{
+			if (!MeasureFile(BenchDataPath(bundled[i]), bundled[i], results))
+			{
+				fprintf(stderr, "could not read %s\n", bundled[i]);
+				ok = false;
+			}
+		}
+		for (size_t i = 0; i < sizeof(s_syntheticJoints) / sizeof(s_syntheticJoints[0]); i++)
+		{
+			int numJoints = s_syntheticJoints[i];
+			std::string path = "bvh_bench_stages.bvh";
+			std::string name = "synthetic_" + std::to_string(numJoints) + "_joints";
+			if (BenchWriteSyntheticBVH(path, numJoints, STAGE_SYNTHETIC_FRAMES) == 0 || !MeasureFile(path, name, results))
+			{
+				fprintf(stderr, "could not measure %s\n", name.c_str());
+				ok = false;
+			}
+			remove(path.c_str());
+		}
+	}
+
+	if (json)
+	{
+		PrintJson(results);
+	}
+	else
+	{
+		PrintTable(results);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+// StorageBench.cpp : memory held by AnimRec and the cost of walking it
+// frame by frame (AoS) or channel by channel (SoA).
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+//Per frame new float[numDOFs] plus a vector of pointers, which is how
+//frames used to be stored.  16 bytes of allocator header per block and
+//16 byte granularity is what glibc and the MSVC CRT use on 64 bit.
+static size_t LegacyMemoryEstimate(int numFrames, int numDOFs)
+{
+	size_t block = ((size_t)numDOFs * sizeof(float) + 15) / 16 * 16 + 16;
+	return (size_t)numFrames * (block + sizeof(float*));
+}
+
+//3 tap smoothing of every channel, reading through the frame-major layout
+static double FilterFrameMajor(AnimRec& rec, std::vector<float>& out)
+{
+	int numFrames = rec.GetNumFrames(), numDOFs = rec.GetNumDOFs(), stride = rec.GetFrameStride();
+	const float* base = rec.GetFrameData(0);
+	BenchTimer timer;
+	for (int c = 0; c < numDOFs; c++)
+	{
+		float* dst = &out[(size_t)c * numFrames];
+		for (int f = 1; f < numFrames - 1; f++)
+		{
+			dst[f] = 0.25f * base[(size_t)(f - 1) * stride + c] + 0.5f * base[(size_t)f * stride + c]
+				+ 0.25f * base[(size_t)(f + 1) * stride + c];
+		}
+	}
+	return timer.ElapsedMs();
+}
+
+//same filter on the channel-major view
+static double FilterChannelMajor(AnimRec& rec, std::vector<float>& out)
+{
+	int numFrames = rec.GetNumFrames(), numDOFs = rec.GetNumDOFs();
+	BenchTimer timer;
+	for (int c = 0; c < numDOFs; c++)
+	{
+		const float* src = rec.GetChannelData(c);
+		float* dst = &out[(size_t)c * numFrames];
+		for (int f = 1; f < numFrames - 1; f++)
+		{
+			dst[f] = 0.25f * src[f - 1] + 0.5f * src[f] + 0.25f * src[f + 1];
+		}
+	}
+	return timer.ElapsedMs();
+}
+
+int RunStorageBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int scale = argc > 1 ? atoi(argv[1]) : 100;
+	if (scale < 1) scale = 1;
+
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		if (!reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false))
+		{
+			fprintf(stderr, "could not read %s\n", src.c_str());
+			return 1;
+		}
+	}
+	//repeat the clip to get a long take
+	int baseFrames = rec.GetNumFrames();
+	int numDOFs = rec.GetNumDOFs();
+	rec.AllocateFrames(baseFrames * (scale - 1));
+	for (int f = baseFrames; f < rec.GetNumFrames(); f++)
+	{
+		memcpy(rec.GetFrameData(f), rec.GetFrameData(f % baseFrames), numDOFs * sizeof(float));
+	}
+	int numFrames = rec.GetNumFrames();
+	double mb = 1024.0 * 1024.0;
+
+	printf("%d frames x %d channels (frame stride %d floats)\n", numFrames, numDOFs, rec.GetFrameStride());
+	printf("  per-frame new[] (previous layout, est.): %8.2f MB\n", LegacyMemoryEstimate(numFrames, numDOFs) / mb);
+	printf("  contiguous frame-major                 : %8.2f MB\n", rec.GetMemoryUsage() / mb);
+
+	BenchTimer build;
+	rec.BuildChannelView();
+	double buildMs = build.ElapsedMs();
+	printf("  + channel-major view                   : %8.2f MB (built in %.2f ms)\n", rec.GetMemoryUsage() / mb, buildMs);
+
+	std::vector<float> outA((size_t)numFrames * numDOFs), outB((size_t)numFrames * numDOFs);
+	double aos = 1e30, soa = 1e30;
+	for (int r = 0; r < 5; r++)
+	{
+		aos = fmin(aos, FilterFrameMajor(rec, outA));
+		soa = fmin(soa, FilterChannelMajor(rec, outB));
+	}
+	bool same = true;
+	for (int c = 0; c < numDOFs && same; c++)
+	{
+		for (int f = 1; f < numFrames - 1; f++)
+		{
+			if (outA[(size_t)c * numFrames + f] != outB[(size_t)c * numFrames + f]) { same = false; break; }
+		}
+	}
+	printf("  per-channel 3 tap filter, frame-major  : %8.2f ms\n", aos);
+	printf("  per-channel 3 tap filter, channel-major: %8.2f ms  (%.2fx, identical: %s)\n", soa, aos / soa, same ? "yes" : "NO");
+
+	std::vector<double> pose(numDOFs);
+	BenchTimer getFrame;
+	double sum = 0;
+	for (int f = 0; f < numFrames; f++)
+	{
+		rec.GetFrame(f, pose.data());
+		sum += pose[numDOFs - 1];
+	}
+	printf("  GetFrame over the clip                 : %8.2f ms  (%.1f ns/frame, checksum %g)\n",
+		getFrame.ElapsedMs(), getFrame.ElapsedMs() * 1e6 / numFrames, sum);
+	return same ? 0 : 1;
+}
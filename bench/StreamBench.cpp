@@ -0,0 +1,137 @@
+// StreamBench.cpp : time to first frame of a long synthetic capture, loaded
+// whole into an AnimRec vs streamed with StreamingClip, plus a seek and a
+// stretch of real time playback checked against the loaded frames.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+#include "StreamingClip.h"
+
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+//waits up to a few seconds for frame to be decoded, returns the ms waited
+//or a negative number if it never was
+static double WaitForFrame(StreamingClip& clip, int frame, float* out)
+{
+	BenchTimer timer;
+	while (!clip.GetFrame(frame, out))
+	{
+		if (timer.ElapsedMs() > 5000)
+		{
+			return -1;
+		}
+		std::this_thread::yield();
+	}
+	return timer.ElapsedMs();
+}
+
+int RunStreamBench(int argc, char** argv)
+{
+	int numJoints = argc > 0 ? atoi(argv[0]) : 60;
+	int numFrames = argc > 1 ? atoi(argv[1]) : 30000;
+	if (numJoints < 2) numJoints = 2;
+	if (numFrames < 200) numFrames = 200;
+
+	std::string path = "bvh_bench_stream.bvh";
+	size_t bytes = BenchWriteSyntheticBVH(path, numJoints, numFrames);
+	if (bytes == 0)
+	{
+		fprintf(stderr, "could not write %s\n", path.c_str());
+		return 1;
+	}
+
+	Skeleton loadedSkel;
+	AnimRec rec;
+	double loadMs;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		BenchTimer timer;
+		reader.BuildSkelFromFile(path.c_str(), &loadedSkel, &rec, false);
+		loadMs = timer.ElapsedMs();
+	}
+
+	Skeleton skel;
+	StreamingClip clip;
+	double openMs, firstMs, seekMs;
+	std::vector<float> frame(rec.GetFrameStride() > 0 ? rec.GetFrameStride() : 1);
+	bool opened;
+	{
+		BenchQuiet quiet;
+		BenchTimer timer;
+		opened = clip.Open(path.c_str(), &skel, false, 512);
+		openMs = timer.ElapsedMs();
+		firstMs = opened ? openMs + WaitForFrame(clip, 0, frame.data()) : -1;
+	}
+
+	//seek to near the end, before the scan has got there
+	int seekFrame = numFrames - numFrames / 10;
+	clip.SetPlayhead(seekFrame * (double)clip.GetFrameTime());
+	seekMs = opened ? WaitForFrame(clip, seekFrame, frame.data()) : -1;
+	int indexedAtSeek = clip.GetNumIndexedFrames();
+
+	//play a second of clip time at 4x speed from the start, sampling as a
+	//render loop would and checking every frame that is ready
+	clip.SetPlayhead(0);
+	WaitForFrame(clip, 0, frame.data());
+	int numDOFs = rec.GetNumDOFs();
+	int ready = 0, missed = 0;
+	double maxDiff = 0;
+	BenchTimer play;
+	double clipSeconds = 4.0 * 60 * clip.GetFrameTime();
+	for (int step = 0; step < 60; step++)
+	{
+		double t = clipSeconds * step / 60;
+		clip.SetPlayhead(t);
+		int f = (int)(t / clip.GetFrameTime());
+		if (clip.GetFrame(f, frame.data()))
+		{
+			ready++;
+			const float* expected = rec.GetFrameData(f);
+			for (int d = 0; d < numDOFs; d++)
+			{
+				maxDiff = fmax(maxDiff, fabs(frame[d] - expected[d]));
+			}
+		}
+		else
+		{
+			missed++;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(4));
+	}
+
+	//every frame, once the whole window is decoded around it
+	for (int f = 0; f < numFrames; f += numFrames / 50)
+	{
+		clip.SetPlayhead(f * (double)clip.GetFrameTime());
+		if (WaitForFrame(clip, f, frame.data()) < 0)
+		{
+			missed++;
+			continue;
+		}
+		const float* expected = rec.GetFrameData(f);
+		for (int d = 0; d < numDOFs; d++)
+		{
+			maxDiff = fmax(maxDiff, fabs(frame[d] - expected[d]));
+		}
+	}
+	size_t streamBytes = clip.GetMemoryUsage();
+	clip.Close();
+	remove(path.c_str());
+
+	printf("synthetic capture: %d joints, %d frames, %.1f MB of text\n", numJoints, numFrames, bytes / (1024.0 * 1024.0));
+	printf("  whole clip into an AnimRec   %9.2f ms  %8.1f MB held\n", loadMs, rec.GetMemoryUsage() / (1024.0 * 1024.0));
+	printf("  StreamingClip::Open          %9.2f ms  %8.1f MB held (window and row index)\n", openMs, streamBytes / (1024.0 * 1024.0));
+	printf("  first frame decoded          %9.2f ms after opening\n", firstMs);
+	printf("  seek to frame %-8d       %9.2f ms  (%d rows scanned when asked)\n", seekFrame, seekMs, indexedAtSeek);
+	printf("  playback: %d of %d samples ready, max |difference| to the loaded frames %g\n", ready, ready + missed, maxDiff);
+	bool ok = opened && firstMs >= 0 && seekMs >= 0 && missed == 0 && maxDiff == 0;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+// StressBench.cpp : a synthetic rig far larger than the shipped files (2000
+// joints by default, with hubs of 8 children like a hand with fingers and
+// twist bones), loaded, posed and turned into bone vertices every frame.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "Link.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+#include "BVHGenerator.h"
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+size_t BenchWriteSyntheticBVH(const std::string& dst, int numJoints, int numFrames)
+{
+	//a spine of hubs, each with 7 chains of 4 joints (fingers or twist
+	//chains) and the next hub
+	BVHGeneratorSettings settings;
+	settings.numJoints = numJoints;
+	settings.branching = 8;
+	settings.chainLength = 4;
+	settings.numFrames = numFrames;
+	BVHGenerator generator(settings);
+	return (size_t)generator.WriteFile(dst.c_str());
+}
+
+int RunStressBench(int argc, char** argv)
+{
+	int numJoints = argc > 0 ? atoi(argv[0]) : 2000;
+	int numFrames = argc > 1 ? atoi(argv[1]) : 600;
+	if (numJoints < 2) numJoints = 2;
+	if (numFrames < 1) numFrames = 1;
+
+	std::string path = "bvh_bench_stress.bvh";
+	size_t bytes = BenchWriteSyntheticBVH(path, numJoints, numFrames);
+	if (bytes == 0)
+	{
+		fprintf(stderr, "could not write %s\n", path.c_str());
+		return 1;
+	}
+
+	Skeleton skel;
+	AnimRec rec;
+	double loadMs;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		BenchTimer timer;
+		reader.BuildSkelFromFile(path.c_str(), &skel, &rec, false);
+		loadMs = timer.ElapsedMs();
+	}
+	remove(path.c_str());
+
+	//positions below the root can't be posed, so such a file has to be
+	//refused rather than loaded with its rows misaligned
+	bool refused;
+	{
+		BVHGeneratorSettings settings;
+		settings.numJoints = 20;
+		settings.numFrames = 10;
+		settings.sixChannelFraction = 0.5;
+		BVHGenerator generator(settings);
+		generator.WriteFile(path.c_str());
+
+		BenchQuiet quiet;
+		Skeleton sixSkel;
+		AnimRec sixRec;
+		BVHReader reader;
+		reader.BuildSkelFromFile(path.c_str(), &sixSkel, &sixRec, false);
+		refused = generator.GetNumDOFs() > 3 + 3 * settings.numJoints && sixRec.GetNumFrames() == 0;
+		remove(path.c_str());
+	}
+
+	int numLinks = skel.GetNumLinks();
+	int numNamed = 0, maxChildren = 0;
+	for (int i = 0; i < numLinks; i++)
+	{
+		Link* link = skel.GetLink(i);
+		numNamed += link->GetName()[0] != '\0';
+		maxChildren = link->GetNumChildren() > maxChildren ? link->GetNumChildren() : maxChildren;
+	}
+	bool loaded = numNamed == numJoints && rec.GetNumFrames() == numFrames && rec.GetNumDOFs() == 3 + 3 * numJoints;
+	printf("synthetic rig: %d joints (%d links with end sites, up to %d children), %d frames, %.1f MB\n",
+		numNamed, numLinks, maxChildren, rec.GetNumFrames(), bytes / (1024.0 * 1024.0));
+	printf("  load                      %9.2f ms\n", loadMs);
+
+	//the player's loop: state buffer and vertex buffer sized from the rig
+	skel.AddGeometry();
+	std::vector<double> state(rec.GetNumDOFs());
+	int maxEntries = skel.GetNumVertices();
+	std::vector<VERTEX> verts(maxEntries);
+	VERTEX* vertData = verts.data();
+	int vertCount = 0;
+	double poseMs = 0, vertMs = 0, maxDiff = 0;
+	for (int f = 0; f < numFrames; f++)
+	{
+		BenchTimer timer;
+		rec.GetFrame(f, state.data());
+		skel.SetSkelState(state.data());
+		skel.UpdateLinks();
+		poseMs += timer.ElapsedMs();
+
+		timer.Reset();
+		vertCount = 0;
+		skel.CalcVertexLocations(maxEntries, &vertCount, &vertData);
+		vertMs += timer.ElapsedMs();
+
+		if (f % 50 == 0)
+		{
+			skel.ComputePose(rec.GetFrameData(f));
+			const mat4x4* world = skel.GetWorldMatrices();
+			for (int j = 0; j < numLinks; j++)
+			{
+				mat4x4 m;
+				skel.GetLink(j)->GetLToWTransMat(m);
+				for (int c = 0; c < 4; c++)
+					for (int r = 0; r < 4; r++)
+						maxDiff = fmax(maxDiff, fabs(m[c][r] - world[j][c][r]));
+			}
+		}
+	}
+	printf("  link update               %9.2f us/frame\n", poseMs * 1000.0 / numFrames);
+	printf("  bone vertices             %9.2f us/frame  (%d of %d)\n", vertMs * 1000.0 / numFrames, vertCount, maxEntries);
+
+	BenchTimer timer;
+	for (int f = 0; f < numFrames; f++)
+	{
+		skel.ComputePose(rec.GetFrameData(f));
+	}
+	printf("  ComputePose               %9.2f us/frame  max |difference| to links: %g\n",
+		timer.ElapsedMs() * 1000.0 / numFrames, maxDiff);
+
+	std::vector<mat4x4> baked((size_t)numFrames * numLinks);
+	timer.Reset();
+	skel.BakeClip(&rec, baked.data());
+	printf("  BakeClip                  %9.2f us/frame\n", timer.ElapsedMs() * 1000.0 / numFrames);
+
+	std::vector<std::string> names(numJoints);
+	for (int i = 0; i < numJoints; i++)
+	{
+		names[i] = "J" + std::to_string(i);
+	}
+	int found = 0;
+	timer.Reset();
+	for (int i = 0; i < numJoints; i++)
+	{
+		found += skel.FindJointIndex(names[i]) >= 0;
+	}
+	printf("  FindJointIndex, all names %9.2f us\n", timer.ElapsedMs() * 1000.0);
+
+	bool ok = loaded && vertCount == maxEntries && found == numJoints && maxDiff < 1e-3;
+	printf("  complete rig: %s   non-root positions refused: %s\n", ok ? "yes" : "NO", refused ? "yes" : "NO");
+	ok = ok && refused;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,90 @@
+// ThumbBench.cpp : headless rendering throughput.  Frames of one clip are
+// drawn by SoftRaster, one ThumbnailRenderer per thread, on 1..N threads,
+// and every run has to produce the same pixels as the single threaded one.
+
+#include "BenchUtil.h"
+
+#include "Thumbnails.h"
+#include "SoftRaster.h"
+#include "ThreadPool.h"
+
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//renders frame after frame of the clip into one image per task
+static void RenderFrames(std::vector<std::unique_ptr<ThumbnailRenderer> >& thumbs, std::vector<std::unique_ptr<SoftRaster> >& rasters,
+	ThreadPool& pool, int numFrames, std::vector<unsigned char>& last)
+{
+	int clipFrames = thumbs[0]->GetNumFrames();
+	pool.RunWithThreadIndex(numFrames, [&](int f, int thread) {
+		SoftRaster& raster = *rasters[thread];
+		raster.Clear(255, 255, 255);
+		thumbs[thread]->RenderFrame(raster, (int)((long long)f * 7919 % clipFrames));
+		if (f == numFrames - 1)
+		{
+			last.assign(raster.GetPixels(), raster.GetPixels() + (size_t)raster.GetWidth() * raster.GetHeight() * 3);
+		}
+	});
+}
+
+int RunThumbBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int size = argc > 1 ? atoi(argv[1]) : 256;
+	int numFrames = argc > 2 ? atoi(argv[2]) : 400;
+	if (size < 8) size = 8;
+	if (numFrames < 1) numFrames = 1;
+
+	int maxThreads = (int)std::thread::hardware_concurrency();
+	if (maxThreads < 1) maxThreads = 1;
+	std::vector<std::unique_ptr<ThumbnailRenderer> > thumbs;
+	std::vector<std::unique_ptr<SoftRaster> > rasters;
+	{
+		BenchQuiet quiet;
+		for (int t = 0; t < maxThreads; t++)
+		{
+			thumbs.emplace_back(new ThumbnailRenderer());
+			rasters.emplace_back(new SoftRaster(size, size));
+			if (!thumbs[t]->Load(src.c_str()))
+			{
+				fprintf(stderr, "could not read %s\n", src.c_str());
+				return 1;
+			}
+		}
+	}
+
+	printf("file: %s, %d frames of %dx%d\n", src.c_str(), numFrames, size, size);
+	printf("  threads        ms       fps   fps/thread  speedup\n");
+	std::vector<unsigned char> reference, last;
+	double baseMs = 0;
+	bool same = true;
+	for (int n = 1; n <= maxThreads; n *= 2)
+	{
+		ThreadPool pool(n);
+		BenchTimer timer;
+		RenderFrames(thumbs, rasters, pool, numFrames, last);
+		double ms = timer.ElapsedMs();
+		if (n == 1)
+		{
+			baseMs = ms;
+			reference = last;
+		}
+		same = same && last == reference;
+		double fps = numFrames * 1000.0 / ms;
+		printf("  %7d  %8.2f  %8.1f  %11.1f  %6.2fx\n", n, ms, fps, fps / n, baseMs / ms);
+	}
+
+	//a sheet that drew nothing would be all background
+	size_t drawn = 0;
+	for (size_t i = 0; i < reference.size(); i += 3)
+	{
+		drawn += reference[i] != 255 || reference[i + 1] != 255 || reference[i + 2] != 255;
+	}
+	printf("  pixels covered: %.1f%%   same image on every thread count: %s\n", 100.0 * drawn / (reference.size() / 3), same ? "yes" : "NO");
+	return drawn > 0 && same ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+// TraceBench.cpp : what the TRACE_SCOPE timers cost.  Only measures anything
+// in a build configured with -DBVH_TRACE=ON; otherwise the scopes are
+// compiled out and there is nothing to time.  Times the per frame work of
+// the player with recording on and paused, and writes a trace to check the
+// JSON export.
+
+#include "BenchUtil.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+#include "Trace.h"
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef BVH_TRACE
+
+//ms for numFrames of the old per vertex player frame plus a crowd's poses
+static double RunFrames(Skeleton& skel, AnimRec& rec, int numFrames, int numCharacters)
+{
+	int numLinks = skel.GetNumLinks();
+	int maxEntries = skel.GetNumVertices();
+	std::vector<VERTEX> verts(maxEntries);
+	std::vector<double> state(rec.GetNumDOFs());
+	std::vector<const float*> frames(numCharacters);
+	std::vector<mat4x4> world((size_t)numLinks * numCharacters);
+	BenchTimer timer;
+	for (int f = 0; f < numFrames; f++)
+	{
+		int frame = f % rec.GetNumFrames();
+		rec.GetFrame(frame, state.data());
+		skel.SetSkelState(state.data());
+		skel.UpdateLinks();
+		VERTEX* out = verts.data();
+		int count = 0;
+		skel.CalcVertexLocations(maxEntries, &count, &out);
+
+		for (int c = 0; c < numCharacters; c++)
+		{
+			frames[c] = rec.GetFrameData((frame + c * 7) % rec.GetNumFrames());
+		}
+		skel.ComputePoses(frames.data(), numCharacters, world.data());
+	}
+	return timer.ElapsedMs();
+}
+
+int RunTraceBench(int argc, char** argv)
+{
+	std::string src = argc > 0 ? argv[0] : BenchDataPath("ZooExcited.bvh");
+	int numCharacters = argc > 1 ? atoi(argv[1]) : 200;
+	int numFrames = argc > 2 ? atoi(argv[2]) : 200;
+	const int numScopes = 1000000;
+	if (numCharacters < 1) numCharacters = 1;
+	if (numFrames < 1) numFrames = 1;
+
+	Skeleton skel;
+	AnimRec rec;
+	{
+		BenchQuiet quiet;
+		BVHReader reader;
+		if (!reader.BuildSkelFromFile(src.c_str(), &skel, &rec, false) || rec.GetNumFrames() == 0)
+		{
+			fprintf(stderr, "could not read %s\n", src.c_str());
+			return 1;
+		}
+	}
+	skel.AddGeometry();
+
+	//an empty scope, recording and paused
+	BenchTimer timer;
+	for (int i = 0; i < numScopes; i++)
+	{
+		TRACE_SCOPE("empty");
+	}
+	double onNs = timer.ElapsedMs() * 1e6 / numScopes;
+	TraceSetEnabled(false);
+	timer.Reset();
+	for (int i = 0; i < numScopes; i++)
+	{
+		TRACE_SCOPE("empty");
+	}
+	double pausedNs = timer.ElapsedMs() * 1e6 / numScopes;
+	TraceSetEnabled(true);
+
+	//best of a few alternating runs each way, so noise doesn't pass for cost
+	double bestOn = 1e30, bestOff = 1e30;
+	uint64_t eventsBefore = TraceEventCount();
+	for (int run = 0; run < 5; run++)
+	{
+		TraceSetEnabled(false);
+		double off = RunFrames(skel, rec, numFrames, numCharacters);
+		TraceSetEnabled(true);
+		double on = RunFrames(skel, rec, numFrames, numCharacters);
+		bestOff = off < bestOff ? off : bestOff;
+		bestOn = on < bestOn ? on : bestOn;
+	}
+	double eventsPerFrame = (double)(TraceEventCount() - eventsBefore) / (5.0 * numFrames);
+
+	std::string path = "bvh_bench_trace.json";
+	timer.Reset();
+	bool written = TraceWriteJSON(path.c_str());
+	double writeMs = timer.ElapsedMs();
+	std::string json;
+	written = written && BenchReadFile(path, json) && json.find("\"traceEvents\"") != std::string::npos
+		&& json.find("\"UpdateLinks\"") != std::string::npos;
+	remove(path.c_str());
+
+	printf("file: %s, frame = per vertex pose of one character + ComputePoses of %d\n", src.c_str(), numCharacters);
+	printf("  TRACE_SCOPE recording     %8.1f ns\n", onNs);
+	printf("  TRACE_SCOPE paused        %8.1f ns\n", pausedNs);
+	printf("  frame, recording          %8.2f us  (%.1f events)\n", bestOn * 1000.0 / numFrames, eventsPerFrame);
+	printf("  frame, paused             %8.2f us  overhead %.2f%%, events alone %.3f%% of the frame, %.4f%% of 60 Hz\n",
+		bestOff * 1000.0 / numFrames, (bestOn / bestOff - 1.0) * 100.0, eventsPerFrame * onNs / (bestOff * 1e6 / numFrames) * 100.0,
+		eventsPerFrame * onNs / (1e9 / 60.0) * 100.0);
+	printf("  JSON export               %8.2f ms, %.1f KB: %s\n", writeMs, json.size() / 1024.0, written ? "ok" : "FAILED");
+	return written ? 0 : 1;
+}
+
+#else
+
+int RunTraceBench(int, char**)
+{
+	printf("tracing is compiled out, configure with -DBVH_TRACE=ON to measure it\n");
+	return 0;
+}
+
+#endif
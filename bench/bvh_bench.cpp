@@ -0,0 +1,74 @@
+// bvh_bench.cpp : headless benchmarks for the BVH player's hot paths.
+//
+// usage: bvh_bench [suite] [suite arguments]
+// With no suite every suite is run with its default arguments.
+
+#include "BenchUtil.h"
+
+#include <string.h>
+#include <stdio.h>
+
+struct BenchSuite
+{
+	const char* name;
+	int (*run)(int argc, char** argv);
+	const char* help;
+};
+
+static const BenchSuite s_suites[] =
+{
+	{ "load", RunLoadBench, "[file.bvh] [scale]  line reader vs memory mapped reader" },
+	{ "parallel", RunParallelLoadBench, "[file.bvh] [scale]  MOTION decoding on 1..N threads" },
+	{ "motion", RunMotionParseBench, "[file.bvh] [scale]  MOTION row number parsing, GB/s" },
+	{ "storage", RunStorageBench, "[file.bvh] [scale]  AnimRec memory and AoS vs SoA channel walks" },
+	{ "cache", RunCacheBench, "[file.bvh] [scale]  text parse vs binary motion cache load" },
+	{ "fk", RunFKBench, "[file.bvh] [poses]  recursive link update vs flattened FK loop" },
+	{ "batchfk", RunBatchFKBench, "[file.bvh] [poses]  ComputePoses scalar vs SSE vs AVX2, checked against the links" },
+	{ "bake", RunBakeBench, "[file.bvh] [scale]  whole clip world transforms, link loop vs BakeClip on 1..N threads" },
+	{ "lookup", RunLookupBench, "[file.bvh] [repeats]  joint lookup by name, FindNode vs FindJointIndex" },
+	{ "stress", RunStressBench, "[joints] [frames]  synthetic rig of thousands of joints: load, pose, bone vertices" },
+	{ "render", RunRenderBench, "[file.bvh] [characters]  crowd frame prep, CPU bone vertices vs instance matrices" },
+	{ "pipeline", RunPipelineBench, "[file.bvh] [characters] [render ms]  animation on the render thread vs a producer thread" },
+	{ "thumbs", RunThumbBench, "[file.bvh] [size] [frames]  headless software rendering, fps on 1..N threads" },
+	{ "sample", RunSampleBench, "[file.bvh] [samples]  poses between frames, old Interpolate vs unwrapped Sample" },
+	{ "quat", RunQuatBench, "[file.bvh] [samples]  Euler clip vs quaternion clip, nlerp / slerp quality and speed" },
+	{ "compress", RunCompressBench, "[file.bvh] [samples]  compressed clips: size, world space error and sampling speed" },
+	{ "stream", RunStreamBench, "[joints] [frames]  long capture: whole load vs streaming, time to first frame and seeks" },
+	{ "stages", RunStagesBench, "[--json] [file.bvh ...]  ns/op, percentiles and allocations/op of every stage, load to vertices" },
+	{ "arena", RunArenaBench, "[file.bvh] [iterations]  skeletons built and destroyed in a loop, arena stats and resident memory" },
+	{ "trace", RunTraceBench, "[file.bvh] [characters] [frames]  TRACE_SCOPE cost and per frame overhead (builds with BVH_TRACE)" },
+	{ "hud", RunHudBench, "[file.bvh] [frames]  player overlay: build time, vertices, allocations, late and dropped counts" },
+	{ "crowd", RunCrowdBench, "[file.bvh] [max instances]  one shared rig and clip, many instances: memory per instance, instances per 60 Hz frame" },
+	{ "euler", RunEulerBench, "[count]  Euler angles to matrix, mat4x4_rotate vs closed form kernels" },
+};
+
+static const int s_numSuites = sizeof(s_suites) / sizeof(s_suites[0]);
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		int result = 0;
+		for (int i = 0; i < s_numSuites; i++)
+		{
+			printf("== %s ==\n", s_suites[i].name);
+			result |= s_suites[i].run(0, NULL);
+		}
+		return result;
+	}
+
+	for (int i = 0; i < s_numSuites; i++)
+	{
+		if (strcmp(argv[1], s_suites[i].name) == 0)
+		{
+			return s_suites[i].run(argc - 2, argv + 2);
+		}
+	}
+
+	fprintf(stderr, "usage: bvh_bench [suite] [args]\n");
+	for (int i = 0; i < s_numSuites; i++)
+	{
+		fprintf(stderr, "  %-10s %s\n", s_suites[i].name, s_suites[i].help);
+	}
+	return 1;
+}
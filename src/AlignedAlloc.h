@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+//Cache line size used to align bulk animation and pose storage
+#define CACHE_LINE_SIZE 64
+
+//Allocates bytes aligned to alignment (a power of two), NULL on failure.
+//Free with AlignedFree.
+static inline void* AlignedAlloc(size_t bytes, size_t alignment = CACHE_LINE_SIZE)
+{
+	if (bytes == 0) bytes = alignment;
+#ifdef _WIN32
+	return _aligned_malloc(bytes, alignment);
+#else
+	void* p = NULL;
+	if (posix_memalign(&p, alignment, bytes) != 0) return NULL;
+	return p;
+#endif
+}
+
+static inline void AlignedFree(void* p)
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+//Rounds n up to a whole number of cache lines worth of floats
+static inline int PadToCacheLine(int numFloats)
+{
+	const int perLine = CACHE_LINE_SIZE / sizeof(float);
+	return (numFloats + perLine - 1) / perLine * perLine;
+}
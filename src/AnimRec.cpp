@@ -1,9 +1,20 @@
 
 #include "AnimRec.h"
 #include "defs.h"
+#include "FastFloat.h"
+#include "AlignedAlloc.h"
+#include "MappedFile.h"
 
 #include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <new>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIM_REC_SSE 1
+#include <xmmintrin.h>
+#endif
 
 double ToRadians(double deg)
 {
@@ -15,10 +26,31 @@ AnimRec::AnimRec(void)
 {
 	m_numDOFs = 0;
 	m_frameTime = 0;
+
+	m_frames = NULL;
+	m_mapping = NULL;
+	m_numFrames = 0;
+	m_frameCapacity = 0;
+	m_frameStride = 0;
+
+	m_channels = NULL;
+	m_channelStride = 0;
+
+	m_sampleFrames = NULL;
 }
 
 AnimRec::~AnimRec(void)
 {
+	if (m_mapping)
+	{
+		delete m_mapping;
+	}
+	else
+	{
+		AlignedFree(m_frames);
+	}
+	ReleaseChannelView();
+	ReleaseSampleView();
 }
 
 void AnimRec::SetFrameTime(float f)
@@ -31,7 +63,10 @@ float AnimRec::GetFrameTime()
 }
 void AnimRec::SetNumDOFs(int n)
 {
+	//the frame layout depends on the number of dofs
+	assert(m_numFrames == 0 || n == m_numDOFs);
 	m_numDOFs = n;
+	m_frameStride = PadToCacheLine(n);
 }
 int AnimRec::GetNumDOFs()
 {
@@ -40,14 +75,14 @@ int AnimRec::GetNumDOFs()
 //inToM: inch to metre
 void AnimRec::StoreLine(char * line, bool inToM)
 {
-	float * data = new float[m_numDOFs];
+	float * data = AddFrame();
 //	double * doubDat = new double[m_numDOFs];//need for quaternion conversion code
 
 	int index = 0;
 	char* str = NULL;
 	str = strtok(line, " \t");
 	// clean up any line feeds or carriage returns
-	while (str != NULL && str[0] != 13)
+	while (str != NULL && str[0] != 13 && index < m_numDOFs)
 	{
 		double val = atof(str);
 
@@ -65,96 +100,315 @@ void AnimRec::StoreLine(char * line, bool inToM)
 		str = strtok(NULL, " \t");
 	}
 
-	m_animData.push_back(data);
 
+}
+void AnimRec::StoreLine(const char* begin, const char* end, bool inToM)
+{
+	//new frames are zeroed, so a short row leaves the remaining channels at zero
+	ParseFrame(begin, end, AddFrame(), m_numDOFs, inToM);
+}
+int AnimRec::ParseFrame(const char* begin, const char* end, float* out, int numDOFs, bool inToM)
+{
+	int index = 0;
+	const char* p = begin;
+	while (index < numDOFs)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		if (p >= end)
+			break;
+
+		double val;
+		const char* q = ParseDouble(p, end, val);
+		//like atof, ignore anything after the number up to the next separator
+		while (q < end && *q != ' ' && *q != '\t')
+			q++;
+		p = q;
+
+		out[index] = val;
+
+		if(inToM&&index<3) out[index]*=.0254;
 
+		//stored as radians, same as the line based version
+		if(index>=3) out[index] = ToRadians(out[index]);
+
+		index++;
+	}
+	return index;
 }
 int AnimRec::GetNumFrames()
 {
-	return m_animData.size();
+	return m_numFrames;
 }
 
-void AnimRec::GetFrame(int index, double * val)
+void AnimRec::Reserve(int numFrames)
 {
+	if (numFrames <= m_frameCapacity)
+	{
+		return;
+	}
+	//grow geometrically so appending row by row stays linear
+	int capacity = m_frameCapacity * 2;
+	if (capacity < numFrames) capacity = numFrames;
+	if (capacity < 16) capacity = 16;
+
+	float * frames = (float*)AlignedAlloc((size_t)capacity * m_frameStride * sizeof(float));
+	if (frames == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	if (m_frames)
+	{
+		memcpy(frames, m_frames, (size_t)m_numFrames * m_frameStride * sizeof(float));
+		if (m_mapping)
+		{
+			//frames are now our own copy, the mapped file is no longer needed
+			delete m_mapping;
+			m_mapping = NULL;
+		}
+		else
+		{
+			AlignedFree(m_frames);
+		}
+	}
+	m_frames = frames;
+	m_frameCapacity = capacity;
+}
 
-	int size = m_animData.size();
-	assert(index<size);
+float * AnimRec::AddFrame()
+{
+	AllocateFrames(1);
+	return GetFrameData(m_numFrames - 1);
+}
 
-	if(index>=size)
+void AnimRec::AllocateFrames(int numFrames)
+{
+	if (numFrames <= 0)
 	{
 		return;
 	}
+	Reserve(m_numFrames + numFrames);
+	memset(m_frames + (size_t)m_numFrames * m_frameStride, 0, (size_t)numFrames * m_frameStride * sizeof(float));
+	m_numFrames += numFrames;
 
-	float * data;
-	data = m_animData.at(index);
+	//the channel and sample views no longer cover every frame
+	ReleaseChannelView();
+	ReleaseSampleView();
+}
 
-	for(int i =0; i<m_numDOFs; i++)
+float * AnimRec::GetFrameData(int index)
+{
+	assert(index >= 0 && index < m_numFrames);
+	return m_frames + (size_t)index * m_frameStride;
+}
+
+int AnimRec::GetFrameStride()
+{
+	return m_frameStride;
+}
+
+void AnimRec::BuildChannelView()
+{
+	ReleaseChannelView();
+	m_channelStride = PadToCacheLine(m_numFrames);
+	m_channels = (float*)AlignedAlloc((size_t)m_numDOFs * m_channelStride * sizeof(float));
+	if (m_channels == NULL)
 	{
-		val[i] = data[i];
+		throw std::bad_alloc();
+	}
+
+	//transpose in blocks of frames so both sides stay in cache
+	const int block = 64;
+	for (int f0 = 0; f0 < m_numFrames; f0 += block)
+	{
+		int f1 = f0 + block < m_numFrames ? f0 + block : m_numFrames;
+		for (int c = 0; c < m_numDOFs; c++)
+		{
+			float * dst = m_channels + (size_t)c * m_channelStride;
+			for (int f = f0; f < f1; f++)
+			{
+				dst[f] = m_frames[(size_t)f * m_frameStride + c];
+			}
+		}
+	}
+	for (int c = 0; c < m_numDOFs; c++)
+	{
+		float * dst = m_channels + (size_t)c * m_channelStride;
+		for (int f = m_numFrames; f < m_channelStride; f++) dst[f] = 0;
 	}
 }
 
-bool AnimRec::Interpolate(double time, double* val)
+void AnimRec::ReleaseChannelView()
 {
-	int startFrame = time/m_frameTime;
-	double weight = time/m_frameTime - startFrame;
+	AlignedFree(m_channels);
+	m_channels = NULL;
+	m_channelStride = 0;
+}
 
-	float * low, *high;
-	int size = m_animData.size();
-	if(startFrame<size)
+const float * AnimRec::GetChannelData(int dof)
+{
+	assert(dof >= 0 && dof < m_numDOFs);
+	if (!m_channels)
 	{
-		low = m_animData.at(startFrame);
+		BuildChannelView();
 	}
-	else
+	return m_channels + (size_t)dof * m_channelStride;
+}
+
+int AnimRec::GetChannelStride()
+{
+	if (!m_channels)
 	{
-		return false;
+		BuildChannelView();
 	}
-	if(startFrame+1<size)
+	return m_channelStride;
+}
+
+size_t AnimRec::GetMemoryUsage()
+{
+	size_t bytes = (size_t)m_frameCapacity * m_frameStride * sizeof(float);
+	if (m_channels)
+	{
+		bytes += (size_t)m_numDOFs * m_channelStride * sizeof(float);
+	}
+	if (m_sampleFrames)
 	{
-		high = m_animData.at(startFrame+1);
+		bytes += (size_t)(m_numFrames + 1) * m_frameStride * sizeof(float);
+	}
+	return bytes;
+}
+
+void AnimRec::AdoptMappedFrames(MappedFile* file, float* frames, int numFrames)
+{
+	assert(((size_t)frames % CACHE_LINE_SIZE) == 0);
+	if (m_mapping)
+	{
+		delete m_mapping;
 	}
 	else
 	{
-		high = low;
+		AlignedFree(m_frames);
+	}
+	ReleaseChannelView();
+	ReleaseSampleView();
+
+	m_mapping = file;
+	m_frames = frames;
+	m_numFrames = numFrames;
+	m_frameCapacity = numFrames;
+}
+
+void AnimRec::GetFrame(int index, double * val)
+{
+	assert(index < m_numFrames);
+
+	if(index>=m_numFrames)
+	{
+		return;
 	}
 
+	const float * data = GetFrameData(index);
+
 	for(int i =0; i<m_numDOFs; i++)
 	{
-		val[i] = (1-weight) * low[i] + weight * high[i];
-		//check for conditions where the set of euler angles flips between subsequent frames
-		//e.g. an angle might go from near 180 to near -180.  Blade is bad for this.
+		val[i] = data[i];
+	}
+}
 
+void AnimRec::BuildSampleView()
+{
+	ReleaseSampleView();
+	if (m_numFrames == 0)
+	{
+		return;
+	}
+	size_t frameBytes = (size_t)m_frameStride * sizeof(float);
+	m_sampleFrames = (float*)AlignedAlloc((size_t)(m_numFrames + 1) * frameBytes);
+	if (m_sampleFrames == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	memcpy(m_sampleFrames, m_frames, (size_t)m_numFrames * frameBytes);
 
-		if(fabs(low[i] - high[i]) > 6 )//in radians
+	//the first three channels are the root position, the rest are angles
+	const double turn = 2 * PI;
+	for (int f = 1; f < m_numFrames; f++)
+	{
+		const float * prev = m_sampleFrames + (size_t)(f - 1) * m_frameStride;
+		float * cur = m_sampleFrames + (size_t)f * m_frameStride;
+		for (int i = 3; i < m_numDOFs; i++)
 		{
-			float change = 0;
-//			if(fabs(low[i] - high[i]) > 6)
-//			{
-				change = 2*PI;
-//			}
-//			else
-//			{
-//				change = PI; // this case seems to come up, I presume when the other angles are different.
-//			}
-
-			float useLow, useHigh;
-			useLow = low[i];
-			useHigh = high[i];
-
-			if(low[i] < 0 && high[i] > 0 || low[i] < -3)
-			{
-				useLow = low[i] + change;
-				useHigh = high[i];
-			}
-			else if(low[i] > 0 && high[i] < 0 || high[i] < -3)
-			{
-				useLow = low[i] ;
-				useHigh = high[i] + change;
-			}
-			val[i] = (1-weight) * useLow + weight * useHigh;
-
+			double turns = floor((prev[i] - (double)cur[i]) / turn + 0.5);
+			cur[i] = (float)(cur[i] + turns * turn);
 		}
 	}
+
+	//frame f + 1 always exists, so the last frame blends with itself
+	memcpy(m_sampleFrames + (size_t)m_numFrames * m_frameStride, m_sampleFrames + (size_t)(m_numFrames - 1) * m_frameStride, frameBytes);
+}
+
+void AnimRec::ReleaseSampleView()
+{
+	AlignedFree(m_sampleFrames);
+	m_sampleFrames = NULL;
+}
+
+void AnimRec::Sample(double time, float* out)
+{
+	if (m_numFrames == 0)
+	{
+		return;
+	}
+	if (!m_sampleFrames)
+	{
+		BuildSampleView();
+	}
+
+	double pos = m_frameTime > 0 ? time / m_frameTime : 0;
+	double last = m_numFrames - 1;
+	pos = pos < 0 ? 0 : pos > last ? last : pos;
+	int frame = (int)pos;
+	float weight = (float)(pos - frame);
+
+	const float * a = m_sampleFrames + (size_t)frame * m_frameStride;
+	const float * b = a + m_frameStride;
+	int i = 0;
+#ifdef ANIM_REC_SSE
+	__m128 w = _mm_set1_ps(weight);
+	for (; i + 4 <= m_numDOFs; i += 4)
+	{
+		__m128 va = _mm_load_ps(a + i);
+		__m128 vb = _mm_load_ps(b + i);
+		_mm_storeu_ps(out + i, _mm_add_ps(va, _mm_mul_ps(w, _mm_sub_ps(vb, va))));
+	}
+#endif
+	for (; i < m_numDOFs; i++)
+	{
+		out[i] = a[i] + weight * (b[i] - a[i]);
+	}
+}
+
+bool AnimRec::Interpolate(double time, double* val)
+{
+	if (m_numFrames == 0 || time < 0 || (m_frameTime > 0 && time / m_frameTime >= m_numFrames))
+	{
+		return false;
+	}
+	if (!m_sampleFrames)
+	{
+		BuildSampleView();
+	}
+
+	double pos = m_frameTime > 0 ? time / m_frameTime : 0;
+	int frame = (int)pos;
+	double weight = pos - frame;
+	const float * low = m_sampleFrames + (size_t)frame * m_frameStride;
+	const float * high = low + m_frameStride;
+	for(int i =0; i<m_numDOFs; i++)
+	{
+		val[i] = (1-weight) * low[i] + weight * high[i];
+	}
+	return true;
 }
 
 double AnimRec::GetStartTime()
@@ -163,5 +417,5 @@ double AnimRec::GetStartTime()
 }
 double AnimRec::GetEndTime()
 {
-	return m_frameTime*m_animData.size();
+	return m_frameTime*m_numFrames;
 }
\ No newline at end of file
@@ -1,8 +1,14 @@
 #pragma once
 
+#include <stddef.h>
 
-#include <vector>
+class MappedFile;
 
+//Motion data of a clip.
+//All frames live in one 64 byte aligned block, frame after frame (frame-major,
+//AoS).  Each frame is padded to a whole number of cache lines so every frame
+//starts aligned.  A channel-major (SoA) copy can be built on request for code
+//that streams one channel over all frames.
 class AnimRec
 {
 public:
@@ -12,20 +18,91 @@ public:
 	void SetFrameTime(float f);
 	float GetFrameTime();
 	void StoreLine(char * line, bool inToM);
+	//same as above, but reads the frame from [begin, end) without modifying it
+	void StoreLine(const char* begin, const char* end, bool inToM);
+
+	//Parses one MOTION row from [begin, end) straight into out, converting to
+	//the stored units (metres if inToM, radians for the rotations).
+	//Reads at most numDOFs values and returns how many were found.
+	static int ParseFrame(const char* begin, const char* end, float* out, int numDOFs, bool inToM);
 	void SetNumDOFs(int n);
 	int GetNumDOFs();
 
 	double GetStartTime();
 	double GetEndTime();
 
+	//Pose at time seconds blended from the two frames around it, like
+	//Sample.  Returns false (and leaves val alone) past the end of the clip.
 	bool Interpolate(double time, double* val);
 
+	//Writes the pose at time seconds into out (GetNumDOFs() floats), a
+	//linear blend of the frames either side.  time is clamped to the clip.
+	//Rotations are blended through the sample view, so an angle that wraps
+	//from near pi to near -pi between frames takes the short way round.
+	void Sample(double time, float* out);
+
+	//Sample view: a copy of the frames with every rotation channel unwrapped
+	//(whole turns added so each frame is within pi of the one before), plus
+	//a copy of the last frame at the end, so a sample is one multiply-add
+	//per channel with no checks.  Built on first use like the channel view.
+	//Build it before sampling from several threads, and again after writing
+	//frames through GetFrameData.
+	void BuildSampleView();
+	void ReleaseSampleView();
+
 	int GetNumFrames();
 	void GetFrame(int index, double * val);
 
+	//Appends numFrames zeroed frames so they can be filled in any order
+	//(e.g. by several threads) through GetFrameData.
+	void AllocateFrames(int numFrames);
+
+	//frame-major view: GetNumDOFs() floats of frame index in stored units.
+	//Frame index+1 starts GetFrameStride() floats later.
+	float* GetFrameData(int index);
+	int GetFrameStride();
+
+	//channel-major view: channel dof for every frame, GetNumFrames() floats.
+	//Built from the frames on first use, so call BuildChannelView again after
+	//writing frames through GetFrameData.
+	const float* GetChannelData(int dof);
+	int GetChannelStride();
+	void BuildChannelView();
+	void ReleaseChannelView();
+
+	//bytes of frame (and channel view) storage currently held
+	size_t GetMemoryUsage();
+
+	//Uses numFrames frames that already sit in a mapped file (see MotionCache)
+	//instead of copying them.  frames must be cache line aligned, laid out with
+	//the stride that SetNumDOFs chose, and writable (a copy on write mapping).
+	//The record takes ownership of file and closes it when done.
+	void AdoptMappedFrames(MappedFile* file, float* frames, int numFrames);
+
 private:
+	AnimRec(const AnimRec&);
+	AnimRec& operator=(const AnimRec&);
+
+	//makes room for at least numFrames frames
+	void Reserve(int numFrames);
+	//appends one frame and returns its storage
+	float* AddFrame();
+
+	//frame-major storage, m_frameCapacity frames of m_frameStride floats
+	//Either allocated here or pointing into m_mapping.
+	float* m_frames;
+	MappedFile* m_mapping;
+	int m_numFrames;
+	int m_frameCapacity;
+	int m_frameStride;
+
+	//channel-major copy, m_numDOFs channels of m_channelStride floats
+	float* m_channels;
+	int m_channelStride;
+
+	//unwrapped frames for sampling, m_numFrames + 1 frames of m_frameStride
+	float* m_sampleFrames;
 
-	std::vector<float *> m_animData;
 	float m_frameTime;
 	int m_numDOFs;
 
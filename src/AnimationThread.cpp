@@ -0,0 +1,249 @@
+#include "AnimationThread.h"
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "StreamingClip.h"
+#include "AlignedAlloc.h"
+#include "Trace.h"
+#include <chrono>
+#include <string.h>
+#include <math.h>
+
+#define SLOT_INDEX 3u
+#define SLOT_FRESH 4u
+
+static double NowSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AnimationThread::AnimationThread()
+{
+	m_skel = NULL;
+	m_crowd = NULL;
+	m_pool = NULL;
+	m_stream = NULL;
+	m_numCharacters = 0;
+	m_sampled = NULL;
+	m_scratch = NULL;
+	m_frameStride = 0;
+	m_startTime = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		m_slots[i].sequence = 0;
+		m_slots[i].time = 0;
+		m_slots[i].simMs = 0;
+		m_slots[i].world = NULL;
+		m_slots[i].instances = NULL;
+		m_slots[i].slot = i;
+		m_instanceStorage[i] = NULL;
+	}
+	m_ownInstances = true;
+	m_middle = 1;
+	m_back = 2;
+	m_front = 0;
+	m_sequence = 0;
+	m_totalSimMs = 0;
+	m_published = 0;
+	m_quit = false;
+}
+
+AnimationThread::~AnimationThread()
+{
+	Stop();
+}
+
+void AnimationThread::SetInstanceStorage(mat4x4* const instances[3])
+{
+	for (int i = 0; i < 3; i++)
+	{
+		m_instanceStorage[i] = instances ? instances[i] : NULL;
+	}
+}
+
+void AnimationThread::Start(Skeleton* skel, AnimRec* rec, int numCharacters)
+{
+	Stop();
+	m_ownCrowd.Create(skel, rec, numCharacters);
+	Start(&m_ownCrowd);
+}
+
+void AnimationThread::Start(Crowd* crowd, ThreadPool* pool)
+{
+	Stop();
+	m_crowd = crowd;
+	m_pool = pool;
+	m_stream = NULL;
+	Begin(crowd->GetSkeleton(), crowd->GetNumInstances(), 0);
+}
+
+void AnimationThread::Start(Skeleton* skel, StreamingClip* clip, int numCharacters)
+{
+	Stop();
+	m_crowd = NULL;
+	m_pool = NULL;
+	m_stream = clip;
+	Begin(skel, numCharacters, clip->GetFrameStride());
+}
+
+void AnimationThread::Begin(Skeleton* skel, int numCharacters, int frameStride)
+{
+	m_skel = skel;
+	m_numCharacters = numCharacters > 0 ? numCharacters : 1;
+	m_frameStride = frameStride;
+	if (frameStride > 0)
+	{
+		//zeroed, so a stream that isn't ready yet shows the rest pose
+		m_frames.resize(m_numCharacters);
+		m_sampled = (float*)AlignedAlloc(sizeof(float) * frameStride * m_numCharacters, CACHE_LINE_SIZE);
+		memset(m_sampled, 0, sizeof(float) * frameStride * m_numCharacters);
+		m_scratch = (float*)AlignedAlloc(sizeof(float) * frameStride, CACHE_LINE_SIZE);
+		for (int c = 0; c < m_numCharacters; c++)
+		{
+			m_frames[c] = m_sampled + (size_t)c * frameStride;
+		}
+	}
+
+	size_t numLinks = skel->GetNumLinks();
+	size_t numBones = skel->GetNumBones();
+	m_ownInstances = m_instanceStorage[0] == NULL || m_instanceStorage[1] == NULL || m_instanceStorage[2] == NULL;
+	for (int i = 0; i < 3; i++)
+	{
+		m_slots[i].sequence = 0;
+		m_slots[i].world = (mat4x4*)AlignedAlloc(sizeof(mat4x4) * (numLinks * m_numCharacters + 1), CACHE_LINE_SIZE);
+		m_slots[i].instances = m_ownInstances ? (mat4x4*)AlignedAlloc(sizeof(mat4x4) * (numBones * m_numCharacters + 1), CACHE_LINE_SIZE)
+			: m_instanceStorage[i];
+	}
+	m_middle = 1;
+	m_back = 2;
+	m_front = 0;
+	m_sequence = 0;
+	m_totalSimMs = 0;
+	m_published = 0;
+	m_quit = false;
+	m_startTime = NowSeconds();
+
+	//the first pose is ready before anyone asks, and the skeleton's shared
+	//arrays are built before the thread reads them
+	Evaluate(m_slots[m_back]);
+	Publish();
+
+	m_thread = std::thread(&AnimationThread::ThreadLoop, this);
+}
+
+void AnimationThread::Stop()
+{
+	if (m_thread.joinable())
+	{
+		m_quit = true;
+		m_thread.join();
+	}
+	for (int i = 0; i < 3; i++)
+	{
+		AlignedFree(m_slots[i].world);
+		if (m_ownInstances)
+		{
+			AlignedFree(m_slots[i].instances);
+		}
+		m_slots[i].world = NULL;
+		m_slots[i].instances = NULL;
+	}
+	AlignedFree(m_sampled);
+	m_sampled = NULL;
+	AlignedFree(m_scratch);
+	m_scratch = NULL;
+}
+
+void AnimationThread::Evaluate(PoseFrame& slot)
+{
+	TRACE_SCOPE("Evaluate");
+	double start = NowSeconds();
+	double duration = m_crowd ? m_crowd->GetDuration() : m_stream->GetFrameTime() * (double)m_stream->GetNumFrames();
+	double time = duration > 0 ? fmod(start - m_startTime, duration) : 0;
+
+	if (m_crowd)
+	{
+		//samples, poses and places every instance
+		m_crowd->Evaluate(time, slot.world, slot.instances, m_pool);
+	}
+	else
+	{
+		{
+			TRACE_SCOPE("Sample");
+			m_stream->SetPlayhead(time);
+			for (int c = 0; c < m_numCharacters; c++)
+			{
+				//a character keeps its last frame until a whole one is ready
+				if (m_stream->Sample(time, m_scratch))
+				{
+					memcpy(m_sampled + (size_t)c * m_frameStride, m_scratch, sizeof(float) * m_frameStride);
+				}
+			}
+		}
+
+		int numLinks = m_skel->GetNumLinks();
+		int numBones = m_skel->GetNumBones();
+		m_skel->ComputePoses(m_frames.data(), m_numCharacters, slot.world);
+		TRACE_SCOPE("CalcBoneInstances");
+		for (int c = 0; c < m_numCharacters; c++)
+		{
+			m_skel->CalcBoneInstances(slot.world + (size_t)c * numLinks, slot.instances + (size_t)c * numBones);
+		}
+	}
+
+	slot.sequence = ++m_sequence;
+	slot.time = time;
+	slot.simMs = (NowSeconds() - start) * 1000.0;
+}
+
+void AnimationThread::Publish()
+{
+	double simMs = m_slots[m_back].simMs;
+	uint32_t old = m_middle.exchange((uint32_t)m_back | SLOT_FRESH, std::memory_order_acq_rel);
+	m_back = (int)(old & SLOT_INDEX);
+	m_totalSimMs = m_totalSimMs + simMs;
+	m_published++;
+}
+
+void AnimationThread::ThreadLoop()
+{
+	TRACE_THREAD_NAME("Animation");
+	while (!m_quit)
+	{
+		//stay one pose ahead: wait for the renderer to pick up the last one
+		int idle = 0;
+		while ((m_middle.load(std::memory_order_acquire) & SLOT_FRESH) && !m_quit)
+		{
+			if (++idle < 64)
+				std::this_thread::yield();
+			else
+				std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+		if (m_quit)
+		{
+			break;
+		}
+		Evaluate(m_slots[m_back]);
+		Publish();
+	}
+}
+
+const PoseFrame* AnimationThread::Acquire(bool releaseFront)
+{
+	if (releaseFront && (m_middle.load(std::memory_order_acquire) & SLOT_FRESH))
+	{
+		uint32_t old = m_middle.exchange((uint32_t)m_front, std::memory_order_acq_rel);
+		m_front = (int)(old & SLOT_INDEX);
+	}
+	return m_slots[m_front].sequence > 0 ? &m_slots[m_front] : NULL;
+}
+
+int AnimationThread::GetNumCharacters()
+{
+	return m_numCharacters;
+}
+
+double AnimationThread::GetAverageSimMs()
+{
+	uint64_t published = m_published;
+	return published > 0 ? m_totalSimMs / published : 0;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "linmath.h"
+#include "Crowd.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+class Skeleton;
+class AnimRec;
+class StreamingClip;
+class ThreadPool;
+
+//One evaluated pose as handed to the render thread
+struct PoseFrame
+{
+	//counts up from 1 with every pose the animation thread publishes
+	uint64_t sequence;
+	//clip time the pose was evaluated at, in seconds
+	double time;
+	//how long the animation thread took to evaluate it
+	double simMs;
+	//GetNumLinks() world matrices per character, character after character
+	mat4x4* world;
+	//GetNumBones() bone instance matrices per character (see
+	//Skeleton::CalcBoneInstances)
+	mat4x4* instances;
+	//which of the three slots this is, 0 to 2 (see SetInstanceStorage)
+	int slot;
+};
+
+//Evaluates a clip on its own thread so the render thread only has to pick up
+//finished poses.  While the renderer draws pose N the thread computes pose
+//N+1, so a frame costs max(sim, render) instead of their sum.
+//
+//Poses go through three PoseFrame slots: one the renderer reads, one the
+//thread writes, and the most recently finished one in between.  Handing a
+//slot over is a single atomic exchange of the slot index (with a flag for
+//"not picked up yet"), so neither side ever takes a lock or waits for the
+//other.  The thread starts the next pose once the renderer has picked up
+//the last one, which keeps it one pose ahead instead of spinning.
+class AnimationThread
+{
+public:
+	AnimationThread();
+	~AnimationThread();
+
+	//Has slot i write its instance matrices to instances[i] instead of
+	//memory of the thread's own, e.g. to regions of a mapped GL buffer so
+	//the renderer draws them without a copy.  Each needs room for
+	//GetNumBones() * numCharacters matrices and must stay valid until Stop.
+	//Call before Start; NULL goes back to the thread's own memory.
+	void SetInstanceStorage(mat4x4* const instances[3]);
+
+	//Starts playing a crowd in a loop, clip time following the wall clock
+	//from now.  There is one character per instance, with the crowd's time
+	//offsets and positions (see Crowd::Evaluate).  With a pool each pose is
+	//split over its threads.  The crowd must not be changed until Stop.
+	//The first pose is evaluated before this returns.
+	void Start(Crowd* crowd, ThreadPool* pool = NULL);
+	//Same, for numCharacters instances of rec on skel in a crowd of its own,
+	//spread over the clip with Crowd::SpreadTimeOffsets.  skel needs
+	//AddGeometry, and neither it nor rec may be used by anyone else until
+	//Stop.
+	void Start(Skeleton* skel, AnimRec* rec, int numCharacters = 1);
+	//Same, playing a clip that is still streaming in.  The playhead follows
+	//the clock and every character plays the same time, since only frames
+	//around the playhead are decoded.  A character holds its last pose while
+	//its frames aren't ready.
+	void Start(Skeleton* skel, StreamingClip* clip, int numCharacters = 1);
+	void Stop();
+
+	//Render thread: the newest finished pose.  It stays valid and unchanged
+	//until the next call to Acquire.  With releaseFront false the pose from
+	//the last call is returned again even if a newer one is ready, so its
+	//slot isn't handed back to the thread while the GPU may still be
+	//reading its instance storage.
+	const PoseFrame* Acquire(bool releaseFront = true);
+
+	int GetNumCharacters();
+	//average evaluation time over the poses published so far
+	double GetAverageSimMs();
+
+private:
+	AnimationThread(const AnimationThread&);
+	AnimationThread& operator=(const AnimationThread&);
+
+	//shared part of the Starts, once m_crowd or m_stream is set.  The
+	//sampled frames are only needed for a stream.
+	void Begin(Skeleton* skel, int numCharacters, int frameStride);
+	void ThreadLoop();
+	//evaluates the clip at the current time into slot
+	void Evaluate(PoseFrame& slot);
+	//hands the back slot over as the newest pose
+	void Publish();
+
+	Skeleton* m_skel;
+	//what is playing: a crowd (the caller's or m_ownCrowd) or a stream
+	Crowd* m_crowd;
+	Crowd m_ownCrowd;
+	ThreadPool* m_pool;
+	StreamingClip* m_stream;
+	int m_numCharacters;
+	std::vector<const float*> m_frames;
+	//one sampled frame per character, m_frameStride floats apart
+	float* m_sampled;
+	//where a stream is sampled before it replaces a character's frame, so a
+	//half written sample is never posed
+	float* m_scratch;
+	int m_frameStride;
+	double m_startTime;
+
+	PoseFrame m_slots[3];
+	//caller's instance storage per slot, NULL where the thread allocates
+	mat4x4* m_instanceStorage[3];
+	bool m_ownInstances;
+	//index of the slot in the middle, plus SLOT_FRESH while the renderer
+	//hasn't picked it up yet
+	std::atomic<uint32_t> m_middle;
+	//only touched by the animation thread / the render thread
+	int m_back;
+	int m_front;
+
+	uint64_t m_sequence;
+	std::atomic<double> m_totalSimMs;
+	std::atomic<uint64_t> m_published;
+
+	std::thread m_thread;
+	std::atomic<bool> m_quit;
+};
@@ -0,0 +1,108 @@
+#include "Arena.h"
+#include "AlignedAlloc.h"
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+Arena::Arena(size_t firstBlockBytes)
+{
+	m_block = NULL;
+	m_cur = NULL;
+	m_end = NULL;
+	m_firstBlockBytes = firstBlockBytes > sizeof(Block) ? firstBlockBytes : CACHE_LINE_SIZE;
+	m_nextBlockBytes = m_firstBlockBytes;
+	m_cleanups = NULL;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+Arena::~Arena()
+{
+	Release();
+}
+
+void Arena::NewBlock(size_t minBytes)
+{
+	//room for the header and for aligning the first allocation
+	size_t size = m_nextBlockBytes;
+	if (size < minBytes + sizeof(Block) + CACHE_LINE_SIZE)
+	{
+		size = minBytes + sizeof(Block) + CACHE_LINE_SIZE;
+	}
+	else
+	{
+		m_nextBlockBytes *= 2;
+	}
+
+	Block* block = (Block*)AlignedAlloc(size, CACHE_LINE_SIZE);
+	if (block == NULL)
+	{
+		throw std::bad_alloc();
+	}
+	block->prev = m_block;
+	block->size = size;
+	m_block = block;
+	m_cur = (char*)block + sizeof(Block);
+	m_end = (char*)block + size;
+
+	m_stats.numBlocks++;
+	m_stats.totalBlocks++;
+	m_stats.bytesReserved += size;
+	if (m_stats.bytesReserved > m_stats.peakBytes)
+	{
+		m_stats.peakBytes = m_stats.bytesReserved;
+	}
+}
+
+void* Arena::Alloc(size_t bytes, size_t alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && alignment <= CACHE_LINE_SIZE);
+	uintptr_t at = ((uintptr_t)m_cur + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	if (m_block == NULL || at + bytes > (uintptr_t)m_end)
+	{
+		NewBlock(bytes);
+		at = ((uintptr_t)m_cur + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	}
+	m_stats.bytesUsed += (at + bytes) - (uintptr_t)m_cur;
+	m_stats.numAllocations++;
+	m_stats.totalAllocations++;
+	m_cur = (char*)(at + bytes);
+	return (void*)at;
+}
+
+void Arena::AddCleanup(void* obj, void (*destroy)(void*))
+{
+	Cleanup* cleanup = (Cleanup*)Alloc(sizeof(Cleanup), alignof(Cleanup));
+	cleanup->obj = obj;
+	cleanup->destroy = destroy;
+	cleanup->prev = m_cleanups;
+	m_cleanups = cleanup;
+}
+
+void Arena::Release()
+{
+	for (Cleanup* c = m_cleanups; c != NULL; c = c->prev)
+	{
+		c->destroy(c->obj);
+	}
+	m_cleanups = NULL;
+
+	while (m_block != NULL)
+	{
+		Block* prev = m_block->prev;
+		AlignedFree(m_block);
+		m_block = prev;
+	}
+	m_cur = NULL;
+	m_end = NULL;
+	m_nextBlockBytes = m_firstBlockBytes;
+
+	m_stats.numAllocations = 0;
+	m_stats.numBlocks = 0;
+	m_stats.bytesUsed = 0;
+	m_stats.bytesReserved = 0;
+}
+
+const ArenaStats& Arena::GetStats()
+{
+	return m_stats;
+}
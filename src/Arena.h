@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stddef.h>
+#include <new>
+#include <type_traits>
+
+//Counters kept by an Arena
+struct ArenaStats
+{
+	//Alloc calls since the last Release
+	size_t numAllocations;
+	//blocks taken from the system since the last Release, each one a single
+	//allocation however many objects it holds
+	size_t numBlocks;
+	//bytes handed out (including alignment padding) and bytes held in blocks
+	size_t bytesUsed;
+	size_t bytesReserved;
+	//largest bytesReserved seen over the arena's life, across Releases
+	size_t peakBytes;
+	//Alloc calls and blocks over the arena's life
+	size_t totalAllocations;
+	size_t totalBlocks;
+};
+
+//Bump allocator: memory is carved out of blocks, each twice the size of the
+//one before, and is only given back all at once by Release (or when the
+//arena goes away).  Objects made with New have their destructors run by
+//Release, newest first; the list of them lives in the arena itself.
+class Arena
+{
+public:
+	//firstBlockBytes is the size of the first block, later ones double
+	Arena(size_t firstBlockBytes = 16 * 1024);
+	~Arena();
+
+	//bytes of memory aligned to alignment (a power of two, up to the cache
+	//line size).  Never returns NULL: a request larger than the next block
+	//gets a block of its own.
+	void* Alloc(size_t bytes, size_t alignment = alignof(max_align_t));
+
+	//uninitialized array of count Ts
+	template <class T> T* AllocArray(size_t count)
+	{
+		return (T*)Alloc(sizeof(T) * count, alignof(T) > alignof(max_align_t) ? alignof(T) : alignof(max_align_t));
+	}
+
+	//a T constructed in the arena, destroyed by Release
+	template <class T> T* New()
+	{
+		T* obj = new (Alloc(sizeof(T), alignof(T))) T();
+		if (!std::is_trivially_destructible<T>::value)
+		{
+			AddCleanup(obj, &Destroy<T>);
+		}
+		return obj;
+	}
+
+	//destroys the objects made with New and frees every block.  The arena
+	//can be used again afterwards and starts over from the first block size.
+	void Release();
+
+	const ArenaStats& GetStats();
+
+private:
+	struct Block
+	{
+		Block* prev;
+		size_t size;
+	};
+
+	struct Cleanup
+	{
+		void* obj;
+		void (*destroy)(void*);
+		Cleanup* prev;
+	};
+
+	template <class T> static void Destroy(void* obj)
+	{
+		((T*)obj)->~T();
+	}
+
+	void AddCleanup(void* obj, void (*destroy)(void*));
+	void NewBlock(size_t minBytes);
+
+	Arena(const Arena&);
+	Arena& operator=(const Arena&);
+
+	//newest block, and the free space left at its end
+	Block* m_block;
+	char* m_cur;
+	char* m_end;
+	size_t m_firstBlockBytes;
+	size_t m_nextBlockBytes;
+
+	Cleanup* m_cleanups;
+	ArenaStats m_stats;
+};
@@ -0,0 +1,343 @@
+#include "BVHGenerator.h"
+#include "ThreadPool.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+
+//target size of the block of rows one task formats
+#define GEN_BLOCK_BYTES (1 << 20)
+
+static const char* s_taitBryanOrders[6] = { "XYZ", "XZY", "YXZ", "YZX", "ZXY", "ZYX" };
+static const char* s_properOrders[6] = { "XYX", "XZX", "YXY", "YZY", "ZXZ", "ZYZ" };
+
+//splitmix64, small and good enough to make test data
+static inline uint64_t NextRandom(uint64_t& state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+//uniform in [lo, hi)
+static inline double RandomRange(uint64_t& state, double lo, double hi)
+{
+	return lo + (hi - lo) * (double)(NextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+BVHGenerator::BVHGenerator(const BVHGeneratorSettings& settings)
+{
+	m_settings = settings;
+	BVHGeneratorSettings& s = m_settings;
+	if (s.numJoints < 1) s.numJoints = 1;
+	if (s.branching < 1) s.branching = 1;
+	if (s.chainLength < 1) s.chainLength = 1;
+	if (s.numFrames < 1) s.numFrames = 1;
+	if (!(s.frameRate > 0)) s.frameRate = 30.0;
+	if (s.decimals < 0) s.decimals = 0;
+	if (s.decimals > 9) s.decimals = 9;
+
+	//a spine of hubs, each with branching - 1 chains and then the next hub.
+	//Joints are numbered in the order they appear in the file.
+	m_parent.assign(1, -1);
+	int hub = 0;
+	while ((int)m_parent.size() < s.numJoints)
+	{
+		for (int c = 0; c < s.branching - 1 && (int)m_parent.size() < s.numJoints; c++)
+		{
+			for (int k = 0; k < s.chainLength && (int)m_parent.size() < s.numJoints; k++)
+			{
+				m_parent.push_back(k == 0 ? hub : (int)m_parent.size() - 1);
+			}
+		}
+		if ((int)m_parent.size() < s.numJoints)
+		{
+			m_parent.push_back(hub);
+			hub = (int)m_parent.size() - 1;
+		}
+	}
+	m_children.assign(m_parent.size(), std::vector<int>());
+	for (size_t i = 1; i < m_parent.size(); i++)
+	{
+		m_children[m_parent[i]].push_back((int)i);
+	}
+
+	uint64_t rng = ((uint64_t)s.seed << 32) ^ 0x5DEECE66Dull;
+	int numJoints = (int)m_parent.size();
+	m_offset.assign(numJoints * 3, 0.0f);
+	m_order.assign(numJoints * 3, 'Z');
+	m_hasPosition.assign(numJoints, false);
+	m_hasPosition[0] = true;
+	for (int j = 0; j < numJoints; j++)
+	{
+		if (j > 0)
+		{
+			m_offset[j * 3 + 0] = (float)RandomRange(rng, -0.3, 0.3);
+			m_offset[j * 3 + 1] = (float)RandomRange(rng, 0.5, 1.5);
+			m_offset[j * 3 + 2] = (float)RandomRange(rng, -0.3, 0.3);
+			m_hasPosition[j] = RandomRange(rng, 0.0, 1.0) < s.sixChannelFraction;
+		}
+		PickOrder(rng, &m_order[j * 3]);
+	}
+
+	//channels in row order, which is joint order
+	double frameStep = 2.0 * PI / s.frameRate;
+	for (int j = 0; j < numJoints; j++)
+	{
+		if (m_hasPosition[j])
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				Channel c;
+				if (j == 0)
+				{
+					//the root wanders around the origin at hip height
+					c.bias = a == 1 ? 1.0 : 0.0;
+					c.amplitude = a == 1 ? 0.05 : RandomRange(rng, 1.0, 3.0);
+				}
+				else
+				{
+					c.bias = m_offset[j * 3 + a];
+					c.amplitude = 0.05;
+				}
+				c.step = frameStep * RandomRange(rng, 0.05, 0.5);
+				c.phase = RandomRange(rng, 0.0, 2.0 * PI);
+				m_channels.push_back(c);
+			}
+		}
+		for (int a = 0; a < 3; a++)
+		{
+			Channel c;
+			c.bias = RandomRange(rng, -20.0, 20.0);
+			c.amplitude = RandomRange(rng, 5.0, 45.0);
+			c.step = frameStep * RandomRange(rng, 0.1, 2.0);
+			c.phase = RandomRange(rng, 0.0, 2.0 * PI);
+			m_channels.push_back(c);
+		}
+	}
+}
+
+void BVHGenerator::PickOrder(uint64_t& rng, char order[3])
+{
+	const char* pick = "ZXY";
+	if (m_settings.channelOrders == GEN_ORDERS_TAIT_BRYAN)
+	{
+		pick = s_taitBryanOrders[NextRandom(rng) % 6];
+	}
+	else if (m_settings.channelOrders == GEN_ORDERS_ALL)
+	{
+		int i = (int)(NextRandom(rng) % 12);
+		pick = i < 6 ? s_taitBryanOrders[i] : s_properOrders[i - 6];
+	}
+	memcpy(order, pick, 3);
+}
+
+int BVHGenerator::GetNumJoints()
+{
+	return (int)m_parent.size();
+}
+
+int BVHGenerator::GetNumDOFs()
+{
+	return (int)m_channels.size();
+}
+
+void BVHGenerator::AppendJoint(std::string& out, int joint, int depth)
+{
+	//the indent goes in on its own, deep spines nest hundreds of levels
+	std::string indent(depth, '\t');
+	char line[128];
+	if (joint == 0)
+	{
+		out += "ROOT J0\n{\n";
+	}
+	else
+	{
+		snprintf(line, sizeof(line), "JOINT J%d\n", joint);
+		out += indent + line + indent + "{\n";
+	}
+	const float* offset = &m_offset[joint * 3];
+	snprintf(line, sizeof(line), "\tOFFSET %.4f %.4f %.4f\n", offset[0], offset[1], offset[2]);
+	out += indent + line;
+
+	const char* order = &m_order[joint * 3];
+	snprintf(line, sizeof(line), "\tCHANNELS %d %s%crotation %crotation %crotation\n",
+		m_hasPosition[joint] ? 6 : 3, m_hasPosition[joint] ? "Xposition Yposition Zposition " : "",
+		order[0], order[1], order[2]);
+	out += indent + line;
+
+	for (size_t c = 0; c < m_children[joint].size(); c++)
+	{
+		AppendJoint(out, m_children[joint][c], depth + 1);
+	}
+	if (m_children[joint].empty())
+	{
+		out += indent + "\tEnd Site\n" + indent + "\t{\n" + indent + "\t\tOFFSET 0 0.5 0\n" + indent + "\t}\n";
+	}
+	out += indent + "}\n";
+}
+
+std::string BVHGenerator::GetHeader()
+{
+	std::string out = "HIERARCHY\n";
+	AppendJoint(out, 0, 0);
+	char line[128];
+	snprintf(line, sizeof(line), "MOTION\nFrames: %d\nFrame Time: %.6f\n", m_settings.numFrames, 1.0 / m_settings.frameRate);
+	out += line;
+	return out;
+}
+
+//10^D, a compile time constant so the divisions below become multiplies
+template <int D> struct GenPow10 { static const uint64_t value = 10 * GenPow10<D - 1>::value; };
+template <> struct GenPow10<0> { static const uint64_t value = 1; };
+
+//writes value rounded to D digits after the point.  Returns the end of what
+//was written, at most 22 + D characters.
+template <int D> static inline char* FormatFixed(char* p, double value)
+{
+	const uint64_t scale = GenPow10<D>::value;
+	double scaled = value * (double)scale;
+	uint64_t n = (uint64_t)(int64_t)(fabs(scaled) + 0.5);
+	uint64_t whole = n / scale;
+	uint64_t frac = n % scale;
+
+	//the sign and the one or two digit whole part of most values are written
+	//without branching on them, which are as good as random
+	*p = '-';
+	p += (int)(scaled < 0) & (int)(n != 0);
+	if (whole < 100)
+	{
+		int twoDigits = whole >= 10;
+		char tens = (char)('0' + whole / 10);
+		char ones = (char)('0' + whole % 10);
+		p[0] = (char)(ones + twoDigits * (tens - ones));
+		p[1] = ones;
+		p += 1 + twoDigits;
+	}
+	else
+	{
+		char digits[20];
+		int len = 0;
+		do
+		{
+			digits[len++] = (char)('0' + whole % 10);
+			whole /= 10;
+		} while (whole != 0);
+		while (len > 0) *p++ = digits[--len];
+	}
+
+	if (D > 0)
+	{
+		*p++ = '.';
+		for (int i = D - 1; i >= 0; i--)
+		{
+			p[i] = (char)('0' + frac % 10);
+			frac /= 10;
+		}
+		p += D;
+	}
+	return p;
+}
+
+//count rows of numChannels sine waves, each channel's sine and cosine
+//stepped from frame to frame by a rotation instead of calling sin for every
+//value
+template <int D> static char* FormatRows(char* p, int count, int numChannels, const double* bias, const double* amplitude,
+	double* sinv, double* cosv, const double* sinStep, const double* cosStep)
+{
+	for (int f = 0; f < count; f++)
+	{
+		for (int c = 0; c < numChannels; c++)
+		{
+			if (c > 0) *p++ = ' ';
+			p = FormatFixed<D>(p, bias[c] + amplitude[c] * sinv[c]);
+			double s = sinv[c] * cosStep[c] + cosv[c] * sinStep[c];
+			cosv[c] = cosv[c] * cosStep[c] - sinv[c] * sinStep[c];
+			sinv[c] = s;
+		}
+		*p++ = '\n';
+	}
+	return p;
+}
+
+void BVHGenerator::AppendFrames(int first, int count, std::string& out)
+{
+	int numChannels = (int)m_channels.size();
+	int decimals = m_settings.decimals;
+
+	std::vector<double> bias(numChannels), amplitude(numChannels);
+	std::vector<double> sinv(numChannels), cosv(numChannels), sinStep(numChannels), cosStep(numChannels);
+	for (int c = 0; c < numChannels; c++)
+	{
+		const Channel& ch = m_channels[c];
+		double angle = ch.step * first + ch.phase;
+		bias[c] = ch.bias;
+		amplitude[c] = ch.amplitude;
+		sinv[c] = sin(angle);
+		cosv[c] = cos(angle);
+		sinStep[c] = sin(ch.step);
+		cosStep[c] = cos(ch.step);
+	}
+
+	size_t start = out.size();
+	out.resize(start + (size_t)count * numChannels * (23 + decimals) + count);
+	char* p = &out[start];
+	switch (decimals)
+	{
+#define GEN_FORMAT_CASE(D) case D: p = FormatRows<D>(p, count, numChannels, bias.data(), amplitude.data(), \
+		sinv.data(), cosv.data(), sinStep.data(), cosStep.data()); break;
+	GEN_FORMAT_CASE(0) GEN_FORMAT_CASE(1) GEN_FORMAT_CASE(2) GEN_FORMAT_CASE(3) GEN_FORMAT_CASE(4)
+	GEN_FORMAT_CASE(5) GEN_FORMAT_CASE(6) GEN_FORMAT_CASE(7) GEN_FORMAT_CASE(8) GEN_FORMAT_CASE(9)
+#undef GEN_FORMAT_CASE
+	}
+	out.resize(p - out.data());
+}
+
+uint64_t BVHGenerator::WriteFile(const char* filename, ThreadPool* pool)
+{
+	if (pool == NULL)
+	{
+		pool = &ThreadPool::Shared();
+	}
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		return 0;
+	}
+
+	std::string header = GetHeader();
+	bool ok = fwrite(header.data(), 1, header.size(), file) == header.size();
+	uint64_t bytes = header.size();
+
+	//blocks of rows are formatted a batch at a time, one block per task, and
+	//written in order before the next batch
+	size_t rowBytes = (size_t)GetNumDOFs() * (m_settings.decimals + 5);
+	int blockFrames = (int)(GEN_BLOCK_BYTES / (rowBytes > 0 ? rowBytes : 1));
+	if (blockFrames < 1) blockFrames = 1;
+	int numFrames = m_settings.numFrames;
+	int numBlocks = (numFrames + blockFrames - 1) / blockFrames;
+	int batch = pool->GetNumThreads() * 2;
+	std::vector<std::string> blocks(batch);
+	for (int b = 0; b < numBlocks && ok; b += batch)
+	{
+		int n = numBlocks - b < batch ? numBlocks - b : batch;
+		pool->Run(n, [&](int i)
+		{
+			int first = (b + i) * blockFrames;
+			int count = numFrames - first < blockFrames ? numFrames - first : blockFrames;
+			blocks[i].clear();
+			AppendFrames(first, count, blocks[i]);
+		});
+		for (int i = 0; i < n && ok; i++)
+		{
+			ok = fwrite(blocks[i].data(), 1, blocks[i].size(), file) == blocks[i].size();
+			bytes += blocks[i].size();
+		}
+	}
+	ok = fclose(file) == 0 && ok;
+	return ok ? bytes : 0;
+}
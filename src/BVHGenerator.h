@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+class ThreadPool;
+
+//channel orders the generated joints get
+#define GEN_ORDERS_BVH 0         //ZXY everywhere, like most capture exports
+#define GEN_ORDERS_TAIT_BRYAN 1  //any order of three distinct axes, picked per joint
+#define GEN_ORDERS_ALL 2         //all 12 Euler orders, proper ones (ZXZ, ...) included
+
+struct BVHGeneratorSettings
+{
+	//ROOT and JOINTs, end sites come on top
+	int numJoints = 100;
+	//children of a hub: branching - 1 chains and the next hub of the spine,
+	//so 1 gives a single chain
+	int branching = 8;
+	//joints in each chain hanging off a hub
+	int chainLength = 4;
+	int numFrames = 100;
+	double frameRate = 30.0;
+	//the same seed and settings always give the same file
+	uint32_t seed = 1;
+	int channelOrders = GEN_ORDERS_BVH;
+	//share of the non-root joints with position channels as well (6
+	//channels).  BVHReader refuses to load files with positions below the
+	//root, so anything above 0 is only for other readers.
+	double sixChannelFraction = 0.0;
+	//digits after the decimal point in the MOTION rows
+	int decimals = 4;
+};
+
+//Writes valid BVH files of any size for scale and stress testing: a spine of
+//hubs with chains hanging off them, random offsets and channel orders, and
+//smooth motion made of a sine wave per channel.  Everything is derived from
+//the seed, so the output doesn't depend on the number of threads.  Rows are
+//formatted in blocks on a ThreadPool and written in order, so multi-GB files
+//take seconds.
+class BVHGenerator
+{
+public:
+	BVHGenerator(const BVHGeneratorSettings& settings);
+
+	int GetNumJoints();
+	//values in a MOTION row
+	int GetNumDOFs();
+
+	//the HIERARCHY section and the MOTION preamble up to the first row
+	std::string GetHeader();
+
+	//appends the MOTION rows of frames [first, first + count) to out
+	void AppendFrames(int first, int count, std::string& out);
+
+	//Writes the whole file, the rows formatted on pool (the shared pool if
+	//NULL).  Returns the number of bytes written, 0 on failure.
+	uint64_t WriteFile(const char* filename, ThreadPool* pool = NULL);
+
+private:
+	//a sine wave bias + amplitude * sin(step * frame + phase)
+	struct Channel
+	{
+		double bias;
+		double amplitude;
+		double step;
+		double phase;
+	};
+
+	void AppendJoint(std::string& out, int joint, int depth);
+	//random channel order for a joint, as axis letters
+	void PickOrder(uint64_t& rng, char order[3]);
+
+	BVHGeneratorSettings m_settings;
+
+	std::vector<int> m_parent;
+	std::vector<std::vector<int> > m_children;
+	//per joint: offset from the parent, rotation order, position channels
+	std::vector<float> m_offset;
+	std::vector<char> m_order;
+	std::vector<bool> m_hasPosition;
+
+	//one per value of a row, in row order
+	std::vector<Channel> m_channels;
+};
@@ -2,9 +2,16 @@
 #include "Skeleton.h"
 #include <iostream>
 #include <stack>
+#include <string>
 #include "Link.h"
 #include <assert.h>
 #include "AnimRec.h"
+#include "MappedFile.h"
+#include "BVHTokenizer.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <string.h>
+#include <stdlib.h>
 
 #define KP_XPOSITION 1;
 #define KP_YPOSITION 2;
@@ -26,6 +33,19 @@ void trim(const char* in, char* out)
 	}
 }
 
+BVHReader::BVHReader()
+{
+	m_numThreads = 0;
+	m_headerOnly = false;
+	m_motionBegin = NULL;
+	m_headerFrames = 0;
+}
+
+void BVHReader::SetNumThreads(int n)
+{
+	m_numThreads = n;
+}
+
 //This code is based on a bvh reader from the DANCE framework, likely written by Ari Shapiro
 void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, AnimRec* pAnimRec, bool inToM)
 {
@@ -36,11 +56,15 @@ void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, Anim
 		std::cerr << "Could not open file in CKinSkelParseBVH::Parse\n";
 		return;
 	}
-	char line[8192];
+	//grows to the longest line, MOTION rows of big rigs run to many kilobytes
+	std::string lineBuf;
+	char* line;
 	int state = 0;
 	char* str = NULL;
-	std::stack<Link*> stack;
+	//indices of the open joints, innermost on top
+	std::stack<int> stack;
 	Link* curLink = NULL;
+	int curIndex = -1;
 	int numFrames = 0;
 	int curFrame = -1;
 	double frameTime = 0;
@@ -51,7 +75,8 @@ void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, Anim
 
 	while (!file.eof() && file.good())
 	{
-		file.getline(line, 8192, '\n');
+		std::getline(file, lineBuf);
+		line = &lineBuf[0];
 		// remove any trailing \r
 		if (line[strlen(line) - 1] == '\r')
 			line[strlen(line) - 1] = '\0';
@@ -77,11 +102,11 @@ void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, Anim
 				str = strtok(NULL, " \t");
 				if (str != NULL)
 				{
-					curLink = new Link();
+					curLink = newSkel->NewLink();
 					curLink->SetName(str);
 
 					//put link in tree
-					newSkel->AddToSkeleton(curLink, (char *)"$ground");
+					curIndex = newSkel->AddToSkeleton(curLink, -1);
 
 					curLink->SetJointType("free");
 
@@ -105,7 +130,7 @@ void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, Anim
 			str = strtok(line, " \t");
 			if (str != NULL && strncmp(str, "{", 1) == 0)
 			{
-				stack.push(curLink);
+				stack.push(curIndex);
 				state = 3;
 			}
 			else
@@ -150,14 +175,15 @@ void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, Anim
 				str = strtok(NULL, " \t");
 				int numChannels = atoi(str);
 
-				// make sure that only the root has > 3 channels
-				bool ignoreChannels = false;
+				// only the root can have > 3 channels: the skeleton poses
+				// positions on the root only, and dropping them would misalign
+				// every MOTION row after this joint
 				if (numChannels > 3 && foundRoot == 2)
 				{
-					std::cerr << "Too many channels (%d) found for non-root node at %s, reducing to %d..."<< numChannels<< curLink->GetName() << (numChannels - 3) << std::endl;
-					ignoreChannels = true;
+					std::cerr << "Too many channels (" << numChannels << ") found for non-root node at " << curLink->GetName() << ", only the root can have positions" << std::endl;
+					file.close();
+					return;
 				}
-				int channels[6] = { 0 };
 				//std::cerr << "Found %d channels...\n", numChannels);
 				for (int c = 0; c < numChannels; c++)
 				{
@@ -167,34 +193,28 @@ void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, Anim
 					if (strncmp(str, "Xrotation", strlen("Xrotation")) == 0)
 					{
 						curLink->SetAxisOrder(axisNum, 0);
-						channels[c] = KP_XROTATION;
 						numRot++;
 					}
 					else if (strncmp(str, "Yrotation", strlen("Yrotation")) == 0)
 					{
 						curLink->SetAxisOrder(axisNum, 1);
-						channels[c] = KP_YROTATION;
 						numRot++;
 					}
 					else if (strncmp(str, "Zrotation", strlen("Zrotation")) == 0)
 					{
 						curLink->SetAxisOrder(axisNum, 2);
-						channels[c] = KP_ZROTATION;
 						numRot++;
 					}
 					else if (strncmp(str, "Xposition", strlen("Xposition")) == 0)
 					{
-						channels[c] = KP_XPOSITION;
 						numTrans++;
 					}
 					else if (strncmp(str, "Yposition", strlen("Yposition")) == 0)
 					{
-						channels[c] = KP_YPOSITION;
 						numTrans++;
 					}
 					else if (strncmp(str, "Zposition", strlen("Zposition")) == 0)
 					{
-						channels[c] = KP_ZPOSITION;
 						numTrans++;
 					}
 					else
@@ -203,14 +223,6 @@ void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, Anim
 						file.close();
 					}
 				}
-				if (ignoreChannels)
-				{
-					assert(false);//from ParseBVH, but doesn't seem right
-					for (int i = 0; i < 3; i++)
-						channels[i] = channels[i + 3];
-					numChannels -= 3;
-				}
-
 				if (foundRoot == 2)
 				{
 					assert(numTrans == 0 && numRot > 0);
@@ -264,7 +276,7 @@ void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, Anim
 				{
 					char trimmedname[512];
 					trim(str, trimmedname);
-					curLink = new Link();
+					curLink = newSkel->NewLink();
 					curLink->SetName(trimmedname);
 
 					//						CharJoint* joint = new CharJoint(trimmedname);
@@ -273,8 +285,7 @@ void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, Anim
 					//						joint->setParent(top);
 					//						cur = joint;
 
-					Link* top = stack.top();
-					newSkel->AddToSkeleton(curLink, top->GetName());
+					curIndex = newSkel->AddToSkeleton(curLink, stack.top());
 					//stack.push(trimmedname);
 
 
@@ -358,11 +369,10 @@ void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, Anim
 				z = atof(str);
 				
 				//Creating new Link for end site
-				curLink = new Link();
-				Link* top = stack.top();
+				curLink = newSkel->NewLink();
 
 				// Adding end site to skeleton and linking to parent
-				newSkel->AddToSkeleton(curLink, top->GetName());
+				newSkel->AddToSkeleton(curLink, stack.top());
 
 				// Setting end site joint type to weld as it has 0 dof
 				curLink->SetJointType("weld");
@@ -467,4 +477,440 @@ void BVHReader::BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, Anim
 		}
 	}
 
-}
\ No newline at end of file
+}
+
+bool BVHReader::BuildSkelFromFile(const char* filename, Skeleton* newSkel, AnimRec* pAnimRec, bool inToM)
+{
+	TRACE_SCOPE("BuildSkelFromFile");
+	MappedFile file;
+	if (!file.Open(filename))
+	{
+		std::cerr << "Could not open file in CKinSkelParseBVH::Parse\n";
+		return false;
+	}
+	BuildSkelFromBuffer(file.GetData(), file.GetData() + file.GetSize(), newSkel, pAnimRec, inToM);
+	return true;
+}
+
+//Same state machine as BuildSkelFromHeader, but walking the buffer with pointers.
+//Each line is a [lineBegin, lineEnd) range and tokens are ranges inside it.
+void BVHReader::BuildSkelFromBuffer(const char* begin, const char* end, Skeleton* newSkel, AnimRec* pAnimRec, bool inToM)
+{
+	int state = 0;
+	BVHToken tok;
+	//indices of the open joints, innermost on top
+	std::stack<int> stack;
+	Link* curLink = NULL;
+	int curIndex = -1;
+	int numFrames = 0;
+	double frameTime = 0;
+	int foundRoot = 0; // 0 = root not found, 1 = root found, 2 = next joint found
+	int numRot = 0;
+	int numTrans = 0;
+	int totalDOFs = 0;
+
+	const char* next = begin;
+	while (next < end)
+	{
+		const char* lineBegin = next;
+		const char* lineEnd = BVHFindLineEnd(lineBegin, end);
+		next = lineEnd + 1;
+		lineEnd = BVHTrimLineEnd(lineBegin, lineEnd);
+
+		// p walks the tokens of the current line
+		const char* p = lineBegin;
+		if (!BVHNextToken(p, lineEnd, tok)) // ignore blank lines
+			continue;
+
+		switch (state)
+		{
+		case 0:	// looking for 'HIERARCHY'
+			if (BVHTokenStartsWith(tok, "HIERARCHY"))
+				state = 1;
+			else
+			{
+				std::cerr << "HIERARCHY not found...\n";
+				return;
+			}
+			break;
+		case 1:	// looking for 'ROOT'
+			if (BVHTokenStartsWith(tok, "ROOT"))
+			{
+				if (BVHNextToken(p, lineEnd, tok))
+				{
+					char name[MAX_NAME_LEN + 1];
+					BVHTokenCopy(tok, name, sizeof(name));
+					curLink = newSkel->NewLink();
+					curLink->SetName(name);
+
+					//put link in tree
+					curIndex = newSkel->AddToSkeleton(curLink, -1);
+
+					curLink->SetJointType("free");
+
+					state = 2;
+				}
+				else
+				{
+					std::cerr << "ROOT name not found...\n";
+					return;
+				}
+			}
+			else
+			{
+				std::cerr << "ROOT not found...\n";
+				return;
+			}
+			break;
+		case 2: // looking for '{'
+			if (*tok.begin == '{')
+			{
+				stack.push(curIndex);
+				state = 3;
+			}
+			else
+			{
+				std::cerr << "{ not found...\n";
+				return;
+			}
+			break;
+		case 3: // looking for 'OFFSET'
+			if (BVHTokenStartsWith(tok, "OFFSET"))
+			{
+				if (foundRoot == 0)
+					foundRoot = 1;
+				else if (foundRoot == 1)
+					foundRoot = 2;
+				double v[3] = { 0, 0, 0 };
+				for (int i = 0; i < 3 && BVHNextToken(p, lineEnd, tok); i++)
+					v[i] = BVHTokenToDouble(tok);
+				curLink->SetParTranslation(v[0], v[1], v[2]);
+				state = 4;
+			}
+			else
+			{
+				std::cerr << "OFFSET not found...\n";
+				return;
+			}
+			break;
+		case 4: // looking for 'CHANNELS'
+			numRot = 0;
+			numTrans = 0;
+			if (BVHTokenStartsWith(tok, "CHANNELS"))
+			{
+				int numChannels = 0;
+				if (BVHNextToken(p, lineEnd, tok))
+					numChannels = BVHTokenToInt(tok);
+
+				// only the root can have > 3 channels (see BuildSkelFromHeader)
+				if (numChannels > 3 && foundRoot == 2)
+				{
+					std::cerr << "Too many channels (" << numChannels << ") found for non-root node at " << curLink->GetName() << ", only the root can have positions" << std::endl;
+					return;
+				}
+				for (int c = 0; c < numChannels && c < 6; c++)
+				{
+					if (!BVHNextToken(p, lineEnd, tok))
+					{
+						std::cerr << "Unknown channel: %s...\n";
+						return;
+					}
+					int axisNum = c;
+					if (c > 2) axisNum -= 3;
+					if (BVHTokenStartsWith(tok, "Xrotation"))
+					{
+						curLink->SetAxisOrder(axisNum, 0);
+						numRot++;
+					}
+					else if (BVHTokenStartsWith(tok, "Yrotation"))
+					{
+						curLink->SetAxisOrder(axisNum, 1);
+						numRot++;
+					}
+					else if (BVHTokenStartsWith(tok, "Zrotation"))
+					{
+						curLink->SetAxisOrder(axisNum, 2);
+						numRot++;
+					}
+					else if (BVHTokenStartsWith(tok, "Xposition"))
+					{
+						numTrans++;
+					}
+					else if (BVHTokenStartsWith(tok, "Yposition"))
+					{
+						numTrans++;
+					}
+					else if (BVHTokenStartsWith(tok, "Zposition"))
+					{
+						numTrans++;
+					}
+					else
+					{
+						std::cerr << "Unknown channel: %s...\n" << std::string(tok.begin, tok.end);
+						return;
+					}
+				}
+				if (foundRoot == 2)
+				{
+					assert(numTrans == 0 && numRot > 0);
+				}
+
+				const char* jointType = NULL;
+				if (numChannels == 6)
+				{
+					//represent this using the bvh native euler angle representation
+					jointType = "eulersix";
+				}
+				else if (numRot == 1)
+				{
+					jointType = "pin";
+				}
+				else if (numRot == 2)
+				{
+					jointType = "ujoint";
+				}
+				else if (numRot == 3)
+				{
+					jointType = "gimbal";
+					//NOTE: NOT CURRENTLY ALLOWING FOR BALL JOINTS
+				}
+				else
+				{
+					assert(false);
+					jointType = "unknown";
+				}
+
+				totalDOFs += numChannels;
+
+				curLink->SetJointType(jointType);
+
+				state = 5;
+			}
+			else
+			{
+				std::cerr << "CHANNELS not found...\n";
+				return;
+			}
+			break;
+		case 5: // looking for 'JOINT' or 'End Site' or '}' or 'MOTION'
+			if (BVHTokenStartsWith(tok, "JOINT"))
+			{
+				BVHToken name;
+				if (BVHNextToken(p, lineEnd, name))
+				{
+					//joint names may contain spaces, so take the rest of the line
+					name.end = lineEnd;
+					char trimmedname[MAX_NAME_LEN + 1];
+					BVHTokenCopy(name, trimmedname, sizeof(trimmedname));
+					curLink = newSkel->NewLink();
+					curLink->SetName(trimmedname);
+
+					curIndex = newSkel->AddToSkeleton(curLink, stack.top());
+
+					state = 2;
+				}
+				else
+				{
+					std::cerr << "ROOT name not found...\n";
+					return;
+				}
+			}
+			else if (BVHTokenStartsWith(tok, "End"))
+			{
+				if (BVHNextToken(p, lineEnd, tok) && BVHTokenStartsWith(tok, "Site"))
+				{
+					state = 6;
+				}
+				else
+				{
+					std::cerr << "End site not found...\n";
+					return;
+				}
+			}
+			else if (*tok.begin == '}')
+			{
+				stack.pop();
+				state = 5;
+			}
+			else if (BVHTokenStartsWith(tok, "MOTION"))
+			{
+				state = 9;
+			}
+			else
+			{
+				std::cerr << "JOINT or End Site not found...\n";
+				return;
+			}
+			break;
+		case 6: // looking for '{' of the end effector
+			if (*tok.begin == '{')
+			{
+				state = 7;
+			}
+			else
+			{
+				std::cerr << "{ not found for end effector...\n";
+				std::cerr << "{ not found for end effector..." << std::endl;
+				return;
+			}
+			break;
+		case 7: // looking for 'OFFSET' within end effector
+			if (BVHTokenStartsWith(tok, "OFFSET"))
+			{
+				//This is for the end effector
+				double v[3] = { 0, 0, 0 };
+				for (int i = 0; i < 3 && BVHNextToken(p, lineEnd, tok); i++)
+					v[i] = BVHTokenToDouble(tok);
+
+				//Creating new Link for end site
+				curLink = newSkel->NewLink();
+
+				// Adding end site to skeleton and linking to parent
+				newSkel->AddToSkeleton(curLink, stack.top());
+
+				// Setting end site joint type to weld as it has 0 dof
+				curLink->SetJointType("weld");
+
+				// Setting m_parTrans for end site
+				curLink->SetParTranslation(v[0], v[1], v[2]);
+
+				state = 8;
+			}
+			else
+			{
+				std::cerr << "End effector OFFSET not found...\n";
+				return;
+			}
+			break;
+		case 8: // looking for '}' to finish the  end effector
+			if (*tok.begin == '}')
+			{
+				state = 5;
+			}
+			else
+			{
+				std::cerr << "} not found for end effector...\n";
+				return;
+			}
+			break;
+		case 9: // found 'MOTION', looking for 'Frames'
+			p = lineBegin;
+			if (BVHNextToken(p, lineEnd, tok, ":") && BVHTokenStartsWith(tok, "Frames")
+				&& BVHNextToken(p, lineEnd, tok, ": \t"))
+			{
+				numFrames = BVHTokenToInt(tok);
+				std::cout << "Found " << numFrames << " frames of animation...\n" << std::endl;
+				state = 10;
+			}
+			else
+			{
+				std::cerr << "Frames: not found...\n";
+				return;
+			}
+			break;
+		case 10: // found 'Frames', looking for 'Frame time:'
+			p = lineBegin;
+			if (BVHNextToken(p, lineEnd, tok, ":") && BVHTokenStartsWith(tok, "Frame Time")
+				&& BVHNextToken(p, lineEnd, tok, ": \t"))
+			{
+				frameTime = BVHTokenToDouble(tok);
+				std::cout << "Frame time is: " << frameTime << std::endl;
+				pAnimRec->SetFrameTime(frameTime);
+				pAnimRec->SetNumDOFs(totalDOFs);
+
+				if (m_headerOnly)
+				{
+					m_motionBegin = next;
+					m_headerFrames = numFrames;
+					return;
+				}
+				//every row from here on is independent, so hand the rest of the
+				//buffer to the motion decoder
+				DecodeMotion(next, end, numFrames, pAnimRec, inToM);
+				return;
+			}
+			else
+			{
+				std::cerr << "Frame Time: not found...\n";
+				return;
+			}
+			break;
+		default:
+			std::cerr << "State " << state << " not expected..." << std::endl;
+			return;
+		}
+	}
+}
+
+const char* BVHReader::BuildSkelFromBufferHeader(const char* begin, const char* end, Skeleton* newSkel, AnimRec* pAnimRec, bool inToM, int* numFrames)
+{
+	m_headerOnly = true;
+	m_motionBegin = NULL;
+	m_headerFrames = 0;
+	BuildSkelFromBuffer(begin, end, newSkel, pAnimRec, inToM);
+	m_headerOnly = false;
+	*numFrames = m_headerFrames;
+	return m_motionBegin;
+}
+
+void BVHReader::DecodeMotion(const char* begin, const char* end, int numFrames, AnimRec* pAnimRec, bool inToM)
+{
+	//find the rows (blank lines are skipped, like everywhere else in the file)
+	std::vector<BVHToken> rows;
+	rows.reserve(numFrames > 0 ? numFrames : 0);
+	const char* next = begin;
+	while (next < end && (int)rows.size() < numFrames)
+	{
+		BVHToken row;
+		row.begin = next;
+		row.end = BVHFindLineEnd(next, end);
+		next = row.end + 1;
+		row.end = BVHTrimLineEnd(row.begin, row.end);
+
+		const char* p = row.begin;
+		BVHToken tok;
+		if (BVHNextToken(p, row.end, tok))
+		{
+			rows.push_back(row);
+		}
+	}
+
+	int numRows = (int)rows.size();
+	int numDOFs = pAnimRec->GetNumDOFs();
+	int firstFrame = pAnimRec->GetNumFrames();
+	pAnimRec->AllocateFrames(numRows);
+
+	//blocks are small enough to balance the load but big enough that the
+	//per block overhead disappears
+	const int rowsPerBlock = 256;
+	int numBlocks = (numRows + rowsPerBlock - 1) / rowsPerBlock;
+	std::function<void(int)> decodeBlock = [&](int block)
+	{
+		int last = (block + 1) * rowsPerBlock;
+		if (last > numRows) last = numRows;
+		for (int i = block * rowsPerBlock; i < last; i++)
+		{
+			AnimRec::ParseFrame(rows[i].begin, rows[i].end, pAnimRec->GetFrameData(firstFrame + i), numDOFs, inToM);
+		}
+	};
+
+	if (m_numThreads == 1 || numBlocks < 2)
+	{
+		for (int b = 0; b < numBlocks; b++) decodeBlock(b);
+	}
+	else if (m_numThreads == 0)
+	{
+		ThreadPool::Shared().Run(numBlocks, decodeBlock);
+	}
+	else
+	{
+		ThreadPool pool(m_numThreads);
+		pool.Run(numBlocks, decodeBlock);
+	}
+
+	if (numRows < numFrames)
+	{
+		std::cerr << "Only found " << numRows << " of " << numFrames << " frames of motion..." << std::endl;
+	}
+	std::cout << "Finished parsing motion with %d frames... " << numRows << std::endl;
+}
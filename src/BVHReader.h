@@ -8,7 +8,42 @@ class BVHReader
 {
 
 public:
+	BVHReader();
+
+	//Number of threads used to decode the MOTION rows.
+	//0 (the default) uses the shared pool, 1 decodes on the calling thread.
+	void SetNumThreads(int n);
+
+	//Line based reader.  Reads the stream one line at a time with getline.
 	void BuildSkelFromHeader(std::ifstream& file, Skeleton* newSkel, AnimRec* pAnimRec, bool inToM);
 
+	//Memory maps filename and parses it with BuildSkelFromBuffer.
+	//Returns false if the file could not be opened.
+	bool BuildSkelFromFile(const char* filename, Skeleton* newSkel, AnimRec* pAnimRec, bool inToM);
+
+	//Parses a complete bvh file held in memory.  The buffer does not need to be
+	//null terminated and is never modified or copied line by line.
+	//Runs the same state machine (and reports the same errors) as BuildSkelFromHeader.
+	void BuildSkelFromBuffer(const char* begin, const char* end, Skeleton* newSkel, AnimRec* pAnimRec, bool inToM);
+
+	//Same as above, but stops after the MOTION header: pAnimRec gets the
+	//frame time and number of dofs and no frames.  Returns where the first
+	//MOTION row starts and the header's frame count through numFrames, or
+	//NULL if the header is incomplete.  Used to stream the rows instead.
+	const char* BuildSkelFromBufferHeader(const char* begin, const char* end, Skeleton* newSkel, AnimRec* pAnimRec, bool inToM, int* numFrames);
+
+private:
+	//Decodes up to numFrames MOTION rows found in [begin, end) into pAnimRec.
+	//Row boundaries are found in one pass, then blocks of rows are parsed in
+	//parallel straight into their slots in the frame storage.
+	void DecodeMotion(const char* begin, const char* end, int numFrames, AnimRec* pAnimRec, bool inToM);
+
+	int m_numThreads;
+
+	//set by BuildSkelFromBufferHeader so the parse stops at the first row
+	bool m_headerOnly;
+	const char* m_motionBegin;
+	int m_headerFrames;
+
 };
 
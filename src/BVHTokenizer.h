@@ -0,0 +1,100 @@
+#pragma once
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "FastFloat.h"
+
+//Pointer based tokenizer used by the memory mapped BVH reader.
+//Nothing is copied or modified; tokens are [begin, end) ranges into the
+//original buffer, which is NOT null terminated.
+
+struct BVHToken
+{
+	const char* begin;
+	const char* end;
+};
+
+//Finds the end of the line starting at p (the position of the '\n' or end)
+static inline const char* BVHFindLineEnd(const char* p, const char* end)
+{
+	const char* nl = (const char*)memchr(p, '\n', end - p);
+	return nl ? nl : end;
+}
+
+//Returns the line end with any trailing '\r' and whitespace removed
+static inline const char* BVHTrimLineEnd(const char* begin, const char* lineEnd)
+{
+	while (lineEnd > begin && (lineEnd[-1] == '\r' || lineEnd[-1] == ' ' || lineEnd[-1] == '\t'))
+		lineEnd--;
+	return lineEnd;
+}
+
+static inline bool BVHIsDelim(char c, const char* delims)
+{
+	return strchr(delims, c) != NULL && c != '\0';
+}
+
+static inline bool BVHIsSpace(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+//Reads the next token delimited by spaces or tabs.
+//p is advanced past the token.  Returns false if there are no more tokens.
+static inline bool BVHNextToken(const char*& p, const char* end, BVHToken& tok)
+{
+	while (p < end && BVHIsSpace(*p))
+		p++;
+	if (p >= end)
+		return false;
+	tok.begin = p;
+	while (p < end && !BVHIsSpace(*p))
+		p++;
+	tok.end = p;
+	return true;
+}
+
+//Same as above but delimited by any of the characters in delims
+static inline bool BVHNextToken(const char*& p, const char* end, BVHToken& tok, const char* delims)
+{
+	while (p < end && BVHIsDelim(*p, delims))
+		p++;
+	if (p >= end)
+		return false;
+	tok.begin = p;
+	while (p < end && !BVHIsDelim(*p, delims))
+		p++;
+	tok.end = p;
+	return true;
+}
+
+//true if the token starts with the given keyword (same test as the
+//strncmp(str, "KEYWORD", strlen("KEYWORD")) checks in the line reader)
+static inline bool BVHTokenStartsWith(const BVHToken& tok, const char* keyword)
+{
+	size_t len = strlen(keyword);
+	return (size_t)(tok.end - tok.begin) >= len && strncmp(tok.begin, keyword, len) == 0;
+}
+
+//Converts a numeric token (locale independent, see FastFloat.h)
+static inline double BVHTokenToDouble(const BVHToken& tok)
+{
+	double val;
+	ParseDouble(tok.begin, tok.end, val);
+	return val;
+}
+
+static inline int BVHTokenToInt(const BVHToken& tok)
+{
+	return (int)BVHTokenToDouble(tok);
+}
+
+//Copies the token into out as a null terminated string of at most outSize-1 chars
+static inline void BVHTokenCopy(const BVHToken& tok, char* out, size_t outSize)
+{
+	size_t len = tok.end - tok.begin;
+	if (len > outSize - 1) len = outSize - 1;
+	memcpy(out, tok.begin, len);
+	out[len] = '\0';
+}
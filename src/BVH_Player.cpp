@@ -10,41 +10,109 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <iostream>
+#include <string.h>
 
 #include "Skeleton.h"
-#include "AnimRec.h"
+#include "Link.h"
+#include "StreamBuffer.h"
+#include "AnimationThread.h"
+#include "StreamingClip.h"
+#include "Trace.h"
+#include "Hud.h"
 #include "defs.h"
 
 
+//Every bone is an instance of one unit pyramid.  The instance matrix takes
+//attribute locations 2 to 5, one column each.
 static const char* vertex_shader_text =
-"#version 110\n"
+"#version 330 core\n"
 "uniform mat4 MVP;\n"
-"attribute vec3 vCol;\n"
-"attribute vec3 vPos;\n"
-"varying vec3 color;\n"
+"layout(location = 0) in vec3 vPos;\n"
+"layout(location = 1) in vec3 vCol;\n"
+"layout(location = 2) in mat4 boneMat;\n"
+"out vec3 color;\n"
 "void main()\n"
 "{\n"
-"    gl_Position = MVP * vec4(vPos, 1.0);\n"
+"    gl_Position = MVP * boneMat * vec4(vPos, 1.0);\n"
 "    color = vCol;\n"
 "}\n";
 
 static const char* fragment_shader_text =
-"#version 110\n"
-"varying vec3 color;\n"
+"#version 330 core\n"
+"in vec3 color;\n"
+"out vec4 fragColor;\n"
 "void main()\n"
 "{\n"
-"    gl_FragColor = vec4(color, 1.0);\n"
+"    fragColor = vec4(color, 1.0);\n"
 "}\n";
 
+//The overlay: pixel positions, atlas coordinates and a color per vertex.
+//The font atlas holds coverage in its red channel.
+static const char* hud_vertex_shader_text =
+"#version 330 core\n"
+"uniform vec2 screen;\n"
+"layout(location = 0) in vec2 vPos;\n"
+"layout(location = 1) in vec2 vTex;\n"
+"layout(location = 2) in vec4 vCol;\n"
+"out vec2 tex;\n"
+"out vec4 color;\n"
+"void main()\n"
+"{\n"
+"    gl_Position = vec4(vPos.x / screen.x * 2.0 - 1.0, 1.0 - vPos.y / screen.y * 2.0, 0.0, 1.0);\n"
+"    tex = vTex;\n"
+"    color = vCol;\n"
+"}\n";
+
+static const char* hud_fragment_shader_text =
+"#version 330 core\n"
+"uniform sampler2D font;\n"
+"in vec2 tex;\n"
+"in vec4 color;\n"
+"out vec4 fragColor;\n"
+"void main()\n"
+"{\n"
+"    fragColor = vec4(color.rgb, color.a * texture(font, tex).r);\n"
+"}\n";
+
+static GLuint make_program(const char* vertex_text, const char* fragment_text)
+{
+    GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertex_shader, 1, &vertex_text, NULL);
+    glCompileShader(vertex_shader);
+
+    GLuint fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragment_shader, 1, &fragment_text, NULL);
+    glCompileShader(fragment_shader);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex_shader);
+    glAttachShader(program, fragment_shader);
+    glLinkProgram(program);
+    return program;
+}
+
 static void error_callback(int error, const char* description)
 {
     fprintf(stderr, "Error: %s\n", description);
 }
 
+//where the trace goes on T and on exit, in builds with BVH_TRACE
+#define TRACE_FILE "bvh_trace.json"
+
+//H shows and hides the overlay, R resets its late and dropped counts
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+    Hud* hud = (Hud*)glfwGetWindowUserPointer(window);
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
         glfwSetWindowShouldClose(window, GLFW_TRUE);
+    if (key == GLFW_KEY_H && action == GLFW_PRESS && hud != NULL)
+        hud->ToggleVisible();
+    if (key == GLFW_KEY_R && action == GLFW_PRESS && hud != NULL)
+        hud->Reset();
+#ifdef BVH_TRACE
+    if (key == GLFW_KEY_T && action == GLFW_PRESS)
+        printf(TRACE_WRITE(TRACE_FILE) ? "trace written to %s\n" : "could not write %s\n", TRACE_FILE);
+#endif
 }
 
 
@@ -52,16 +120,20 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 int main(void)
 {
     GLFWwindow* window;
-    GLuint vertex_buffer, vertex_shader, fragment_shader, program;
-    GLint mvp_location, vpos_location, vcol_location;
+    GLuint vertex_array, mesh_buffer, program;
+    GLuint hud_vertex_array, hud_font, hud_program;
+    GLint mvp_location, hud_screen_location;
 
     glfwSetErrorCallback(error_callback);
 
     if (!glfwInit())
         exit(EXIT_FAILURE);
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    //instanced arrays need 3.3
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
 
     window = glfwCreateWindow(800, 600, "BVH Player", NULL, NULL);
     if (!window)
@@ -74,124 +146,245 @@ int main(void)
 
     glfwMakeContextCurrent(window);
     gladLoadGL(glfwGetProcAddress);
+    StreamBuffer::LoadBufferStorage(glfwGetProcAddress);
     glfwSwapInterval(1);
 
 
     Skeleton skel;
-    AnimRec record;
+    //The frames stream in on a background thread, so drawing starts as soon
+    //as the hierarchy is read, however long the capture is.
     //Hardcoded the bvh file here.  
     //Feel free to add an appropriate GUI file chooser if you like
-    skel.CreateSkeletonFromBVH((char*)"ZooExcited.bvh", &record, false);
+    double openTime = glfwGetTime();
+    StreamingClip clip;
+    if (!clip.Open("ZooExcited.bvh", &skel, false))
+    {
+        std::cerr << "Could not open ZooExcited.bvh" << std::endl;
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
     //The files below can be helpful in debugging.  Just comment out the skeleton update in the main loop
-//    skel.CreateSkeletonFromBVH((char*)"TestBlank.bvh", &record, false);
-//    skel.CreateSkeletonFromBVH((char*)"TestZ45.bvh", &record, false);
-//    skel.CreateSkeletonFromBVH((char*)"TestZ45Y90.bvh", &record, false);
+//    clip.Open("TestBlank.bvh", &skel, false);
+//    clip.Open("TestZ45.bvh", &skel, false);
+//    clip.Open("TestZ45Y90.bvh", &skel, false);
     skel.AddGeometry();
-    double state[500];
-    record.GetFrame(0, state);
-    skel.SetSkelState(state);
-    //This calculates the transformations.  You need to write this.
-    skel.UpdateLinks();
-
-    //This is not an elegant way to code this!
-    int maxEntries = 12 * 100;
-    VERTEX* verts = new VERTEX[maxEntries];
-    int vertCount = 0;
-    skel.CalcVertexLocations(maxEntries, &vertCount, &verts);
-    std::cout << "Total verts: " << vertCount;
 
-    // NOTE: OpenGL error checks have been omitted for brevity
-
-    glGenBuffers(1, &vertex_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-//    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-//    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-    glBufferData(GL_ARRAY_BUFFER, maxEntries * 24, verts, GL_DYNAMIC_DRAW);
-
-    vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_text, NULL);
-    glCompileShader(vertex_shader);
+    //The bones are drawn as instances of one pyramid, so the only per frame
+    //upload is one matrix per bone
+    int numBones = skel.GetNumBones();
+    VERTEX mesh[12];
+    Link::MakeBonePyramid(1.0f, mesh);
+    std::cout << "Total bones: " << numBones;
 
-    fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_text, NULL);
-    glCompileShader(fragment_shader);
+    // NOTE: OpenGL error checks have been omitted for brevity
 
-    program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
+    glGenVertexArrays(1, &vertex_array);
+    glBindVertexArray(vertex_array);
+
+    glGenBuffers(1, &mesh_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(mesh), mesh, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VERTEX), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VERTEX), (void*)(sizeof(float) * 3));
+
+    //With a persistent mapping each of the animation thread's three pose
+    //slots is a region of the stream buffer, so the instance matrices are
+    //written straight into it and drawn from there.  Otherwise every pose is
+    //uploaded with glBufferSubData.
+    StreamBuffer instanceStream;
+    instanceStream.Create(GL_ARRAY_BUFFER, numBones * sizeof(mat4x4), 3);
+    bool directInstances = instanceStream.IsPersistent();
+    std::cout << (directInstances ? ", persistent mapped instances" : ", glBufferSubData instances") << std::endl;
+    for (int c = 0; c < 4; c++)
+    {
+        glEnableVertexAttribArray(2 + c);
+        glVertexAttribDivisor(2 + c, 1);
+    }
 
+    program = make_program(vertex_shader_text, fragment_shader_text);
     mvp_location = glGetUniformLocation(program, "MVP");
-    vpos_location = glGetAttribLocation(program, "vPos");
-    vcol_location = glGetAttribLocation(program, "vCol");
-
-    glEnableVertexAttribArray(vpos_location);
-    glVertexAttribPointer(vpos_location, 3, GL_FLOAT, GL_FALSE,
-        sizeof(verts[0]), (void*)0);
-    glEnableVertexAttribArray(vcol_location);
-    glVertexAttribPointer(vcol_location, 3, GL_FLOAT, GL_FALSE,
-        sizeof(verts[0]), (void*)(sizeof(float) * 3));
-    float startTime = (float)glfwGetTime();
-    float duration = record.GetEndTime();
-    float frameTime = record.GetFrameTime();
 
+    //The overlay is rebuilt every frame straight into its own stream buffer.
+    //Everything it needs is made here, so drawing it allocates nothing.
+    Hud hud;
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = monitor != NULL ? glfwGetVideoMode(monitor) : NULL;
+    if (mode != NULL)
+        hud.SetRefreshRate(mode->refreshRate);
+    glfwSetWindowUserPointer(window, &hud);
+
+    glGenVertexArrays(1, &hud_vertex_array);
+    glBindVertexArray(hud_vertex_array);
+    StreamBuffer hudStream;
+    hudStream.Create(GL_ARRAY_BUFFER, Hud::GetMaxVertices() * sizeof(HudVertex), 3);
+    for (int a = 0; a < 3; a++)
+        glEnableVertexAttribArray(a);
+
+    unsigned char atlas[HUD_ATLAS_WIDTH * HUD_ATLAS_HEIGHT];
+    Hud::MakeFontAtlas(atlas);
+    glGenTextures(1, &hud_font);
+    glBindTexture(GL_TEXTURE_2D, hud_font);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, HUD_ATLAS_WIDTH, HUD_ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, atlas);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    hud_program = make_program(hud_vertex_shader_text, hud_fragment_shader_text);
+    hud_screen_location = glGetUniformLocation(hud_program, "screen");
+    glUseProgram(hud_program);
+    glUniform1i(glGetUniformLocation(hud_program, "font"), 0);
+    std::cout << "H shows and hides the overlay, R resets its counts" << std::endl;
+
+    //the clip is sampled and posed on its own thread, one pose ahead of
+    //the one being drawn
+    AnimationThread animThread;
+    if (directInstances)
+    {
+        mat4x4* regions[3];
+        for (int i = 0; i < 3; i++)
+            regions[i] = (mat4x4*)instanceStream.GetRegion(i);
+        animThread.SetInstanceStorage(regions);
+    }
+    animThread.Start(&skel, &clip);
+    std::cout << "Playing " << (glfwGetTime() - openTime) * 1000.0 << " ms after opening the file" << std::endl;
+
+    //stage timings, printed every couple of seconds
+    double lastFrame = glfwGetTime();
+    double reportTime = lastFrame;
+    double frameMsSum = 0, renderMsSum = 0;
+    int reportFrames = 0;
+    size_t hudBytes = 0;
+    const PoseFrame* pose = NULL;
+
+    TRACE_THREAD_NAME("Render");
     while (!glfwWindowShouldClose(window))
     {
         float ratio;
         int width, height;
         mat4x4 m, p, mvp;
 
-        float curTime = (float)glfwGetTime();
-        float animTime = curTime - startTime;
-        if (animTime > duration)
+        double renderStart = glfwGetTime();
         {
-            startTime = curTime;
-            animTime = 0;
+            TRACE_SCOPE("Acquire");
+            //the last pose's slot only goes back to the animation thread
+            //once the GPU is done drawing from its region; until then it is
+            //drawn again
+            bool release = !directInstances || pose == NULL || instanceStream.IsRegionIdle(pose->slot);
+            pose = animThread.Acquire(release);
+        }
+        size_t instanceOffset;
+        if (directInstances)
+        {
+            instanceOffset = instanceStream.GetRegionOffset(pose->slot);
+        }
+        else
+        {
+            TRACE_SCOPE("Upload");
+            memcpy(instanceStream.Begin(), pose->instances, numBones * sizeof(mat4x4));
+            instanceOffset = instanceStream.End(numBones * sizeof(mat4x4));
+        }
+        {
+            TRACE_SCOPE("Draw");
+            glfwGetFramebufferSize(window, &width, &height);
+            ratio = width / (float)height;
+
+            glViewport(0, 0, width, height);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            mat4x4_identity(m);
+            mat4x4_scale(m, m, 0.9);
+            m[3][3] = 1.0;
+
+
+            //TO DO: replace this with a proper camera model
+            mat4x4_ortho(p, -1., 1., -1.f, 1.f, 1.f, -1.f);
+            mat4x4_mul(mvp, p, m);
+
+            glUseProgram(program);
+            glUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat*)mvp);
+
+            //one draw for the whole skeleton (the root has no bone to draw),
+            //reading this frame's region of the instance stream
+            glBindVertexArray(vertex_array);
+            glBindBuffer(GL_ARRAY_BUFFER, instanceStream.GetBuffer());
+            for (int c = 0; c < 4; c++)
+            {
+                glVertexAttribPointer(2 + c, 4, GL_FLOAT, GL_FALSE, sizeof(mat4x4), (void*)(instanceOffset + sizeof(vec4) * c));
+            }
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 12, numBones);
+            if (directInstances)
+                instanceStream.FenceRegion(pose->slot);
+            else
+                instanceStream.Fence();
+        }
+        hudBytes = 0;
+        if (hud.IsVisible())
+        {
+            TRACE_SCOPE("Hud");
+            HudVertex* hudVerts = (HudVertex*)hudStream.Begin();
+            int hudCount = hud.Build(hudVerts, Hud::GetMaxVertices(), width, height);
+            hudBytes = hudCount * sizeof(HudVertex);
+            size_t hudOffset = hudStream.End(hudBytes);
+
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glUseProgram(hud_program);
+            glUniform2f(hud_screen_location, (float)width, (float)height);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, hud_font);
+            glBindVertexArray(hud_vertex_array);
+            glBindBuffer(GL_ARRAY_BUFFER, hudStream.GetBuffer());
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)(hudOffset + offsetof(HudVertex, x)));
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)(hudOffset + offsetof(HudVertex, u)));
+            glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudVertex), (void*)(hudOffset + offsetof(HudVertex, rgba)));
+            glDrawArrays(GL_TRIANGLES, 0, hudCount);
+            glDisable(GL_BLEND);
+            hudStream.Fence();
         }
-        //std::cout << animTime << std::endl;
-        record.GetFrame(animTime/frameTime, state);
-        skel.SetSkelState(state);
-
-
-        skel.UpdateLinks();
-
-
-        int vertCount = 0;
-        skel.CalcVertexLocations(maxEntries, &vertCount, &verts);
-
-
-
-
-//NOTE: HARDCODE SIZE
-        glBufferData(GL_ARRAY_BUFFER, 24*vertCount, verts, GL_DYNAMIC_DRAW);
-
-        glfwGetFramebufferSize(window, &width, &height);
-        ratio = width / (float)height;
-
-        glViewport(0, 0, width, height);
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        mat4x4_identity(m);
-        mat4x4_scale(m, m, 0.9);
-        m[3][3] = 1.0;
-
-
-        //TO DO: replace this with a proper camera model
-        mat4x4_ortho(p, -1., 1., -1.f, 1.f, 1.f, -1.f);
-        mat4x4_mul(mvp, p, m);
-
-        glUseProgram(program);
-        glUniformMatrix4fv(mvp_location, 1, GL_FALSE, (const GLfloat*)mvp);
 
-//THIS SPECIFIES WHICH VERTICES WILL BE DRAWN
-        //Don't draw the pyramid from the world frame to the root (so start at 12)
-        glDrawArrays(GL_TRIANGLES, 12, vertCount);
+        double now = glfwGetTime();
+        renderMsSum += (now - renderStart) * 1000.0;
+        frameMsSum += (now - lastFrame) * 1000.0;
+        //what the overlay shows next frame
+        HudSample sample;
+        sample.frameMs = (now - lastFrame) * 1000.0;
+        sample.poseSequence = pose->sequence;
+        sample.fkMs = pose->simMs;
+        sample.clipTime = pose->time;
+        sample.numClipFrames = clip.GetNumFrames();
+        sample.clipFrame = sample.numClipFrames > 0 ? (int)(pose->time / clip.GetFrameTime()) % sample.numClipFrames : 0;
+        sample.uploadBytes = numBones * sizeof(mat4x4) + hudBytes;
+        hud.AddFrame(sample);
+        lastFrame = now;
+        reportFrames++;
+        if (now - reportTime >= 2.0)
+        {
+            printf("frame %.2f ms  sim %.3f ms (animation thread)  render %.3f ms  late %d  dropped %d\n",
+                frameMsSum / reportFrames, animThread.GetAverageSimMs(), renderMsSum / reportFrames,
+                hud.GetNumLateFrames(), hud.GetNumDroppedFrames());
+            frameMsSum = renderMsSum = 0;
+            reportFrames = 0;
+            reportTime = now;
+        }
 
-        glfwSwapBuffers(window);
+        {
+            TRACE_SCOPE("SwapBuffers");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
 
-    delete[] verts;
+    animThread.Stop();
+#ifdef BVH_TRACE
+    printf(TRACE_WRITE(TRACE_FILE) ? "trace written to %s\n" : "could not write %s\n", TRACE_FILE);
+#endif
+    instanceStream.Destroy();
+    hudStream.Destroy();
+    glfwSetWindowUserPointer(window, NULL);
     glfwDestroyWindow(window);
 
     glfwTerminate();
@@ -0,0 +1,129 @@
+//SSE version of the batch FK, plus the run time checks for both versions.
+//This file is built with the default flags so it runs on any x86-64 CPU.
+
+#include "BatchFK.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BATCH_FK_SSE 1
+#endif
+
+#ifdef BATCH_FK_SSE
+
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//4 floats, one pose per lane
+struct VecSSE
+{
+	static const int Width = 4;
+	__m128 v;
+
+	VecSSE() {}
+	VecSSE(__m128 x) : v(x) {}
+	static VecSSE Set1(float f) { return _mm_set1_ps(f); }
+
+	//lane l = frames[l][dof]
+	static VecSSE Gather(const float* const* frames, int dof)
+	{
+		return _mm_setr_ps(frames[0][dof], frames[1][dof], frames[2][dof], frames[3][dof]);
+	}
+
+	//writes lane l of a, b, c and d to dst[l][0..3]
+	static void StoreColumns(VecSSE a, VecSSE b, VecSSE c, VecSSE d, float* const* dst)
+	{
+		__m128 r0 = a.v, r1 = b.v, r2 = c.v, r3 = d.v;
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(dst[0], r0);
+		_mm_storeu_ps(dst[1], r1);
+		_mm_storeu_ps(dst[2], r2);
+		_mm_storeu_ps(dst[3], r3);
+	}
+
+	//sine and cosine of every lane.  Cody-Waite reduction to [-pi/4, pi/4]
+	//and the Cephes single precision polynomials, a few ulp for the angle
+	//range a BVH file uses.
+	static void SinCos(VecSSE x, VecSSE& s, VecSSE& c)
+	{
+		__m128i q = _mm_cvtps_epi32(_mm_mul_ps(x.v, _mm_set1_ps(0.63661977236758134f)));
+		__m128 qf = _mm_cvtepi32_ps(q);
+		__m128 y = _mm_sub_ps(x.v, _mm_mul_ps(qf, _mm_set1_ps(1.5703125f)));
+		y = _mm_sub_ps(y, _mm_mul_ps(qf, _mm_set1_ps(4.837512969970703125e-4f)));
+		y = _mm_sub_ps(y, _mm_mul_ps(qf, _mm_set1_ps(7.54978995489188216e-8f)));
+		__m128 z = _mm_mul_ps(y, y);
+
+		__m128 sp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), z), _mm_set1_ps(8.3321608736e-3f));
+		sp = _mm_add_ps(_mm_mul_ps(sp, z), _mm_set1_ps(-1.6666654611e-1f));
+		sp = _mm_add_ps(y, _mm_mul_ps(_mm_mul_ps(y, z), sp));
+
+		__m128 cp = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), z), _mm_set1_ps(-1.388731625493765e-3f));
+		cp = _mm_add_ps(_mm_mul_ps(cp, z), _mm_set1_ps(4.166664568298827e-2f));
+		cp = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_mul_ps(_mm_mul_ps(z, z), cp));
+
+		//odd quadrants swap sine and cosine, the signs follow the quadrant
+		__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+		__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+		__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+		s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, cp), _mm_andnot_ps(swap, sp)), sinSign);
+		c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, sp), _mm_andnot_ps(swap, cp)), cosSign);
+	}
+};
+
+static inline VecSSE operator+(VecSSE a, VecSSE b) { return _mm_add_ps(a.v, b.v); }
+static inline VecSSE operator-(VecSSE a, VecSSE b) { return _mm_sub_ps(a.v, b.v); }
+static inline VecSSE operator*(VecSSE a, VecSSE b) { return _mm_mul_ps(a.v, b.v); }
+
+#include "BatchFKSimd.h"
+
+int BatchFKSSE(const BatchFKJoints& joints, const float* const* frames, int numPoses, mat4x4* out)
+{
+	return BatchFKRun<VecSSE>(joints, frames, numPoses, out);
+}
+
+bool BatchFKHasSSE()
+{
+	return true;
+}
+
+bool BatchFKHasAVX2()
+{
+#ifndef BATCH_FK_AVX2
+	//BatchFKAVX2.cpp was built without AVX2 code
+	return false;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+	{
+		return false;
+	}
+	__cpuid(info, 1);
+	bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+	__cpuidex(info, 7, 0);
+	return osSavesYmm && (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#else
+
+//no SSE on this target, Skeleton::ComputePoses does everything in scalar code
+int BatchFKSSE(const BatchFKJoints&, const float* const*, int, mat4x4*)
+{
+	return 0;
+}
+
+bool BatchFKHasSSE()
+{
+	return false;
+}
+
+bool BatchFKHasAVX2()
+{
+	return false;
+}
+
+#endif
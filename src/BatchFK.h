@@ -0,0 +1,32 @@
+#pragma once
+
+#include "linmath.h"
+
+//SIMD forward kinematics for many poses of one skeleton, used by
+//Skeleton::ComputePoses.  Each SIMD lane is one pose, so every joint is
+//evaluated for 4 (SSE) or 8 (AVX2) poses at once with no shuffling between
+//lanes.  Sines and cosines come from a polynomial, so results agree with the
+//scalar path to a few ulp rather than bit for bit.
+
+//The skeleton's flattened joint arrays (see Skeleton::BuildEvalData)
+struct BatchFKJoints
+{
+	int numJoints;
+	const int* parent;
+	const float* offset;		// 3 per joint
+	const int* axisOrder;		// 3 per joint
+	const int* numRotations;
+	const int* rotDOF;
+	const int* transDOF;
+};
+
+//Both compute the world matrices of as many whole SIMD batches of poses as
+//fit in numPoses and return how many poses they did (a multiple of the
+//width, 0 if the instruction set isn't available).  The caller finishes the
+//rest.  Pose p reads frames[p] and writes out[p * numJoints + joint].
+int BatchFKSSE(const BatchFKJoints& joints, const float* const* frames, int numPoses, mat4x4* out);
+int BatchFKAVX2(const BatchFKJoints& joints, const float* const* frames, int numPoses, mat4x4* out);
+
+//true if this build has the SSE / AVX2 version and the CPU can run it
+bool BatchFKHasSSE();
+bool BatchFKHasAVX2();
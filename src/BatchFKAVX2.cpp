@@ -0,0 +1,94 @@
+//AVX2 version of the batch FK.  CMake builds this file (and only this file)
+//with AVX2 enabled; Skeleton::ComputePoses only calls it after
+//BatchFKHasAVX2 has checked the CPU.
+
+#include "BatchFK.h"
+
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+//8 floats, one pose per lane
+struct VecAVX2
+{
+	static const int Width = 8;
+	__m256 v;
+
+	VecAVX2() {}
+	VecAVX2(__m256 x) : v(x) {}
+	static VecAVX2 Set1(float f) { return _mm256_set1_ps(f); }
+
+	//lane l = frames[l][dof]
+	static VecAVX2 Gather(const float* const* frames, int dof)
+	{
+		return _mm256_setr_ps(frames[0][dof], frames[1][dof], frames[2][dof], frames[3][dof],
+			frames[4][dof], frames[5][dof], frames[6][dof], frames[7][dof]);
+	}
+
+	//writes lane l of a, b, c and d to dst[l][0..3].  The unpacks transpose
+	//lanes 0-3 in the low halves and 4-7 in the high halves.
+	static void StoreColumns(VecAVX2 a, VecAVX2 b, VecAVX2 c, VecAVX2 d, float* const* dst)
+	{
+		__m256 t0 = _mm256_unpacklo_ps(a.v, b.v);
+		__m256 t1 = _mm256_unpackhi_ps(a.v, b.v);
+		__m256 t2 = _mm256_unpacklo_ps(c.v, d.v);
+		__m256 t3 = _mm256_unpackhi_ps(c.v, d.v);
+		__m256 r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+		__m256 r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+		__m256 r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+		_mm_storeu_ps(dst[0], _mm256_castps256_ps128(r0));
+		_mm_storeu_ps(dst[1], _mm256_castps256_ps128(r1));
+		_mm_storeu_ps(dst[2], _mm256_castps256_ps128(r2));
+		_mm_storeu_ps(dst[3], _mm256_castps256_ps128(r3));
+		_mm_storeu_ps(dst[4], _mm256_extractf128_ps(r0, 1));
+		_mm_storeu_ps(dst[5], _mm256_extractf128_ps(r1, 1));
+		_mm_storeu_ps(dst[6], _mm256_extractf128_ps(r2, 1));
+		_mm_storeu_ps(dst[7], _mm256_extractf128_ps(r3, 1));
+	}
+
+	//same reduction and polynomials as VecSSE::SinCos
+	static void SinCos(VecAVX2 x, VecAVX2& s, VecAVX2& c)
+	{
+		__m256i q = _mm256_cvtps_epi32(_mm256_mul_ps(x.v, _mm256_set1_ps(0.63661977236758134f)));
+		__m256 qf = _mm256_cvtepi32_ps(q);
+		__m256 y = _mm256_sub_ps(x.v, _mm256_mul_ps(qf, _mm256_set1_ps(1.5703125f)));
+		y = _mm256_sub_ps(y, _mm256_mul_ps(qf, _mm256_set1_ps(4.837512969970703125e-4f)));
+		y = _mm256_sub_ps(y, _mm256_mul_ps(qf, _mm256_set1_ps(7.54978995489188216e-8f)));
+		__m256 z = _mm256_mul_ps(y, y);
+
+		__m256 sp = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-1.9515295891e-4f), z), _mm256_set1_ps(8.3321608736e-3f));
+		sp = _mm256_add_ps(_mm256_mul_ps(sp, z), _mm256_set1_ps(-1.6666654611e-1f));
+		sp = _mm256_add_ps(y, _mm256_mul_ps(_mm256_mul_ps(y, z), sp));
+
+		__m256 cp = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.443315711809948e-5f), z), _mm256_set1_ps(-1.388731625493765e-3f));
+		cp = _mm256_add_ps(_mm256_mul_ps(cp, z), _mm256_set1_ps(4.166664568298827e-2f));
+		cp = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(_mm256_set1_ps(0.5f), z)), _mm256_mul_ps(_mm256_mul_ps(z, z), cp));
+
+		__m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+		__m256 sinSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(q, _mm256_set1_epi32(2)), 30));
+		__m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(q, _mm256_set1_epi32(1)), _mm256_set1_epi32(2)), 30));
+		s = _mm256_xor_ps(_mm256_blendv_ps(sp, cp, swap), sinSign);
+		c = _mm256_xor_ps(_mm256_blendv_ps(cp, sp, swap), cosSign);
+	}
+};
+
+static inline VecAVX2 operator+(VecAVX2 a, VecAVX2 b) { return _mm256_add_ps(a.v, b.v); }
+static inline VecAVX2 operator-(VecAVX2 a, VecAVX2 b) { return _mm256_sub_ps(a.v, b.v); }
+static inline VecAVX2 operator*(VecAVX2 a, VecAVX2 b) { return _mm256_mul_ps(a.v, b.v); }
+
+#include "BatchFKSimd.h"
+
+int BatchFKAVX2(const BatchFKJoints& joints, const float* const* frames, int numPoses, mat4x4* out)
+{
+	return BatchFKRun<VecAVX2>(joints, frames, numPoses, out);
+}
+
+#else
+
+int BatchFKAVX2(const BatchFKJoints&, const float* const*, int, mat4x4*)
+{
+	return 0;
+}
+
+#endif
@@ -0,0 +1,164 @@
+#pragma once
+
+//Shared body of the SSE and AVX2 batch FK (see BatchFK.h).  Included by the
+//file that defines the vector type, so each instruction set is compiled with
+//its own flags.
+//
+//V is a vector of V::Width floats with +, -, *, Set1, SinCos, Gather (lane l
+//from frames[l][dof]) and StoreColumns (lane l of four vectors to dst[l]).
+
+#include "BatchFK.h"
+#include "EulerKernels.h"
+
+#include <vector>
+
+template<class V>
+struct BatchRot
+{
+	//m = R0 * R1 * R2 from the cosines and sines of the joint's angles
+	typedef void (*Kernel)(V m[3][3], const V* c, const V* s);
+
+	static void Rot0(V m[3][3], const V*, const V*)
+	{
+		V zero = V::Set1(0.0f), one = V::Set1(1.0f);
+		for (int col = 0; col < 3; col++)
+			for (int row = 0; row < 3; row++)
+				m[col][row] = col == row ? one : zero;
+	}
+	template<int A0>
+	static void Rot1(V m[3][3], const V* c, const V* s)
+	{
+		EulerSetAxis<A0>(m, c[0], s[0], V::Set1(0.0f), V::Set1(1.0f));
+	}
+	template<int A0, int A1>
+	static void Rot2(V m[3][3], const V* c, const V* s)
+	{
+		EulerSetAxis<A0>(m, c[0], s[0], V::Set1(0.0f), V::Set1(1.0f));
+		EulerApplyAxis<A1>(m, c[1], s[1]);
+	}
+	template<int A0, int A1, int A2>
+	static void Rot3(V m[3][3], const V* c, const V* s)
+	{
+		EulerSetAxis<A0>(m, c[0], s[0], V::Set1(0.0f), V::Set1(1.0f));
+		EulerApplyAxis<A1>(m, c[1], s[1]);
+		EulerApplyAxis<A2>(m, c[2], s[2]);
+	}
+
+	template<int A0, int A1>
+	static Kernel Get3(int a2)
+	{
+		return a2 == 0 ? Rot3<A0, A1, 0> : a2 == 1 ? Rot3<A0, A1, 1> : Rot3<A0, A1, 2>;
+	}
+	template<int A0>
+	static Kernel Get3(int a1, int a2)
+	{
+		return a1 == 0 ? Get3<A0, 0>(a2) : a1 == 1 ? Get3<A0, 1>(a2) : Get3<A0, 2>(a2);
+	}
+	template<int A0>
+	static Kernel Get2(int a1)
+	{
+		return a1 == 0 ? Rot2<A0, 0> : a1 == 1 ? Rot2<A0, 1> : Rot2<A0, 2>;
+	}
+
+	static Kernel Get(int numRotations, const int* axes)
+	{
+		switch (numRotations)
+		{
+		case 0:
+			return Rot0;
+		case 1:
+			return axes[0] == 0 ? Rot1<0> : axes[0] == 1 ? Rot1<1> : Rot1<2>;
+		case 2:
+			return axes[0] == 0 ? Get2<0>(axes[1]) : axes[0] == 1 ? Get2<1>(axes[1]) : Get2<2>(axes[1]);
+		default:
+			return axes[0] == 0 ? Get3<0>(axes[1], axes[2]) : axes[0] == 1 ? Get3<1>(axes[1], axes[2]) : Get3<2>(axes[1], axes[2]);
+		}
+	}
+};
+
+//Writes the 3x4 part of a world matrix for every lane into its own mat4x4,
+//a column of four floats at a time
+template<class V>
+static inline void BatchScatter(const V w[4][3], mat4x4* out, int numJoints)
+{
+	float* columns[V::Width];
+	for (int col = 0; col < 4; col++)
+	{
+		for (int l = 0; l < V::Width; l++)
+		{
+			columns[l] = out[l * numJoints][col];
+		}
+		V::StoreColumns(w[col][0], w[col][1], w[col][2], V::Set1(col == 3 ? 1.0f : 0.0f), columns);
+	}
+}
+
+template<class V>
+int BatchFKRun(const BatchFKJoints& joints, const float* const* frames, int numPoses, mat4x4* out)
+{
+	const int W = V::Width;
+	const int numJoints = joints.numJoints;
+	if (numJoints == 0 || numPoses < W)
+	{
+		return 0;
+	}
+
+	//Scratch kept per thread, so a call only allocates when a thread first
+	//meets a bigger rig.  Crowds call this every frame from several threads.
+	static thread_local std::vector<typename BatchRot<V>::Kernel> kernels;
+	//world matrices of the current batch, 3x4 per joint, one lane per pose
+	static thread_local std::vector<V> world;
+	if ((int)kernels.size() < numJoints)
+	{
+		kernels.resize(numJoints);
+		world.resize(numJoints * 12);
+	}
+
+	//rotation kernel of every joint, resolved once per call
+	for (int i = 0; i < numJoints; i++)
+	{
+		kernels[i] = BatchRot<V>::Get(joints.numRotations[i], &joints.axisOrder[i * 3]);
+	}
+
+	int done = 0;
+	for (; done + W <= numPoses; done += W)
+	{
+		const float* const* f = frames + done;
+
+		//the root is only translated, as in Link::UpdateAndRecurse
+		V (*root)[3] = (V(*)[3])&world[0];
+		for (int col = 0; col < 3; col++)
+			for (int row = 0; row < 3; row++)
+				root[col][row] = V::Set1(col == row ? 1.0f : 0.0f);
+		for (int row = 0; row < 3; row++)
+		{
+			root[3][row] = joints.transDOF[0] >= 0 ? V::Gather(f, joints.transDOF[0] + row)
+				: V::Set1(joints.offset[row]);
+		}
+		BatchScatter<V>(root, out + done * numJoints, numJoints);
+
+		for (int i = 1; i < numJoints; i++)
+		{
+			V c[3], s[3];
+			for (int r = 0; r < joints.numRotations[i]; r++)
+			{
+				V::SinCos(V::Gather(f, joints.rotDOF[i] + r), s[r], c[r]);
+			}
+			V rot[3][3];
+			kernels[i](rot, c, s);
+
+			//world = parent * [rot | offset]
+			const V (*p)[3] = (const V(*)[3])&world[joints.parent[i] * 12];
+			V (*w)[3] = (V(*)[3])&world[i * 12];
+			for (int col = 0; col < 3; col++)
+				for (int row = 0; row < 3; row++)
+					w[col][row] = p[0][row] * rot[col][0] + p[1][row] * rot[col][1] + p[2][row] * rot[col][2];
+			const float* o = &joints.offset[i * 3];
+			V ox = V::Set1(o[0]), oy = V::Set1(o[1]), oz = V::Set1(o[2]);
+			for (int row = 0; row < 3; row++)
+				w[3][row] = p[0][row] * ox + p[1][row] * oy + p[2][row] * oz + p[3][row];
+
+			BatchScatter<V>(w, out + done * numJoints + i, numJoints);
+		}
+	}
+	return done;
+}
@@ -0,0 +1,455 @@
+#include "CompressedClip.h"
+#include "Skeleton.h"
+#include "Link.h"
+#include "AnimRec.h"
+#include "QuatClip.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+
+//longest run of frames between two keys, which bounds the work of trying
+//to drop one more key
+#define COMPRESS_MAX_KEY_GAP 256
+//times the error allowance is doubled or halved to bring the measured
+//error up to the bound
+#define COMPRESS_MAX_RETRIES 5
+
+//frames per entry of the key index
+#define KEY_INDEX_SHIFT 5
+#define KEY_INDEX_BLOCK (1 << KEY_INDEX_SHIFT)
+
+//smallest-three components lie in [-1/sqrt(2), 1/sqrt(2)]
+#define QUAT_RANGE 0.70710678f
+#define QUAT_STEPS 32767.0f
+
+CompressedClip::CompressedClip()
+{
+	m_numFrames = 0;
+	m_poseSize = 0;
+	m_frameTime = 0;
+	m_maxError = 0;
+	for (int a = 0; a < 3; a++)
+	{
+		m_transMin[a] = 0;
+		m_transScale[a] = 0;
+	}
+}
+
+void CompressedClip::EncodeQuat(const float* q, uint16_t* out)
+{
+	int largest = 0;
+	for (int i = 1; i < 4; i++)
+	{
+		if (fabsf(q[i]) > fabsf(q[largest])) largest = i;
+	}
+	//q and -q are the same rotation, so the dropped component is positive
+	float sign = q[largest] < 0 ? -1.0f : 1.0f;
+	int k = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (i == largest) continue;
+		float v = (q[i] * sign + QUAT_RANGE) / (2.0f * QUAT_RANGE) * QUAT_STEPS + 0.5f;
+		out[k++] = (uint16_t)(v < 0 ? 0 : v > QUAT_STEPS ? QUAT_STEPS : v);
+	}
+	out[0] |= (uint16_t)((largest & 1) << 15);
+	out[1] |= (uint16_t)((largest >> 1) << 15);
+}
+
+//components kept by smallest-three, for each index of the dropped one
+static const int s_keptComponents[4][3] = { { 1, 2, 3 }, { 0, 2, 3 }, { 0, 1, 3 }, { 0, 1, 2 } };
+
+void CompressedClip::DecodeQuat(const uint16_t* in, float* q)
+{
+	int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+	const int * kept = s_keptComponents[largest];
+	float sum = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		float v = (in[k] & 0x7fff) * (2.0f * QUAT_RANGE / QUAT_STEPS) - QUAT_RANGE;
+		q[kept[k]] = v;
+		sum += v * v;
+	}
+	q[largest] = sqrtf(sum < 1.0f ? 1.0f - sum : 0.0f);
+}
+
+void CompressedClip::EncodeTranslation(const float* t, uint16_t* out)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		float v = m_transScale[a] > 0 ? (t[a] - m_transMin[a]) / m_transScale[a] + 0.5f : 0.0f;
+		out[a] = (uint16_t)(v < 0 ? 0 : v > 65535.0f ? 65535.0f : v);
+	}
+}
+
+void CompressedClip::DecodeTranslation(const uint16_t* in, float* t)
+{
+	for (int a = 0; a < 3; a++)
+	{
+		t[a] = m_transMin[a] + in[a] * m_transScale[a];
+	}
+}
+
+//distance between the values of a track, 4 floats each.  For rotations the
+//chord between the quaternions, taking the nearer of q and -q.
+static float TrackDistance(bool rotation, const float* a, const float* b)
+{
+	float minus = 0, plus = 0;
+	for (int k = 0; k < 4; k++)
+	{
+		minus += (a[k] - b[k]) * (a[k] - b[k]);
+		plus += (a[k] + b[k]) * (a[k] + b[k]);
+	}
+	return sqrtf(rotation && plus < minus ? plus : minus);
+}
+
+//blend of two track values, normalized for rotations
+static void TrackBlend(bool rotation, const float* a, const float* b, float w, float* out)
+{
+	if (!rotation)
+	{
+		for (int k = 0; k < 4; k++) out[k] = a[k] + w * (b[k] - a[k]);
+		return;
+	}
+	float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+	float wb = dot < 0 ? -w : w;
+	float len = 0;
+	for (int k = 0; k < 4; k++)
+	{
+		out[k] = (1.0f - w) * a[k] + wb * b[k];
+		len += out[k] * out[k];
+	}
+	len = 1.0f / sqrtf(len);
+	for (int k = 0; k < 4; k++) out[k] *= len;
+}
+
+void CompressedClip::BuildTrack(int link, const std::vector<float>& values, float tolerance,
+	std::vector<uint16_t>& keyFrames, std::vector<uint16_t>& keyData)
+{
+	bool rotation = link >= 0;
+	int n = m_numFrames;
+
+	//every frame as it comes back out of the quantization
+	std::vector<uint16_t> codes((size_t)n * 3);
+	std::vector<float> decoded((size_t)n * 4, 0.0f);
+	for (int f = 0; f < n; f++)
+	{
+		if (rotation)
+		{
+			EncodeQuat(&values[f * 4], &codes[f * 3]);
+			DecodeQuat(&codes[f * 3], &decoded[f * 4]);
+		}
+		else
+		{
+			EncodeTranslation(&values[f * 4], &codes[f * 3]);
+			DecodeTranslation(&codes[f * 3], &decoded[f * 4]);
+		}
+	}
+
+	//greedy: from each key, reach as far as the blend stays within tolerance
+	int a = 0;
+	keyFrames.push_back(0);
+	keyData.insert(keyData.end(), &codes[0], &codes[3]);
+	while (a < n - 1)
+	{
+		int b = a + 1;
+		while (b + 1 < n && b + 1 - a <= COMPRESS_MAX_KEY_GAP)
+		{
+			int next = b + 1;
+			bool fits = true;
+			float blend[4];
+			for (int f = a + 1; f < next && fits; f++)
+			{
+				TrackBlend(rotation, &decoded[a * 4], &decoded[next * 4], (float)(f - a) / (next - a), blend);
+				fits = TrackDistance(rotation, blend, &values[f * 4]) <= tolerance;
+			}
+			if (!fits) break;
+			b = next;
+		}
+		keyFrames.push_back((uint16_t)b);
+		keyData.insert(keyData.end(), &codes[b * 3], &codes[b * 3 + 3]);
+		a = b;
+	}
+}
+
+void CompressedClip::Compress(Skeleton* skel, AnimRec* rec, float maxError, float scale)
+{
+	int numLinks = skel->GetNumLinks();
+	QuatClip quats;
+	quats.Build(skel, rec);
+
+	//how far each link's rotation can move the joints below it, as the
+	//longest chain of offsets hanging off it
+	std::vector<float> reach(numLinks, 0.0f);
+	for (int i = numLinks - 1; i > 0; i--)
+	{
+		double v[3];
+		skel->GetLink(i)->GetParTranslation(v);
+		float length = (float)sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]) + reach[i];
+		int parent = skel->GetJointParent(i);
+		reach[parent] = std::max(reach[parent], length);
+	}
+
+	//the root's rotation doesn't move anything (see Skeleton::ComputePose),
+	//so only the other rotating links get a track
+	m_tracks.clear();
+	Track root = { -1, 0, 0, 0 };
+	m_tracks.push_back(root);
+	std::vector<int> tracked(numLinks, 0);
+	for (int i = 1; i < numLinks; i++)
+	{
+		if (skel->GetLink(i)->GetNumRotations() > 0)
+		{
+			Track track = { i, 0, 0, 0 };
+			m_tracks.push_back(track);
+			tracked[i] = 1;
+		}
+	}
+
+	//a joint moves with the root translation and the rotation of every
+	//tracked link above it, so the bound is split evenly over the longest
+	//such chain
+	std::vector<int> contributors(numLinks, 1);
+	int maxContributors = 1;
+	for (int i = 1; i < numLinks; i++)
+	{
+		int parent = skel->GetJointParent(i);
+		contributors[i] = contributors[parent] + tracked[parent];
+		maxContributors = std::max(maxContributors, contributors[i]);
+	}
+	float share = maxError * scale / maxContributors;
+
+	//the translation range
+	for (int a = 0; a < 3; a++)
+	{
+		float lo = quats.GetFrameData(0)[a], hi = lo;
+		for (int f = 1; f < m_numFrames; f++)
+		{
+			lo = std::min(lo, quats.GetFrameData(f)[a]);
+			hi = std::max(hi, quats.GetFrameData(f)[a]);
+		}
+		m_transMin[a] = lo;
+		m_transScale[a] = (hi - lo) / 65535.0f;
+	}
+
+	//tracks are independent, so they are built in parallel
+	int numTracks = (int)m_tracks.size();
+	std::vector<std::vector<uint16_t> > frames(numTracks), data(numTracks);
+	ThreadPool::Shared().Run(numTracks, [&](int t)
+	{
+		int link = m_tracks[t].link;
+		int offset = link < 0 ? 0 : 4 + link * 4;
+		std::vector<float> values((size_t)m_numFrames * 4, 0.0f);
+		for (int f = 0; f < m_numFrames; f++)
+		{
+			memcpy(&values[f * 4], quats.GetFrameData(f) + offset, sizeof(float) * (link < 0 ? 3 : 4));
+		}
+		//a rotation error of chord c moves a point at distance r by at most 2 r c
+		float tolerance = link < 0 ? share : reach[link] > 0 ? share / (2.0f * reach[link]) : 4.0f;
+		BuildTrack(link, values, tolerance, frames[t], data[t]);
+	});
+
+	m_keyFrames.clear();
+	m_keyData.clear();
+	m_keyIndex.clear();
+	int numBlocks = (m_numFrames + KEY_INDEX_BLOCK - 1) >> KEY_INDEX_SHIFT;
+	for (int t = 0; t < numTracks; t++)
+	{
+		m_tracks[t].firstKey = (uint32_t)m_keyFrames.size();
+		m_tracks[t].numKeys = (uint32_t)frames[t].size();
+		m_tracks[t].firstIndex = (uint32_t)m_keyIndex.size();
+		m_keyFrames.insert(m_keyFrames.end(), frames[t].begin(), frames[t].end());
+		m_keyData.insert(m_keyData.end(), data[t].begin(), data[t].end());
+
+		int key = 0;
+		for (int b = 0; b < numBlocks; b++)
+		{
+			while (key + 1 < (int)frames[t].size() && frames[t][key + 1] <= (b << KEY_INDEX_SHIFT))
+			{
+				key++;
+			}
+			m_keyIndex.push_back((uint16_t)key);
+		}
+	}
+	m_keyFrames.shrink_to_fit();
+	m_keyData.shrink_to_fit();
+	m_keyIndex.shrink_to_fit();
+}
+
+bool CompressedClip::Build(Skeleton* skel, AnimRec* rec, float maxError)
+{
+	m_numFrames = rec->GetNumFrames();
+	m_frameTime = rec->GetFrameTime();
+	m_poseSize = skel->GetQuatPoseSize();
+	m_tracks.clear();
+	m_keyFrames.clear();
+	m_keyData.clear();
+	m_keyIndex.clear();
+	m_maxError = 0;
+	if (m_numFrames == 0 || m_numFrames > 65535 || skel->GetNumLinks() == 0)
+	{
+		m_numFrames = 0;
+		return false;
+	}
+
+	//The even split of the bound is a first order estimate and usually
+	//leaves room, so widen the allowance while the measured error stays
+	//under the bound, or tighten it until it does.
+	float scale = 1.0f;
+	Compress(skel, rec, maxError, scale);
+	m_maxError = MeasureError(skel, rec);
+	bool widen = m_maxError <= maxError;
+	for (int attempt = 0; attempt < COMPRESS_MAX_RETRIES; attempt++)
+	{
+		if (widen)
+		{
+			CompressedClip wider;
+			wider.m_numFrames = m_numFrames;
+			wider.m_frameTime = m_frameTime;
+			wider.m_poseSize = m_poseSize;
+			wider.Compress(skel, rec, maxError, scale * 2.0f);
+			wider.m_maxError = wider.MeasureError(skel, rec);
+			if (wider.m_maxError > maxError || wider.GetNumKeys() >= GetNumKeys())
+			{
+				break;
+			}
+			*this = std::move(wider);
+			scale *= 2.0f;
+		}
+		else
+		{
+			scale *= 0.5f;
+			Compress(skel, rec, maxError, scale);
+			m_maxError = MeasureError(skel, rec);
+			if (m_maxError <= maxError)
+			{
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+void CompressedClip::SampleTrack(const Track& track, double pos, float* out)
+{
+	const uint16_t * frames = &m_keyFrames[track.firstKey];
+	const uint16_t * data = &m_keyData[(size_t)track.firstKey * 3];
+	bool rotation = track.link >= 0;
+	int numKeys = (int)track.numKeys;
+
+	//the last key at or before pos: from the key the index gives for pos's
+	//block, at most a block's worth of keys further on
+	int frame = (int)pos;
+	int i = m_keyIndex[track.firstIndex + (frame >> KEY_INDEX_SHIFT)];
+	while (i + 1 < numKeys && frames[i + 1] <= frame)
+	{
+		i++;
+	}
+	//keep one key after it, unless there is only one
+	i = i > numKeys - 2 ? numKeys - 2 : i;
+	i = i < 0 ? 0 : i;
+	int j = numKeys < 2 ? i : i + 1;
+
+	float a[4] = { 0, 0, 0, 0 }, b[4] = { 0, 0, 0, 0 };
+	if (rotation)
+	{
+		DecodeQuat(&data[i * 3], a);
+		DecodeQuat(&data[j * 3], b);
+	}
+	else
+	{
+		DecodeTranslation(&data[i * 3], a);
+		DecodeTranslation(&data[j * 3], b);
+	}
+	double span = frames[j] - frames[i];
+	double w = span > 0 ? (pos - frames[i]) / span : 0.0;
+	w = w < 0 ? 0 : w > 1 ? 1 : w;
+	TrackBlend(rotation, a, b, (float)w, out);
+}
+
+void CompressedClip::Sample(double time, float* pose)
+{
+	if (m_numFrames == 0)
+	{
+		return;
+	}
+	double pos = m_frameTime > 0 ? time / m_frameTime : 0;
+	double last = m_numFrames - 1;
+	pos = pos < 0 ? 0 : pos > last ? last : pos;
+
+	//links without a track stay unrotated
+	for (int q = 4; q < m_poseSize; q += 4)
+	{
+		pose[q] = pose[q + 1] = pose[q + 2] = 0.0f;
+		pose[q + 3] = 1.0f;
+	}
+	for (size_t t = 0; t < m_tracks.size(); t++)
+	{
+		const Track& track = m_tracks[t];
+		SampleTrack(track, pos, track.link < 0 ? pose : pose + 4 + track.link * 4);
+	}
+	pose[3] = 0.0f;
+}
+
+double CompressedClip::MeasureError(Skeleton* skel, AnimRec* rec)
+{
+	int numLinks = skel->GetNumLinks();
+	std::vector<float> original((size_t)numLinks * 3);
+	std::vector<float> pose(m_poseSize);
+	double maxError = 0;
+	for (int f = 0; f < m_numFrames && f < rec->GetNumFrames(); f++)
+	{
+		skel->ComputePose(rec->GetFrameData(f));
+		const mat4x4 * world = skel->GetWorldMatrices();
+		for (int j = 0; j < numLinks; j++)
+		{
+			memcpy(&original[j * 3], world[j][3], sizeof(float) * 3);
+		}
+		Sample(f * (double)m_frameTime, pose.data());
+		skel->ComputePoseQuat(pose.data());
+		for (int j = 0; j < numLinks; j++)
+		{
+			double d[3];
+			for (int a = 0; a < 3; a++) d[a] = world[j][3][a] - original[j * 3 + a];
+			maxError = std::max(maxError, sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+		}
+	}
+	return maxError;
+}
+
+int CompressedClip::GetNumFrames()
+{
+	return m_numFrames;
+}
+
+float CompressedClip::GetFrameTime()
+{
+	return m_frameTime;
+}
+
+int CompressedClip::GetPoseSize()
+{
+	return m_poseSize;
+}
+
+int CompressedClip::GetNumKeys()
+{
+	return (int)m_keyFrames.size();
+}
+
+int CompressedClip::GetNumTracks()
+{
+	return (int)m_tracks.size();
+}
+
+double CompressedClip::GetMaxError()
+{
+	return m_maxError;
+}
+
+size_t CompressedClip::GetMemoryUsage()
+{
+	return sizeof(*this) + m_tracks.capacity() * sizeof(Track)
+		+ (m_keyFrames.capacity() + m_keyData.capacity() + m_keyIndex.capacity()) * sizeof(uint16_t);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class Skeleton;
+class AnimRec;
+
+//A clip compressed for keeping many of them in memory.
+//
+//Every rotating joint's rotation is a track of 48 bit smallest-three
+//quaternions (the index of the largest component in 2 bits, the other three
+//in 15 bits each), and the root translation is a track of 16 bit values
+//spread over the clip's own range.  Each track only keeps the frames it
+//needs: keys are dropped wherever blending the keys either side still puts
+//every joint within the error bound of where the original puts it in world
+//space.  The bound is split between the tracks by how far each one can move
+//the joints below it, then checked through the skeleton over the whole clip.
+//
+//Sampling looks up the two keys around the time in each track through a
+//small index of the key at the start of every few frames, so any time can
+//be sampled directly.  The result is a quaternion pose for
+//Skeleton::ComputePoseQuat.
+class CompressedClip
+{
+public:
+	CompressedClip();
+
+	//Compresses rec, which belongs to skel, so no joint is more than maxError
+	//(in the clip's units) away from its original world position.  A bound
+	//finer than the quantization can hold is missed by as little as it can
+	//be; GetMaxError tells what was reached.  Returns false if rec has no
+	//frames or more than 65535 of them.
+	bool Build(Skeleton* skel, AnimRec* rec, float maxError);
+
+	int GetNumFrames();
+	float GetFrameTime();
+	//floats in one pose, same as the skeleton's GetQuatPoseSize
+	int GetPoseSize();
+	//keys kept over all tracks
+	int GetNumKeys();
+	int GetNumTracks();
+
+	//Writes the pose at time seconds (clamped to the clip) into pose,
+	//GetPoseSize() floats
+	void Sample(double time, float* pose);
+
+	//largest distance of any joint from its position in rec over all frames
+	double MeasureError(Skeleton* skel, AnimRec* rec);
+	//MeasureError as found by Build
+	double GetMaxError();
+
+	size_t GetMemoryUsage();
+
+private:
+	struct Track
+	{
+		//link the track rotates, -1 for the root translation
+		int link;
+		uint32_t firstKey;
+		uint32_t numKeys;
+		//start of the track's entries in m_keyIndex
+		uint32_t firstIndex;
+	};
+
+	//picks the keys of one track and appends them to keyFrames / keyData
+	void BuildTrack(int link, const std::vector<float>& values, float tolerance,
+		std::vector<uint16_t>& keyFrames, std::vector<uint16_t>& keyData);
+	//value of a track at frame position pos
+	void SampleTrack(const Track& track, double pos, float* out);
+	//compresses with every track's error allowance scaled by scale
+	void Compress(Skeleton* skel, AnimRec* rec, float maxError, float scale);
+
+	void EncodeQuat(const float* q, uint16_t* out);
+	static void DecodeQuat(const uint16_t* in, float* q);
+	void EncodeTranslation(const float* t, uint16_t* out);
+	void DecodeTranslation(const uint16_t* in, float* t);
+
+	std::vector<Track> m_tracks;
+	//frame of every key, each track's keys in order
+	std::vector<uint16_t> m_keyFrames;
+	//3 values per key, same order
+	std::vector<uint16_t> m_keyData;
+	//per track, for every block of KEY_INDEX_BLOCK frames the track's last
+	//key at or before the block's first frame
+	std::vector<uint16_t> m_keyIndex;
+
+	//translation range, value = min + q * scale
+	float m_transMin[3];
+	float m_transScale[3];
+
+	int m_numFrames;
+	int m_poseSize;
+	float m_frameTime;
+	double m_maxError;
+};
@@ -0,0 +1,189 @@
+#include "Crowd.h"
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "ThreadPool.h"
+#include "AlignedAlloc.h"
+#include "Trace.h"
+
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+
+//instances per Evaluate task, a multiple of the widest SIMD batch so every
+//block but the last runs full batches
+#define CROWD_BLOCK_INSTANCES 64
+
+Crowd::Crowd()
+{
+	m_skel = NULL;
+	m_rec = NULL;
+	m_numInstances = 0;
+	m_numLinks = 0;
+	m_numBones = 0;
+	m_sampled = NULL;
+	m_frameStride = 0;
+}
+
+Crowd::~Crowd()
+{
+	Destroy();
+}
+
+void Crowd::Create(Skeleton* skel, AnimRec* rec, int numInstances)
+{
+	Destroy();
+	m_skel = skel;
+	m_rec = rec;
+	m_numInstances = numInstances > 0 ? numInstances : 1;
+	m_numLinks = skel->GetNumLinks();
+	m_numBones = skel->GetNumBones();
+
+	//built here, so the shared rig and clip are only read from now on
+	skel->PrepareForSharing();
+	rec->BuildSampleView();
+
+	m_timeOffsets.assign(m_numInstances, 0.0);
+	m_positions.assign((size_t)m_numInstances * 3, 0.0f);
+	m_frameStride = rec->GetFrameStride();
+	m_sampled = (float*)AlignedAlloc(sizeof(float) * m_frameStride * m_numInstances, CACHE_LINE_SIZE);
+	memset(m_sampled, 0, sizeof(float) * m_frameStride * m_numInstances);
+	m_frames.resize(m_numInstances);
+	for (int i = 0; i < m_numInstances; i++)
+	{
+		m_frames[i] = m_sampled + (size_t)i * m_frameStride;
+	}
+	SpreadTimeOffsets();
+}
+
+void Crowd::Destroy()
+{
+	AlignedFree(m_sampled);
+	m_sampled = NULL;
+	m_frames.clear();
+	m_timeOffsets.clear();
+	m_positions.clear();
+	m_numInstances = 0;
+	m_skel = NULL;
+	m_rec = NULL;
+}
+
+int Crowd::GetNumInstances()
+{
+	return m_numInstances;
+}
+
+Skeleton* Crowd::GetSkeleton()
+{
+	return m_skel;
+}
+
+AnimRec* Crowd::GetClip()
+{
+	return m_rec;
+}
+
+double Crowd::GetDuration()
+{
+	return m_rec ? m_rec->GetEndTime() : 0;
+}
+
+void Crowd::SetTimeOffset(int instance, double seconds)
+{
+	assert(instance >= 0 && instance < m_numInstances);
+	m_timeOffsets[instance] = seconds;
+}
+
+double Crowd::GetTimeOffset(int instance)
+{
+	assert(instance >= 0 && instance < m_numInstances);
+	return m_timeOffsets[instance];
+}
+
+void Crowd::SpreadTimeOffsets()
+{
+	double duration = GetDuration();
+	for (int i = 0; i < m_numInstances; i++)
+	{
+		m_timeOffsets[i] = duration * i / m_numInstances;
+	}
+}
+
+void Crowd::SetPosition(int instance, float x, float y, float z)
+{
+	assert(instance >= 0 && instance < m_numInstances);
+	m_positions[instance * 3 + 0] = x;
+	m_positions[instance * 3 + 1] = y;
+	m_positions[instance * 3 + 2] = z;
+}
+
+size_t Crowd::GetBytesPerInstance()
+{
+	return sizeof(double) + 3 * sizeof(float) + sizeof(float) * m_frameStride + sizeof(const float*)
+		+ sizeof(mat4x4) * (m_numLinks + m_numBones);
+}
+
+void Crowd::EvaluateBlock(double time, int first, int count, mat4x4* world, mat4x4* instances)
+{
+	double duration = GetDuration();
+	for (int i = first; i < first + count; i++)
+	{
+		double t = duration > 0 ? fmod(time + m_timeOffsets[i], duration) : 0;
+		m_rec->Sample(t < 0 ? t + duration : t, m_sampled + (size_t)i * m_frameStride);
+	}
+
+	mat4x4* blockWorld = world + (size_t)first * m_numLinks;
+	m_skel->ComputePoses(m_frames.data() + first, count, blockWorld);
+
+	//a translation only moves the last column, which the bone matrices are
+	//then computed from
+	for (int i = first; i < first + count; i++)
+	{
+		const float* p = &m_positions[i * 3];
+		if (p[0] != 0 || p[1] != 0 || p[2] != 0)
+		{
+			mat4x4* w = world + (size_t)i * m_numLinks;
+			for (int l = 0; l < m_numLinks; l++)
+			{
+				w[l][3][0] += p[0];
+				w[l][3][1] += p[1];
+				w[l][3][2] += p[2];
+			}
+		}
+		if (instances != NULL)
+		{
+			m_skel->CalcBoneInstances(world + (size_t)i * m_numLinks, instances + (size_t)i * m_numBones);
+		}
+	}
+}
+
+void Crowd::Evaluate(double time, mat4x4* world, mat4x4* instances, ThreadPool* pool)
+{
+	TRACE_SCOPE("EvaluateCrowd");
+	if (m_numInstances == 0)
+	{
+		return;
+	}
+	if (pool == NULL || pool->GetNumThreads() < 2 || m_numInstances <= CROWD_BLOCK_INSTANCES)
+	{
+		EvaluateBlock(time, 0, m_numInstances, world, instances);
+		return;
+	}
+	//the task captures a single pointer so std::function keeps it inline
+	//instead of allocating
+	struct Args
+	{
+		Crowd* crowd;
+		double time;
+		mat4x4* world;
+		mat4x4* instances;
+	} args = { this, time, world, instances };
+	const Args* a = &args;
+	int numBlocks = (m_numInstances + CROWD_BLOCK_INSTANCES - 1) / CROWD_BLOCK_INSTANCES;
+	pool->Run(numBlocks, [a](int block)
+	{
+		int first = block * CROWD_BLOCK_INSTANCES;
+		int left = a->crowd->m_numInstances - first;
+		a->crowd->EvaluateBlock(a->time, first, left < CROWD_BLOCK_INSTANCES ? left : CROWD_BLOCK_INSTANCES, a->world, a->instances);
+	});
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "linmath.h"
+#include <vector>
+#include <stddef.h>
+
+class Skeleton;
+class AnimRec;
+class ThreadPool;
+
+//Many instances of one character playing one clip.
+//
+//The skeleton is the rig definition (hierarchy, offsets, axis orders, bone
+//geometry) and the clip the motion.  Every instance shares both and only
+//reads them, through Skeleton::ComputePoses and AnimRec::Sample.  What an
+//instance owns is its time offset into the clip, its position and the frame
+//sampled for it; its world and bone matrices are written wherever the
+//caller wants them, e.g. the pose slots of AnimationThread.  So an instance
+//costs GetBytesPerInstance() however many links the rig has, instead of a
+//Skeleton of its own.
+class Crowd
+{
+public:
+	Crowd();
+	~Crowd();
+
+	//numInstances instances of skel playing rec, spread over the clip (see
+	//SpreadTimeOffsets) and all at the origin.  skel and rec must not be
+	//changed while the crowd uses them.
+	void Create(Skeleton* skel, AnimRec* rec, int numInstances);
+	void Destroy();
+
+	int GetNumInstances();
+	Skeleton* GetSkeleton();
+	AnimRec* GetClip();
+	//length of the clip, the period every instance loops with
+	double GetDuration();
+
+	//seconds instance plays ahead of the crowd's time
+	void SetTimeOffset(int instance, double seconds);
+	double GetTimeOffset(int instance);
+	//instance i starts i / GetNumInstances() of the way into the clip
+	void SpreadTimeOffsets();
+
+	//world space translation added to every matrix of instance
+	void SetPosition(int instance, float x, float y, float z);
+
+	//Samples every instance at time plus its offset, looping over the clip,
+	//and computes its GetNumLinks() world matrices into
+	//world + i * GetNumLinks().  If instances isn't NULL its GetNumBones()
+	//bone instance matrices go to instances + i * GetNumBones(), as in
+	//Skeleton::CalcBoneInstances.  With a pool the instances are split into
+	//blocks for its threads; without one everything runs on the caller.
+	//Allocates nothing in either case.
+	void Evaluate(double time, mat4x4* world, mat4x4* instances, ThreadPool* pool = NULL);
+
+	//what one instance costs: its offset, position and sampled frame here,
+	//plus the world and bone matrices Evaluate writes for it
+	size_t GetBytesPerInstance();
+
+private:
+	Crowd(const Crowd&);
+	Crowd& operator=(const Crowd&);
+
+	//samples, poses and places instances [first, first + count)
+	void EvaluateBlock(double time, int first, int count, mat4x4* world, mat4x4* instances);
+
+	Skeleton* m_skel;
+	AnimRec* m_rec;
+	int m_numInstances;
+	int m_numLinks;
+	int m_numBones;
+
+	//per instance
+	std::vector<double> m_timeOffsets;
+	//x y z per instance
+	std::vector<float> m_positions;
+	//one sampled frame per instance, m_frameStride floats apart, and a
+	//pointer to each for ComputePoses
+	float* m_sampled;
+	int m_frameStride;
+	std::vector<const float*> m_frames;
+};
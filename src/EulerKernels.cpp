@@ -0,0 +1,79 @@
+#include "EulerKernels.h"
+
+#include <math.h>
+#include <assert.h>
+
+static inline void StoreRotation(float m[3][3], mat4x4 rot)
+{
+	for (int c = 0; c < 3; c++)
+	{
+		rot[c][0] = m[c][0];
+		rot[c][1] = m[c][1];
+		rot[c][2] = m[c][2];
+		rot[c][3] = 0.0f;
+	}
+	rot[3][0] = rot[3][1] = rot[3][2] = 0.0f;
+	rot[3][3] = 1.0f;
+}
+
+static void EulerKernel0(const float*, mat4x4 rot)
+{
+	mat4x4_identity(rot);
+}
+
+template<int A0>
+static void EulerKernel1(const float* angles, mat4x4 rot)
+{
+	float m[3][3];
+	EulerSetAxis<A0>(m, cosf(angles[0]), sinf(angles[0]), 0.0f, 1.0f);
+	StoreRotation(m, rot);
+}
+
+template<int A0, int A1>
+static void EulerKernel2(const float* angles, mat4x4 rot)
+{
+	float m[3][3];
+	EulerSetAxis<A0>(m, cosf(angles[0]), sinf(angles[0]), 0.0f, 1.0f);
+	EulerApplyAxis<A1>(m, cosf(angles[1]), sinf(angles[1]));
+	StoreRotation(m, rot);
+}
+
+template<int A0, int A1, int A2>
+static void EulerKernel3(const float* angles, mat4x4 rot)
+{
+	float m[3][3];
+	EulerSetAxis<A0>(m, cosf(angles[0]), sinf(angles[0]), 0.0f, 1.0f);
+	EulerApplyAxis<A1>(m, cosf(angles[1]), sinf(angles[1]));
+	EulerApplyAxis<A2>(m, cosf(angles[2]), sinf(angles[2]));
+	StoreRotation(m, rot);
+}
+
+//every combination of axes, indexed by the axis of each rotation
+static const EulerKernel s_kernels1[3] = { EulerKernel1<0>, EulerKernel1<1>, EulerKernel1<2> };
+
+#define EULER_KERNELS2(a) { EulerKernel2<a, 0>, EulerKernel2<a, 1>, EulerKernel2<a, 2> }
+static const EulerKernel s_kernels2[3][3] = { EULER_KERNELS2(0), EULER_KERNELS2(1), EULER_KERNELS2(2) };
+
+#define EULER_KERNELS3(a, b) { EulerKernel3<a, b, 0>, EulerKernel3<a, b, 1>, EulerKernel3<a, b, 2> }
+#define EULER_KERNELS3_ROW(a) { EULER_KERNELS3(a, 0), EULER_KERNELS3(a, 1), EULER_KERNELS3(a, 2) }
+static const EulerKernel s_kernels3[3][3][3] = { EULER_KERNELS3_ROW(0), EULER_KERNELS3_ROW(1), EULER_KERNELS3_ROW(2) };
+
+EulerKernel GetEulerKernel(int numRotations, const int* axisOrder)
+{
+	for (int i = 0; i < numRotations; i++)
+	{
+		assert(axisOrder[i] >= 0 && axisOrder[i] < 3);
+	}
+	switch (numRotations)
+	{
+	case 0:
+		return EulerKernel0;
+	case 1:
+		return s_kernels1[axisOrder[0]];
+	case 2:
+		return s_kernels2[axisOrder[0]][axisOrder[1]];
+	default:
+		assert(numRotations == 3);
+		return s_kernels3[axisOrder[0]][axisOrder[1]][axisOrder[2]];
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "linmath.h"
+
+//Closed form Euler angle to rotation matrix kernels.
+//
+//A joint with axis order {a0, a1, a2} and angles {t0, t1, t2} has the
+//rotation R = Ra0(t0) * Ra1(t1) * Ra2(t2), the same product
+//Link::MakeLinkRotMatrixLocal used to build with mat4x4_rotate.  Here every
+//axis is a template argument, so each order compiles to a straight line of
+//sines, cosines and multiply-adds on the columns that actually change.  All
+//orders are instantiated (the 6 Tait-Bryan and 6 proper Euler orders a BVH
+//CHANNELS line can give, plus the degenerate ones), for 0 to 3 rotations.
+//
+//The result is the same as the mat4x4_rotate product: both do the same
+//products and sums, only the multiplications by 0 and 1 are left out.
+
+//Writes the rotation for angles (radians, one per rotation) into rot.
+//The translation column is set to zero and the last row to 0 0 0 1.
+typedef void (*EulerKernel)(const float* angles, mat4x4 rot);
+
+//Kernel for a joint with numRotations (0..3) rotations about
+//axisOrder[0], axisOrder[1], ... (X_AXIS, Y_AXIS or Z_AXIS).
+//Resolve this once when the skeleton is loaded, not per frame.
+EulerKernel GetEulerKernel(int numRotations, const int* axisOrder);
+
+//m = m * R_A(angle) for the 3x3 matrix m (column-major, m[col][row]) given
+//the cosine and sine of the angle.  T is float or a SIMD type with the
+//usual arithmetic operators.
+template<int A, typename T>
+inline void EulerApplyAxis(T m[3][3], T c, T s)
+{
+	const int j = (A + 1) % 3;
+	const int k = (A + 2) % 3;
+	for (int r = 0; r < 3; r++)
+	{
+		T mj = m[j][r];
+		T mk = m[k][r];
+		m[j][r] = mj * c + mk * s;
+		m[k][r] = mk * c - mj * s;
+	}
+}
+
+//m = R_A(angle)
+template<int A, typename T>
+inline void EulerSetAxis(T m[3][3], T c, T s, T zero, T one)
+{
+	const int j = (A + 1) % 3;
+	const int k = (A + 2) % 3;
+	m[A][A] = one;  m[A][j] = zero; m[A][k] = zero;
+	m[j][A] = zero; m[j][j] = c;    m[j][k] = s;
+	m[k][A] = zero; m[k][j] = zero - s; m[k][k] = c;
+}
@@ -0,0 +1,188 @@
+#include "FastFloat.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//powers of ten that are exactly representable as doubles
+static const double s_pow10[23] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const uint64_t s_pow10Int[9] =
+{
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+static inline int CountTrailingZeros(uint64_t v)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, v);
+	return (int)index;
+#else
+	return __builtin_ctzll(v);
+#endif
+}
+
+static inline bool IsLittleEndian()
+{
+	const uint16_t one = 1;
+	return *(const uint8_t*)&one == 1;
+}
+
+//Looks at the 8 bytes at p and returns how many of them (0..8) are leading
+//decimal digits.  The value of those digits is returned through value.
+//All 8 bytes must be readable.
+static inline int ParseUpTo8Digits(const char* p, uint32_t& value)
+{
+	uint64_t x;
+	memcpy(&x, p, 8);
+
+	//'0'..'9' become 0..9, every other character ends up >= 10
+	x ^= 0x3030303030303030ULL;
+	//high bit of each byte set if that byte is >= 10.  Carries can only leak
+	//into bytes after the first non digit, which are ignored anyway.
+	uint64_t nonDigit = ((x + 0x7676767676767676ULL) | x) & 0x8080808080808080ULL;
+	int n = nonDigit ? (CountTrailingZeros(nonDigit) >> 3) : 8;
+	if (n == 0)
+	{
+		value = 0;
+		return 0;
+	}
+
+	//move the n digits to the top so the empty slots read as leading zeros
+	x <<= (8 - n) * 8;
+
+	//combine pairs, then quads, then the two halves
+	x = (x * 10) + (x >> 8);
+	x = (((x & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32)))
+		+ (((x >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+	value = (uint32_t)x;
+	return n;
+}
+
+//Handles the shapes the fast path does not, the result is still correctly rounded
+static const char* ParseDoubleSlow(const char* start, const char* p, const char* end, bool neg, double& out)
+{
+	uint64_t mant = 0;
+	int numDigits = 0;
+	int exp10 = 0;
+	bool truncated = false;
+	const char* q = p;
+
+	for (; q < end && *q >= '0' && *q <= '9'; q++, numDigits++)
+	{
+		if (mant < 100000000000000000ULL) mant = mant * 10 + (*q - '0');
+		else { exp10++; if (*q != '0') truncated = true; }
+	}
+	if (q < end && *q == '.')
+	{
+		for (q++; q < end && *q >= '0' && *q <= '9'; q++, numDigits++)
+		{
+			if (mant < 100000000000000000ULL) { mant = mant * 10 + (*q - '0'); exp10--; }
+			else if (*q != '0') truncated = true;
+		}
+	}
+	if (numDigits > 0 && q < end && (*q == 'e' || *q == 'E'))
+	{
+		const char* e = q + 1;
+		bool expNeg = false;
+		if (e < end && (*e == '-' || *e == '+')) { expNeg = *e == '-'; e++; }
+		if (e < end && *e >= '0' && *e <= '9')
+		{
+			int ev = 0;
+			for (; e < end && *e >= '0' && *e <= '9'; e++)
+			{
+				if (ev < 100000) ev = ev * 10 + (*e - '0');
+			}
+			exp10 += expNeg ? -ev : ev;
+			q = e;
+		}
+	}
+
+	if (numDigits > 0 && !truncated && mant <= (1ULL << 53) && exp10 >= -22 && exp10 <= 22)
+	{
+		//both operands are exact, so one rounding gives the correctly rounded result
+		double v = (double)mant;
+		v = exp10 < 0 ? v / s_pow10[-exp10] : v * s_pow10[exp10];
+		out = neg ? -v : v;
+		return q;
+	}
+
+#if defined(__cpp_lib_to_chars)
+	//long mantissas, large exponents, inf and nan
+	double v = 0;
+	std::from_chars_result r = std::from_chars(p, end, v);
+	if (r.ec == std::errc() || r.ec == std::errc::result_out_of_range)
+	{
+		out = neg ? -v : v;
+		return r.ptr;
+	}
+#else
+	//no from_chars on this standard library, fall back to strtod on a bounded copy
+	char buf[128];
+	size_t len = (size_t)(end - p) < sizeof(buf) - 1 ? (size_t)(end - p) : sizeof(buf) - 1;
+	memcpy(buf, p, len);
+	buf[len] = '\0';
+	char* stop = buf;
+	double v = strtod(buf, &stop);
+	if (stop != buf)
+	{
+		out = neg ? -v : v;
+		return p + (stop - buf);
+	}
+#endif
+	out = 0;
+	return start;
+}
+
+const char* ParseDouble(const char* p, const char* end, double& out)
+{
+	const char* start = p;
+	bool neg = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		neg = *p == '-';
+		p++;
+	}
+
+	//fast path for -?d+.d+ with at most 7 digits on each side, which needs
+	//two 8 byte windows past p
+	if (IsLittleEndian() && end - p >= 17)
+	{
+		uint32_t intPart, fracPart;
+		int numInt = ParseUpTo8Digits(p, intPart);
+		if (numInt > 0 && numInt < 8)
+		{
+			const char* q = p + numInt;
+			int numFrac = 0;
+			fracPart = 0;
+			if (*q == '.')
+			{
+				numFrac = ParseUpTo8Digits(q + 1, fracPart);
+				q += 1 + numFrac;
+			}
+			if (numFrac < 8 && *q != 'e' && *q != 'E')
+			{
+				double v = (double)(intPart * s_pow10Int[numFrac] + fracPart) / s_pow10[numFrac];
+				out = neg ? -v : v;
+				return q;
+			}
+		}
+	}
+
+	return ParseDoubleSlow(start, p, end, neg, out);
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+//Locale independent decimal parsing for the BVH reader.
+//
+//Numbers of the shape -?d+.d+ with up to eight digits on either side of the
+//point (which is every number in a normal MOTION block) are converted eight
+//digits at a time inside a 64 bit register.  Anything else (exponents, very
+//long mantissas, inf/nan) goes through std::from_chars.  The result is the
+//correctly rounded double in every case, so it matches atof in the "C" locale
+//bit for bit.
+
+//Parses a number starting at p, reading no further than end.
+//Returns the position just past the number, or p if there is no number there
+//(out is then set to 0, the same as atof).
+const char* ParseDouble(const char* p, const char* end, double& out);
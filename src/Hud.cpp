@@ -0,0 +1,321 @@
+#include "Hud.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+//font pixels are drawn as HUD_SCALE x HUD_SCALE screen pixels
+#define HUD_SCALE 2
+#define HUD_CELL_W 6
+#define HUD_CELL_H 8
+#define HUD_SOLID_CELL 64
+//characters per line of text, longer lines are cut
+#define HUD_LINE_CHARS 48
+//text is formatted into buffers this long, enough for any row with
+//worst-case numbers (five 11 character ints), and cut when it's drawn
+#define HUD_FORMAT_CHARS 128
+#define HUD_TEXT_LINES 7
+#define HUD_GRAPH_HEIGHT 64
+
+//5x7 glyphs for ' ' to '_', one byte per row from the top, bit 4 leftmost
+static const unsigned char s_font[64][7] =
+{
+	{0x00,0x00,0x00,0x00,0x00,0x00,0x00}, {0x04,0x04,0x04,0x04,0x04,0x00,0x04}, //space !
+	{0x0A,0x0A,0x0A,0x00,0x00,0x00,0x00}, {0x0A,0x0A,0x1F,0x0A,0x1F,0x0A,0x0A}, //" #
+	{0x04,0x0F,0x14,0x0E,0x05,0x1E,0x04}, {0x18,0x19,0x02,0x04,0x08,0x13,0x03}, //$ %
+	{0x0C,0x12,0x14,0x08,0x15,0x12,0x0D}, {0x0C,0x04,0x08,0x00,0x00,0x00,0x00}, //& '
+	{0x02,0x04,0x08,0x08,0x08,0x04,0x02}, {0x08,0x04,0x02,0x02,0x02,0x04,0x08}, //( )
+	{0x00,0x04,0x15,0x0E,0x15,0x04,0x00}, {0x00,0x04,0x04,0x1F,0x04,0x04,0x00}, //* +
+	{0x00,0x00,0x00,0x00,0x0C,0x04,0x08}, {0x00,0x00,0x00,0x1F,0x00,0x00,0x00}, //, -
+	{0x00,0x00,0x00,0x00,0x00,0x0C,0x0C}, {0x00,0x01,0x02,0x04,0x08,0x10,0x00}, //. /
+	{0x0E,0x11,0x13,0x15,0x19,0x11,0x0E}, {0x04,0x0C,0x04,0x04,0x04,0x04,0x0E}, //0 1
+	{0x0E,0x11,0x01,0x02,0x04,0x08,0x1F}, {0x1F,0x02,0x04,0x02,0x01,0x11,0x0E}, //2 3
+	{0x02,0x06,0x0A,0x12,0x1F,0x02,0x02}, {0x1F,0x10,0x1E,0x01,0x01,0x11,0x0E}, //4 5
+	{0x06,0x08,0x10,0x1E,0x11,0x11,0x0E}, {0x1F,0x01,0x02,0x04,0x08,0x08,0x08}, //6 7
+	{0x0E,0x11,0x11,0x0E,0x11,0x11,0x0E}, {0x0E,0x11,0x11,0x0F,0x01,0x02,0x0C}, //8 9
+	{0x00,0x0C,0x0C,0x00,0x0C,0x0C,0x00}, {0x00,0x0C,0x0C,0x00,0x0C,0x04,0x08}, //: ;
+	{0x02,0x04,0x08,0x10,0x08,0x04,0x02}, {0x00,0x00,0x1F,0x00,0x1F,0x00,0x00}, //< =
+	{0x08,0x04,0x02,0x01,0x02,0x04,0x08}, {0x0E,0x11,0x01,0x02,0x04,0x00,0x04}, //> ?
+	{0x0E,0x11,0x01,0x0D,0x15,0x15,0x0E}, {0x0E,0x11,0x11,0x11,0x1F,0x11,0x11}, //@ A
+	{0x1E,0x11,0x11,0x1E,0x11,0x11,0x1E}, {0x0E,0x11,0x10,0x10,0x10,0x11,0x0E}, //B C
+	{0x1C,0x12,0x11,0x11,0x11,0x12,0x1C}, {0x1F,0x10,0x10,0x1E,0x10,0x10,0x1F}, //D E
+	{0x1F,0x10,0x10,0x1E,0x10,0x10,0x10}, {0x0E,0x11,0x10,0x17,0x11,0x11,0x0F}, //F G
+	{0x11,0x11,0x11,0x1F,0x11,0x11,0x11}, {0x0E,0x04,0x04,0x04,0x04,0x04,0x0E}, //H I
+	{0x07,0x02,0x02,0x02,0x02,0x12,0x0C}, {0x11,0x12,0x14,0x18,0x14,0x12,0x11}, //J K
+	{0x10,0x10,0x10,0x10,0x10,0x10,0x1F}, {0x11,0x1B,0x15,0x15,0x11,0x11,0x11}, //L M
+	{0x11,0x11,0x19,0x15,0x13,0x11,0x11}, {0x0E,0x11,0x11,0x11,0x11,0x11,0x0E}, //N O
+	{0x1E,0x11,0x11,0x1E,0x10,0x10,0x10}, {0x0E,0x11,0x11,0x11,0x15,0x12,0x0D}, //P Q
+	{0x1E,0x11,0x11,0x1E,0x14,0x12,0x11}, {0x0F,0x10,0x10,0x0E,0x01,0x01,0x1E}, //R S
+	{0x1F,0x04,0x04,0x04,0x04,0x04,0x04}, {0x11,0x11,0x11,0x11,0x11,0x11,0x0E}, //T U
+	{0x11,0x11,0x11,0x11,0x11,0x0A,0x04}, {0x11,0x11,0x11,0x15,0x15,0x15,0x0A}, //V W
+	{0x11,0x11,0x0A,0x04,0x0A,0x11,0x11}, {0x11,0x11,0x11,0x0A,0x04,0x04,0x04}, //X Y
+	{0x1F,0x01,0x02,0x04,0x08,0x10,0x1F}, {0x0E,0x08,0x08,0x08,0x08,0x08,0x0E}, //Z [
+	{0x00,0x10,0x08,0x04,0x02,0x01,0x00}, {0x0E,0x02,0x02,0x02,0x02,0x02,0x0E}, //\ ]
+	{0x04,0x0A,0x11,0x00,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00,0x00,0x00,0x1F}, //^ _
+};
+
+static const unsigned char s_panelColor[4] = { 0, 0, 0, 160 };
+static const unsigned char s_textColor[4] = { 230, 230, 230, 255 };
+static const unsigned char s_labelColor[4] = { 150, 150, 150, 255 };
+static const unsigned char s_goodColor[4] = { 80, 200, 80, 255 };
+static const unsigned char s_lateColor[4] = { 230, 60, 60, 255 };
+static const unsigned char s_droppedColor[4] = { 230, 200, 60, 255 };
+static const unsigned char s_budgetColor[4] = { 230, 230, 230, 128 };
+static const unsigned char s_fkColor[4] = { 90, 150, 240, 255 };
+
+//smallest 1, 2 or 5 times a power of ten that is at least value
+static double NiceCeil(double value)
+{
+	double step = 0.001;
+	while (step < value)
+	{
+		if (step * 2 >= value) return step * 2;
+		if (step * 5 >= value) return step * 5;
+		step *= 10;
+	}
+	return step;
+}
+
+Hud::Hud()
+	: m_refreshMs(1000.0 / 60.0)
+	, m_visible(true)
+	, m_out(NULL)
+	, m_numVertices(0)
+	, m_maxVertices(0)
+{
+	Reset();
+}
+
+void Hud::SetRefreshRate(double hz)
+{
+	if (hz > 0)
+	{
+		m_refreshMs = 1000.0 / hz;
+	}
+}
+
+void Hud::AddFrame(const HudSample& sample)
+{
+	int slot = (int)(m_count % HUD_HISTORY);
+	bool late = sample.frameMs > 1.5 * m_refreshMs;
+	//a repeated pose, or a jump past poses that were never shown
+	bool dropped = m_count > 0 && sample.poseSequence != m_lastSequence + 1;
+	m_history[slot] = sample;
+	m_late[slot] = late;
+	m_dropped[slot] = dropped;
+	m_totalLate += late ? 1 : 0;
+	m_totalDropped += dropped ? 1 : 0;
+	m_lastSequence = sample.poseSequence;
+	m_count++;
+}
+
+void Hud::Reset()
+{
+	m_count = 0;
+	m_totalLate = 0;
+	m_totalDropped = 0;
+	m_lastSequence = 0;
+}
+
+void Hud::SetVisible(bool visible)
+{
+	m_visible = visible;
+}
+
+bool Hud::IsVisible()
+{
+	return m_visible;
+}
+
+void Hud::ToggleVisible()
+{
+	m_visible = !m_visible;
+}
+
+int Hud::GetNumLateFrames()
+{
+	return m_totalLate;
+}
+
+int Hud::GetNumDroppedFrames()
+{
+	return m_totalDropped;
+}
+
+int Hud::GetMaxVertices()
+{
+	//the panel, the text, a bar per frame plus the budget line, and the bins
+	return 6 * (1 + HUD_TEXT_LINES * HUD_LINE_CHARS + HUD_HISTORY + 1 + HUD_HISTOGRAM_BINS);
+}
+
+void Hud::MakeFontAtlas(unsigned char* texels)
+{
+	memset(texels, 0, HUD_ATLAS_WIDTH * HUD_ATLAS_HEIGHT);
+	for (int cell = 0; cell <= HUD_SOLID_CELL; cell++)
+	{
+		int x0 = (cell % 16) * HUD_CELL_W;
+		int y0 = (cell / 16) * HUD_CELL_H;
+		for (int row = 0; row < 7; row++)
+		{
+			unsigned char bits = cell == HUD_SOLID_CELL ? 0x1F : s_font[cell][row];
+			for (int col = 0; col < 5; col++)
+			{
+				texels[(y0 + row) * HUD_ATLAS_WIDTH + x0 + col] = (bits >> (4 - col)) & 1 ? 255 : 0;
+			}
+		}
+	}
+}
+
+void Hud::Quad(float x0, float y0, float x1, float y1, int cell, const unsigned char* rgba)
+{
+	if (m_numVertices + 6 > m_maxVertices)
+	{
+		return;
+	}
+	float cx = (float)((cell % 16) * HUD_CELL_W);
+	float cy = (float)((cell / 16) * HUD_CELL_H);
+	float u0, v0, u1, v1;
+	if (cell == HUD_SOLID_CELL)
+	{
+		//every corner on the middle of the solid cell, so the whole quad is lit
+		u0 = u1 = (cx + 2.5f) / HUD_ATLAS_WIDTH;
+		v0 = v1 = (cy + 3.5f) / HUD_ATLAS_HEIGHT;
+	}
+	else
+	{
+		u0 = cx / HUD_ATLAS_WIDTH;
+		v0 = cy / HUD_ATLAS_HEIGHT;
+		u1 = (cx + 5) / HUD_ATLAS_WIDTH;
+		v1 = (cy + 7) / HUD_ATLAS_HEIGHT;
+	}
+	const float corners[6][4] =
+	{
+		{ x0, y0, u0, v0 }, { x1, y0, u1, v0 }, { x1, y1, u1, v1 },
+		{ x0, y0, u0, v0 }, { x1, y1, u1, v1 }, { x0, y1, u0, v1 },
+	};
+	for (int i = 0; i < 6; i++)
+	{
+		HudVertex& v = m_out[m_numVertices++];
+		v.x = corners[i][0];
+		v.y = corners[i][1];
+		v.u = corners[i][2];
+		v.v = corners[i][3];
+		memcpy(v.rgba, rgba, 4);
+	}
+}
+
+void Hud::Text(float x, float y, const char* text, const unsigned char* rgba)
+{
+	for (int i = 0; text[i] != 0 && i < HUD_LINE_CHARS; i++)
+	{
+		int c = (unsigned char)text[i];
+		if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+		if (c < 32 || c > '_') c = '?';
+		if (c != ' ')
+		{
+			float gx = x + i * HUD_CELL_W * HUD_SCALE;
+			Quad(gx, y, gx + 5 * HUD_SCALE, y + 7 * HUD_SCALE, c - 32, rgba);
+		}
+	}
+}
+
+int Hud::Build(HudVertex* out, int maxVertices, int width, int height)
+{
+	m_out = out;
+	m_numVertices = 0;
+	m_maxVertices = maxVertices;
+	if (!m_visible || width <= 0 || height <= 0)
+	{
+		return 0;
+	}
+
+	//the window, oldest frame first
+	int numFrames = m_count < HUD_HISTORY ? (int)m_count : HUD_HISTORY;
+	int first = (int)((m_count - numFrames) % HUD_HISTORY);
+	double frameSum = 0, frameMax = 0;
+	int lateInWindow = 0, droppedInWindow = 0;
+	double fk[HUD_HISTORY];
+	int numFK = 0;
+	for (int i = 0; i < numFrames; i++)
+	{
+		int slot = (first + i) % HUD_HISTORY;
+		frameSum += m_history[slot].frameMs;
+		frameMax = std::max(frameMax, m_history[slot].frameMs);
+		lateInWindow += m_late[slot] ? 1 : 0;
+		droppedInWindow += m_dropped[slot] ? 1 : 0;
+		//a dropped frame shows a pose already counted
+		if (!m_dropped[slot])
+		{
+			fk[numFK++] = m_history[slot].fkMs;
+		}
+	}
+	std::sort(fk, fk + numFK);
+	const HudSample* last = numFrames > 0 ? &m_history[(m_count - 1) % HUD_HISTORY] : NULL;
+
+	const float lineH = (HUD_CELL_H + 1) * HUD_SCALE;
+	const float graphW = HUD_HISTORY * 2;
+	const float left = 8, top = 8, pad = 8;
+	const float panelH = pad + 6 * lineH + 2 * HUD_GRAPH_HEIGHT + pad;
+	Quad(left, top, left + graphW + 2 * pad, top + panelH, HUD_SOLID_CELL, s_panelColor);
+
+	float x = left + pad, y = top + pad;
+	char line[HUD_FORMAT_CHARS];
+	snprintf(line, sizeof(line), "FRAME %6.2f MS  AVG %6.2f  MAX %6.2f",
+		last ? last->frameMs : 0.0, numFrames ? frameSum / numFrames : 0.0, frameMax);
+	Text(x, y, line, s_textColor);
+	y += lineH;
+	snprintf(line, sizeof(line), "FK    %6.3f MS  P50 %6.3f  P99 %6.3f",
+		last ? last->fkMs : 0.0, numFK ? fk[numFK / 2] : 0.0, numFK ? fk[(numFK * 99) / 100] : 0.0);
+	Text(x, y, line, s_textColor);
+	y += lineH;
+	snprintf(line, sizeof(line), "UPLOAD %.1f KB/FRAME", last ? last->uploadBytes / 1024.0 : 0.0);
+	Text(x, y, line, s_textColor);
+	y += lineH;
+	snprintf(line, sizeof(line), "CLIP FRAME %d/%d  %.2f S",
+		last ? last->clipFrame : 0, last ? last->numClipFrames : 0, last ? last->clipTime : 0.0);
+	Text(x, y, line, s_textColor);
+	y += lineH;
+	snprintf(line, sizeof(line), "LATE %d  DROPPED %d  (LAST %d: %d/%d)",
+		m_totalLate, m_totalDropped, numFrames, lateInWindow, droppedInWindow);
+	Text(x, y, line, lateInWindow || droppedInWindow ? s_lateColor : s_textColor);
+	y += lineH;
+
+	//frame times, full height at two refresh periods, with the budget line
+	double graphMs = 2.0 * m_refreshMs;
+	snprintf(line, sizeof(line), "FRAME TIME  0-%.0f MS", graphMs);
+	Text(x, y, line, s_labelColor);
+	y += lineH;
+	float base = y + HUD_GRAPH_HEIGHT;
+	for (int i = 0; i < numFrames; i++)
+	{
+		int slot = (first + i) % HUD_HISTORY;
+		double h = std::min(m_history[slot].frameMs / graphMs, 1.0) * HUD_GRAPH_HEIGHT;
+		const unsigned char* color = m_late[slot] ? s_lateColor : m_dropped[slot] ? s_droppedColor : s_goodColor;
+		Quad(x + i * 2, base - (float)h, x + i * 2 + 2, base, HUD_SOLID_CELL, color);
+	}
+	float budgetY = base - (float)(m_refreshMs / graphMs) * HUD_GRAPH_HEIGHT;
+	Quad(x, budgetY, x + graphW, budgetY + 1, HUD_SOLID_CELL, s_budgetColor);
+	y = base;
+
+	//FK times of the poses shown, over a 1-2-5 range that fits the slowest
+	double fkRange = NiceCeil(numFK ? fk[numFK - 1] : 0.0);
+	snprintf(line, sizeof(line), "FK HISTOGRAM  0-%.3f MS", fkRange);
+	Text(x, y, line, s_labelColor);
+	y += lineH;
+	int bins[HUD_HISTOGRAM_BINS] = { 0 };
+	int maxBin = 1;
+	for (int i = 0; i < numFK; i++)
+	{
+		int b = std::min((int)(fk[i] / fkRange * HUD_HISTOGRAM_BINS), HUD_HISTOGRAM_BINS - 1);
+		maxBin = std::max(maxBin, ++bins[b]);
+	}
+	base = y + HUD_GRAPH_HEIGHT - lineH;
+	float binW = graphW / HUD_HISTOGRAM_BINS;
+	for (int b = 0; b < HUD_HISTOGRAM_BINS; b++)
+	{
+		float h = (float)bins[b] / maxBin * (HUD_GRAPH_HEIGHT - lineH);
+		Quad(x + b * binW + 1, base - h, x + (b + 1) * binW - 1, base, HUD_SOLID_CELL, s_fkColor);
+	}
+
+	return m_numVertices;
+}
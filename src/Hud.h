@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+//frames the graphs, percentiles and "last N" counts cover
+#define HUD_HISTORY 256
+#define HUD_HISTOGRAM_BINS 24
+
+//The font atlas: a 5x7 pixel font in 6x8 cells, 16 cells to a row, one
+//byte per texel (0 or 255).  Cell c holds character 32 + c for space up to
+//'_'; lower case is drawn as upper case.  The last cell is solid and is what
+//the panels and bars are drawn with.
+#define HUD_ATLAS_WIDTH 96
+#define HUD_ATLAS_HEIGHT 40
+
+//One corner of a HUD triangle.  x, y are pixels from the top left of the
+//framebuffer, u, v normalized atlas coordinates, rgba 0-255.
+struct HudVertex
+{
+	float x, y;
+	float u, v;
+	unsigned char rgba[4];
+};
+
+//what the renderer measured for one displayed frame
+struct HudSample
+{
+	//wall time since the previous frame was displayed
+	double frameMs;
+	//sequence number of the pose drawn (PoseFrame::sequence)
+	uint64_t poseSequence;
+	//how long the animation thread took to evaluate it
+	double fkMs;
+	//where the pose is in the clip
+	double clipTime;
+	int clipFrame;
+	int numClipFrames;
+	//bytes handed to GL for the frame
+	size_t uploadBytes;
+};
+
+//Performance overlay for the player: frame time, a histogram of the FK
+//(pose evaluation) times, the bytes uploaded per frame, the clip frame and
+//counts of late and dropped frames, over the last HUD_HISTORY frames.
+//
+//It doesn't touch GL.  Build writes the overlay as textured triangles into
+//memory the caller provides, normally a mapped StreamBuffer region, and the
+//caller draws them with the atlas from MakeFontAtlas.  History is a fixed
+//ring and text is formatted on the stack, so neither AddFrame nor Build
+//allocates.
+//
+//A frame is late when it took more than one and a half refresh periods,
+//i.e. it missed a vsync.  It is dropped when it showed no new pose: the
+//animation thread hadn't finished the next one (or poses were skipped).
+class Hud
+{
+public:
+	Hud();
+
+	//display refresh rate, the budget late frames are measured against
+	void SetRefreshRate(double hz);
+
+	void AddFrame(const HudSample& sample);
+	//zeros the totals and forgets the history
+	void Reset();
+
+	void SetVisible(bool visible);
+	bool IsVisible();
+	void ToggleVisible();
+
+	int GetNumLateFrames();
+	int GetNumDroppedFrames();
+
+	//Writes the overlay for a width x height framebuffer, at most maxVertices
+	//vertices, and returns how many were written.  Nothing when hidden.
+	int Build(HudVertex* out, int maxVertices, int width, int height);
+	//the most Build ever writes
+	static int GetMaxVertices();
+
+	//fills HUD_ATLAS_WIDTH * HUD_ATLAS_HEIGHT texels, row after row from the top
+	static void MakeFontAtlas(unsigned char* texels);
+
+private:
+	//a glyph or solid quad, clipped to the space left in the output
+	void Quad(float x0, float y0, float x1, float y1, int cell, const unsigned char* rgba);
+	void Text(float x, float y, const char* text, const unsigned char* rgba);
+
+	double m_refreshMs;
+	bool m_visible;
+
+	HudSample m_history[HUD_HISTORY];
+	bool m_late[HUD_HISTORY];
+	bool m_dropped[HUD_HISTORY];
+	//samples added since the last Reset, the newest at (m_count - 1) % HUD_HISTORY
+	uint64_t m_count;
+	int m_totalLate;
+	int m_totalDropped;
+	uint64_t m_lastSequence;
+
+	//output of the Build in progress
+	HudVertex* m_out;
+	int m_numVertices;
+	int m_maxVertices;
+};
@@ -11,10 +11,11 @@
 
 Link::Link()
 {
-	int i;
-	for (i = 0; i < KL_MAX_CHILDREN; i++) m_children[i] = NULL;
-
+	m_firstChild = NULL;
+	m_lastChild = NULL;
+	m_nextSibling = NULL;
 
+	m_name[0] = '\0';
 	m_numChildren = 0;
 	m_jointType = 0;
 	m_parNde = NULL;
@@ -41,13 +42,16 @@ Link::Link()
 	m_jointTypeToNumRotations[12] = 3;
 
 	m_dofValues[0] = m_dofValues[1] = m_dofValues[2] = 0.0;
+	m_rotQuat[0] = m_rotQuat[1] = m_rotQuat[2] = 0.0f;
+	m_rotQuat[3] = 1.0f;
+	m_useRotQuat = false;
 
 	m_geomFromParent = NULL;
 
+	UpdateRotKernel();
 }
 Link::~Link()
 {
-	if (m_geomFromParent) delete[] m_geomFromParent;
 }
 
 void Link::SetName(char* n)
@@ -70,50 +74,62 @@ int Link::GetNumRotations()
 //null indicates that there is no such child
 Link* Link::GetChild(int num)
 {
-	if (num < KL_MAX_CHILDREN)
-	{
-		return m_children[num];
-	}
-	else
+	Link* child = m_firstChild;
+	for (int i = 0; i < num && child; i++)
 	{
-		return NULL;
+		child = child->m_nextSibling;
 	}
+	return child;
 
 }
+int Link::GetNumChildren()
+{
+	return m_numChildren;
+}
+Link* Link::GetNextSibling()
+{
+	return m_nextSibling;
+}
 
-//adds child to the link 
-//Children will be added at the first open location in the 
-//child array.
-//If the array is full, returns false and does not add node
-//otherwise, returns true.
+//adds child to the end of the link's children.
 bool Link::AddChild(Link* l)
 {
-	if (m_numChildren >= KL_MAX_CHILDREN)
+	l->SetParent(this);
+	l->m_nextSibling = NULL;
+	if (m_lastChild)
 	{
-		std::cerr << "Cannot add child to kinematic skeleton as joint valence has been met." << std::endl;
-		//no room for child
-		return false;
+		m_lastChild->m_nextSibling = l;
 	}
 	else
 	{
-		l->SetParent(this);
-		m_children[m_numChildren] = l;
-		m_numChildren++;
+		m_firstChild = l;
 	}
+	m_lastChild = l;
+	m_numChildren++;
 	return true;
 }
 void Link::RemoveChild(char* name)
 {
-	for (int i = 0; i < m_numChildren; i++)
+	Link* prev = NULL;
+	for (Link* child = m_firstChild; child; prev = child, child = child->m_nextSibling)
 	{
-		if (0 == strcmp(m_children[i]->GetName(), name))
+		if (0 == strcmp(child->GetName(), name))
 		{
-			m_numChildren--;
 			//remove this one
-			for (int j = i; j < m_numChildren; j++)
+			if (prev)
 			{
-				m_children[j] = m_children[j + 1];
+				prev->m_nextSibling = child->m_nextSibling;
 			}
+			else
+			{
+				m_firstChild = child->m_nextSibling;
+			}
+			if (m_lastChild == child)
+			{
+				m_lastChild = prev;
+			}
+			child->m_nextSibling = NULL;
+			m_numChildren--;
 			break;
 		}
 	}
@@ -131,8 +147,17 @@ void Link::SetAxisOrder(int rotOrder, int axisNum)
 	if (rotOrder < 3 && rotOrder >= 0)
 	{
 		m_axisOrder[rotOrder] = axisNum;
+		UpdateRotKernel();
 	}
 }
+int Link::GetAxisOrder(int rotOrder)
+{
+	return m_axisOrder[rotOrder];
+}
+Link* Link::GetParent()
+{
+	return m_parNde;
+}
 void Link::SetParent(Link* p)
 {
 	m_parNde = p;
@@ -167,7 +192,37 @@ void Link::SetJointType(const char* type)
 			found = true;
 		}
 	}
+	UpdateRotKernel();
+
+}
+int Link::GetNumChannels(int jointType)
+{
+	switch (jointType)
+	{
+	case J_FREE:
+	case J_EULER_SIX:
+		return 6;
+	case J_PIN:
+		return 1;
+	case J_UNIVERSAL:
+		return 2;
+	case J_BALL:
+	case J_GIMBAL:
+		return 3;
+	case J_WELD:
+		return 0;
+	default:
+		return -1;
+	}
+}
 
+void Link::SetJointType(int type)
+{
+	if (type >= J_UNDEF && type <= J_BUSHING)
+	{
+		m_jointType = type;
+		UpdateRotKernel();
+	}
 }
 void Link::SetDOFValues(double* v)
 {
@@ -178,8 +233,17 @@ void Link::SetDOFValues(double* v)
 	{
 		m_dofValues[i] = v[i];
 	}
+	m_useRotQuat = false;
 
 }
+void Link::SetRotation(const float q[4])
+{
+	for (int i = 0; i < 4; i++)
+	{
+		m_rotQuat[i] = q[i];
+	}
+	m_useRotQuat = true;
+}
 void Link::GetLToWTransMat(mat4x4 m)
 {
 	int i, j;
@@ -209,7 +273,6 @@ void Link::UpdateAndRecurse(Skeleton* pSkel)
 
 		// Calculate local rotation matrix
 		mat4x4 localRotMat;
-		mat4x4_identity(localRotMat);
 		MakeLinkRotMatrixLocal(localRotMat);
 
 		//Multiply local translation and rotation matrices
@@ -223,8 +286,8 @@ void Link::UpdateAndRecurse(Skeleton* pSkel)
 	
 
 	// Recurse over children
-	for (int i = 0; i < m_numChildren; i++) {
-		m_children[i]->UpdateAndRecurse(pSkel);
+	for (Link* child = m_firstChild; child; child = child->m_nextSibling) {
+		child->UpdateAndRecurse(pSkel);
 	}
 }
 
@@ -267,29 +330,49 @@ void Link::CalcVertexLocations(int maxEntries, int* curLocation, VERTEX** outCoo
 	*curLocation += 12;
 
 	//TO DO:  Add some more code...
-	for (int i = 0; i < m_numChildren; i++) {
-		m_children[i]->CalcVertexLocations(maxEntries, curLocation, outCoords);
+	for (Link* child = m_firstChild; child; child = child->m_nextSibling) {
+		child->CalcVertexLocations(maxEntries, curLocation, outCoords);
 	}
 }
 
-void Link::CalcParentGeomAndRecurse()
+void Link::CalcParentGeom(VERTEX* geom)
+{
+	MakePyramid(m_parTrans, geom);
+	m_geomFromParent = geom;
+}
+void Link::CalcBoneMatrix(mat4x4 m)
+{
+	//same rotation as MakePyramid, with the length as a scale
+	float quat[4];
+	float yup[3] = { 0.,1.,0. };
+	float perp[3] = { 1,0,0 };
+	CalcQuatToAlignWithVector(yup, m_parTrans, quat, perp);
+	mat4x4 rot;
+	mat4x4_from_quat(rot, quat);
+	float len = vec3_len(m_parTrans);
+	mat4x4_scale_aniso(m, rot, len, len, len);
+}
+//This will make a pyramid that is y-up by default, and then rotate it to align with the given vector (axis)
+void Link::MakePyramid(float axis[3], VERTEX* out)
 {
-	MakePyramid(m_parTrans, &m_geomFromParent);
-	for (int i = 0; i < KL_MAX_CHILDREN; i++)
+	MakeBonePyramid(vec3_len(axis), out);
+
+	//now we need to rotate the geometry to align with the desired axis
+	float quat[4];
+	float yup[3] = { 0.,1.,0. };
+	float perp[3] = { 1,0,0 };
+	this->CalcQuatToAlignWithVector(yup, axis, quat, perp);
+	mat4x4 tm;
+	mat4x4_from_quat(tm, quat);
+
+	for (int i = 0; i < 12; i++)
 	{
-		if (m_children[i])
-		{
-			m_children[i]->CalcParentGeomAndRecurse();
-		}
+		TransformVERTEX_rowMajor(tm, &out[i], &out[i]);
 	}
-
 }
-//This will make a pyramid that is y-up by default, and then rotate it to align with the given vector (axis)
-void Link::MakePyramid(float axis[3], VERTEX** outCoords)
+void Link::MakeBonePyramid(float len, VERTEX* out)
 {
 	//It would be a bit cleaner to set this up with an element array
-	VERTEX* out = new VERTEX[12];
-	float len = vec3_len(axis);
 	float offset = len / 20.0;
 	int startInd = 0;
 	for (int i = 0; i < 4; i++)
@@ -336,20 +419,6 @@ void Link::MakePyramid(float axis[3], VERTEX** outCoords)
 
 		startInd += 3;
 	}
-
-	//now we need to rotate the geometry to align with the desired axis
-	float quat[4];
-	float yup[3] = { 0.,1.,0. };
-	float perp[3] = { 1,0,0 };
-	this->CalcQuatToAlignWithVector(yup, axis, quat, perp);
-	mat4x4 tm;
-	mat4x4_from_quat(tm, quat);
-
-	for (int i = 0; i < 12; i++)
-	{
-		TransformVERTEX_rowMajor(tm, &out[i], &out[i]);
-	}
-	(*outCoords) = out;
 }
 void Link::TransformVERTEX_rowMajor(mat4x4 tm, VERTEX* vertIn, VERTEX*vertOut)
 {
@@ -503,24 +572,17 @@ void Link::CalcQuatToAlignWithVector(float baseVec[], float targetVec[], float q
 //
 void Link::MakeLinkRotMatrixLocal(mat4x4 rot)
 {
-	//To add
-
-	// Applying X, Y, Z rotations to rot based on the order in m_axisOrder
-	for(int i = 0; i < m_jointTypeToNumRotations[m_jointType]; i++) {
-		switch (m_axisOrder[i])
-		{
-		case 0:
-			mat4x4_rotate(rot, rot, 1.0f, 0.0f, 0.0f, m_dofValues[i]);
-			break;
-		case 1:
-			mat4x4_rotate(rot, rot, 0.0f, 1.0f, 0.0f, m_dofValues[i]);
-			break;
-		case 2:
-			mat4x4_rotate(rot, rot, 0.0f, 0.0f, 1.0f, m_dofValues[i]);
-			break;
-		
-		default:
-			break;
-		}
+	if (m_useRotQuat)
+	{
+		mat4x4_from_quat(rot, m_rotQuat);
+		return;
 	}
+	// Applying X, Y, Z rotations to rot based on the order in m_axisOrder
+	float angles[3] = { (float)m_dofValues[0], (float)m_dofValues[1], (float)m_dofValues[2] };
+	m_rotKernel(angles, rot);
+}
+
+void Link::UpdateRotKernel()
+{
+	m_rotKernel = GetEulerKernel(m_jointTypeToNumRotations[m_jointType], m_axisOrder);
 }
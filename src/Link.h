@@ -2,8 +2,8 @@
 
 #include "defs.h"
 #include "linmath.h"
+#include "EulerKernels.h"
 
-#define KL_MAX_CHILDREN 5
 #define MAX_NAME_LEN 80
 
 
@@ -36,17 +36,18 @@ public:
 	Link* GetParent();
 	void SetParent(Link* p);
 
-	//adds child to the link 
-	//Children will be added at the first open location in the 
-	//child array.
-	//If the array is full, returns false and does not add node
-	//otherwise, returns true.
+	//adds child to the end of the link's children.  There is no limit on the
+	//number of children, so this always returns true.
 	bool AddChild(Link* l);
 	void RemoveChild(char* name);
 
 	//returns child with the given index number
 	//null indicates that there is no such child
 	Link* GetChild(int num);
+	int GetNumChildren();
+	//the next child of this link's parent, null for the last one.  Walking
+	//GetChild(0) and then GetNextSibling visits every child in order.
+	Link* GetNextSibling();
 
 	int GetNumRotations();
 
@@ -58,10 +59,21 @@ public:
 	void GetParTranslation(double v[3]);
 	void SetParTranslation(double x, double y, double z);
 	void SetAxisOrder(int rotOrder, int axisNum);
+	int GetAxisOrder(int rotOrder);
 	void SetJointType(const char* type);
+	//same as above using one of the J_ constants
+	void SetJointType(int type);
 	int GetJointType();
+	//Values a joint of the given type takes in a frame of motion, as
+	//Skeleton::SetSkelState reads them: 6 for the root's free joints
+	//(translation and rotation), one per rotation for the rotational ones
+	//and 0 for a weld.  -1 for the types SetSkelState can't read.
+	static int GetNumChannels(int jointType);
 
 	void SetDOFValues(double* v);
+	//sets the joint's rotation as a unit quaternion x y z w instead of
+	//angles.  Used until the next SetDOFValues.
+	void SetRotation(const float q[4]);
 
 	//maxEntries is the number of values that you can put in the outCoords array
 	//curLocation is the next empty location where you can start adding
@@ -75,14 +87,22 @@ public:
 
 	//calculate the geometry used for rendering 
 	//currently a pyramid from the parent joint to this joint in the
-	//parent frame
-	void CalcParentGeomAndRecurse();
+	//parent frame.  The 12 vertices are written to geom, which is owned by
+	//the caller (the skeleton keeps one array for all links) and must stay
+	//valid while the link is drawn.
+	void CalcParentGeom(VERTEX* geom);
+
+	//The bone geometry as a mesh and a matrix, for drawing every bone as an
+	//instance of one mesh.  MakeBonePyramid(1, mesh) transformed by
+	//CalcBoneMatrix gives the same pyramid as CalcParentGeom.
+	static void MakeBonePyramid(float len, VERTEX* out);
+	void CalcBoneMatrix(mat4x4 m);
 
 	Link();
 	virtual ~Link();
 
 private:
-	void MakePyramid(float axis[3], VERTEX** outCoords);
+	void MakePyramid(float axis[3], VERTEX* out);
 
 	//This function will calculate a quaternion that will align a vector in a given coordinate
 	//frame with a target vector in that same coordinate frame.  For instance, the base vector
@@ -98,12 +118,18 @@ private:
 
 	void MakeLinkRotMatrixLocal(mat4x4 rot);
 
+	//picks m_rotKernel for the current joint type and axis order
+	void UpdateRotKernel();
+
 
 	//link name
 	char m_name[MAX_NAME_LEN + 1];
 
-	//children of this node
-	Link* m_children[KL_MAX_CHILDREN];
+	//children of this node, as a list threaded through the children
+	//themselves so a link can have any number without allocating
+	Link* m_firstChild;
+	Link* m_lastChild;
+	Link* m_nextSibling;
 
 	//parent of this node, NULL if this node is the root
 	Link* m_parNde;
@@ -125,6 +151,10 @@ private:
 	//what kind of joint is associated with the link
 	int m_jointType;
 
+	//builds the rotation for m_jointType and m_axisOrder, chosen when either
+	//changes so MakeLinkRotMatrixLocal doesn't have to look at the axes
+	EulerKernel m_rotKernel;
+
 
 	//The local to world transformation matrix for this link
 	mat4x4 m_LToWTrans;
@@ -137,9 +167,15 @@ private:
 	//be performed first, the z dof is the first dof)
 	double m_dofValues[3];
 
+	//rotation set through SetRotation, used instead of m_dofValues while
+	//m_useRotQuat is set
+	float m_rotQuat[4];
+	bool m_useRotQuat;
+
 	//This contains the geometry used to show the bone going from
 	//the parent of this joint's to this joint.
 	//This is expressed in the local frame of the parent.
+	//Points into storage given to CalcParentGeom, not owned by the link.
 	VERTEX* m_geomFromParent;
 
 };
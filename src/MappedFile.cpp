@@ -0,0 +1,141 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+	m_data = NULL;
+	m_size = 0;
+	m_open = false;
+	m_writable = false;
+#ifdef _WIN32
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = NULL;
+#else
+	m_fd = -1;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* filename, bool copyOnWrite)
+{
+	Close();
+
+#ifdef _WIN32
+	m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size))
+	{
+		Close();
+		return false;
+	}
+	m_size = (size_t)size.QuadPart;
+	if (m_size > 0)
+	{
+		m_mapping = CreateFileMappingA(m_file, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+		if (m_mapping == NULL)
+		{
+			Close();
+			return false;
+		}
+		m_data = (const char*)MapViewOfFile(m_mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+		if (m_data == NULL)
+		{
+			Close();
+			return false;
+		}
+	}
+#else
+	m_fd = open(filename, O_RDONLY);
+	if (m_fd < 0)
+	{
+		return false;
+	}
+	struct stat st;
+	if (fstat(m_fd, &st) != 0)
+	{
+		Close();
+		return false;
+	}
+	m_size = (size_t)st.st_size;
+	if (m_size > 0)
+	{
+		void* addr = mmap(NULL, m_size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ, MAP_PRIVATE, m_fd, 0);
+		if (addr == MAP_FAILED)
+		{
+			Close();
+			return false;
+		}
+		//the file is read front to back, so let the kernel read ahead aggressively
+		madvise(addr, m_size, MADV_SEQUENTIAL);
+		m_data = (const char*)addr;
+	}
+#endif
+
+	//an empty file is a valid (empty) view
+	if (m_data == NULL)
+	{
+		static const char empty = 0;
+		m_data = &empty;
+	}
+	m_open = true;
+	m_writable = copyOnWrite && m_size > 0;
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_open && m_size > 0) UnmapViewOfFile(m_data);
+	if (m_mapping) CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+	m_mapping = NULL;
+	m_file = INVALID_HANDLE_VALUE;
+#else
+	if (m_open && m_size > 0) munmap((void*)m_data, m_size);
+	if (m_fd >= 0) close(m_fd);
+	m_fd = -1;
+#endif
+	m_data = NULL;
+	m_size = 0;
+	m_open = false;
+	m_writable = false;
+}
+
+bool MappedFile::IsOpen()
+{
+	return m_open;
+}
+
+const char* MappedFile::GetData()
+{
+	return m_data;
+}
+
+char* MappedFile::GetWritableData()
+{
+	return m_writable ? (char*)m_data : NULL;
+}
+
+size_t MappedFile::GetSize()
+{
+	return m_size;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+
+//Read-only view of an entire file mapped into memory.
+//The bytes returned by GetData stay valid until Close is called or the
+//object is destroyed.  The view is NOT null terminated, so always use
+//GetSize to find the end.
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	//maps the whole file into memory
+	//If copyOnWrite is true the view may be written to; changes stay private
+	//to this process and never reach the file.
+	//Returns false if the file could not be opened or mapped
+	bool Open(const char* filename, bool copyOnWrite = false);
+	void Close();
+
+	bool IsOpen();
+	const char* GetData();
+	//NULL unless the file was opened copy on write
+	char* GetWritableData();
+	size_t GetSize();
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	const char* m_data;
+	size_t m_size;
+	bool m_open;
+	bool m_writable;
+
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#else
+	int m_fd;
+#endif
+};
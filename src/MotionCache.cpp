@@ -0,0 +1,364 @@
+#include "MotionCache.h"
+#include "Skeleton.h"
+#include "Link.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+#include "MappedFile.h"
+#include "AlignedAlloc.h"
+
+#include <iostream>
+#include <vector>
+#include <unordered_map>
+#include <string.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+//bump whenever the layout below or the meaning of the stored values changes
+#define MOTION_CACHE_VERSION 1
+#define MOTION_CACHE_BYTE_ORDER 0x01020304u
+
+struct MotionCacheHeader
+{
+	char magic[4];			// "BVHC"
+	uint32_t version;
+	uint32_t byteOrder;		// MOTION_CACHE_BYTE_ORDER as written by the producer
+	uint32_t inToM;			// frames were converted from inches to metres
+
+	uint64_t sourceSize;
+	int64_t sourceMTime;
+	uint64_t sourceHash;
+
+	uint32_t numLinks;
+	uint32_t numDOFs;
+	uint32_t numFrames;
+	uint32_t frameStride;
+	float frameTime;
+	uint32_t namesSize;
+
+	uint64_t linksOffset;
+	uint64_t namesOffset;
+	uint64_t framesOffset;
+	uint64_t fileSize;
+};
+
+struct MotionCacheLink
+{
+	int32_t parent;			// index of the parent link, -1 for the root
+	int32_t jointType;		// J_ constant
+	int32_t axisOrder[3];
+	float offset[3];		// parent translation
+	uint32_t nameOffset;	// into the name block
+	uint32_t nameLength;
+};
+
+static_assert(sizeof(MotionCacheHeader) == 96, "cache header layout changed");
+static_assert(sizeof(MotionCacheLink) == 40, "cache link layout changed");
+
+//size and modification time of a file, false if it doesn't exist
+static bool GetFileInfo(const char* filename, uint64_t& size, int64_t& mtime)
+{
+	struct stat st;
+	if (stat(filename, &st) != 0)
+	{
+		return false;
+	}
+	size = (uint64_t)st.st_size;
+	//nanoseconds where the platform keeps them, so an edit in the same second
+	//as the cache write is still noticed
+#if defined(__APPLE__)
+	mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+	mtime = (int64_t)st.st_mtime * 1000000000;
+#else
+	mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+static uint64_t HashFile(const char* filename, bool& ok)
+{
+	MappedFile file;
+	ok = file.Open(filename);
+	return ok ? MotionCache::HashBytes(file.GetData(), file.GetSize()) : 0;
+}
+
+static size_t AlignUp(size_t v, size_t alignment)
+{
+	return (v + alignment - 1) / alignment * alignment;
+}
+
+MotionCache::MotionCache()
+{
+	m_enabled = true;
+	m_loadedFromCache = false;
+}
+
+void MotionCache::SetEnabled(bool enabled)
+{
+	m_enabled = enabled;
+}
+
+bool MotionCache::LoadedFromCache()
+{
+	return m_loadedFromCache;
+}
+
+std::string MotionCache::GetCachePath(const char* bvhFile)
+{
+	return std::string(bvhFile) + "c";
+}
+
+//Four independent multiply/rotate lanes over 32 byte blocks, fast enough that
+//hashing is limited by memory bandwidth rather than arithmetic.
+uint64_t MotionCache::HashBytes(const void* data, size_t size)
+{
+	const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+	const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+	const unsigned char* p = (const unsigned char*)data;
+	const unsigned char* end = p + size;
+
+	uint64_t lane[4] = { prime1, prime2, ~prime1, ~prime2 };
+	while (end - p >= 32)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			uint64_t w;
+			memcpy(&w, p + i * 8, 8);
+			lane[i] ^= w * prime2;
+			lane[i] = (lane[i] << 31) | (lane[i] >> 33);
+			lane[i] *= prime1;
+		}
+		p += 32;
+	}
+	uint64_t h = size * prime1;
+	for (int i = 0; i < 4; i++)
+	{
+		h ^= lane[i];
+		h = ((h << 27) | (h >> 37)) * prime1 + prime2;
+	}
+	for (; p < end; p++)
+	{
+		h ^= *p * prime1;
+		h = ((h << 11) | (h >> 53)) * prime2;
+	}
+	h ^= h >> 33;
+	h *= prime2;
+	h ^= h >> 29;
+	return h;
+}
+
+bool MotionCache::Load(const char* bvhFile, Skeleton* skel, AnimRec* rec, bool inToM)
+{
+	m_loadedFromCache = false;
+	if (m_enabled && Read(bvhFile, skel, rec, inToM))
+	{
+		m_loadedFromCache = true;
+		return true;
+	}
+
+	BVHReader parser;
+	if (!parser.BuildSkelFromFile(bvhFile, skel, rec, inToM))
+	{
+		return false;
+	}
+	if (m_enabled && skel->GetNumLinks() > 0 && rec->GetNumFrames() > 0)
+	{
+		//a read only directory just means no cache, not an error
+		Write(bvhFile, skel, rec, inToM);
+	}
+	return true;
+}
+
+bool MotionCache::Write(const char* bvhFile, Skeleton* skel, AnimRec* rec, bool inToM)
+{
+	MotionCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "BVHC", 4);
+	header.version = MOTION_CACHE_VERSION;
+	header.byteOrder = MOTION_CACHE_BYTE_ORDER;
+	header.inToM = inToM ? 1 : 0;
+
+	bool ok;
+	if (!GetFileInfo(bvhFile, header.sourceSize, header.sourceMTime))
+	{
+		return false;
+	}
+	header.sourceHash = HashFile(bvhFile, ok);
+	if (!ok)
+	{
+		return false;
+	}
+
+	//links and their names
+	int numLinks = skel->GetNumLinks();
+	std::unordered_map<Link*, int> linkIndex;
+	std::vector<MotionCacheLink> links(numLinks);
+	std::string names;
+	for (int i = 0; i < numLinks; i++)
+	{
+		Link* link = skel->GetLink(i);
+		linkIndex[link] = i;
+
+		MotionCacheLink& out = links[i];
+		memset(&out, 0, sizeof(out));
+		out.parent = link->GetParent() ? linkIndex[link->GetParent()] : -1;
+		out.jointType = link->GetJointType();
+		double offset[3];
+		link->GetParTranslation(offset);
+		for (int a = 0; a < 3; a++)
+		{
+			out.axisOrder[a] = link->GetAxisOrder(a);
+			out.offset[a] = (float)offset[a];
+		}
+		out.nameOffset = (uint32_t)names.size();
+		out.nameLength = (uint32_t)strlen(link->GetName());
+		names += link->GetName();
+	}
+
+	header.numLinks = numLinks;
+	header.numDOFs = rec->GetNumDOFs();
+	header.numFrames = rec->GetNumFrames();
+	header.frameStride = rec->GetFrameStride();
+	header.frameTime = rec->GetFrameTime();
+	header.namesSize = (uint32_t)names.size();
+	header.linksOffset = sizeof(header);
+	header.namesOffset = header.linksOffset + sizeof(MotionCacheLink) * numLinks;
+	header.framesOffset = AlignUp(header.namesOffset + names.size(), CACHE_LINE_SIZE);
+	size_t frameBytes = (size_t)header.numFrames * header.frameStride * sizeof(float);
+	header.fileSize = header.framesOffset + frameBytes;
+
+	//write to a temporary name so a reader never sees a half written cache
+	std::string path = GetCachePath(bvhFile);
+	std::string tmpPath = path + ".tmp";
+	FILE* f = fopen(tmpPath.c_str(), "wb");
+	if (!f)
+	{
+		return false;
+	}
+	static const char zeros[CACHE_LINE_SIZE] = { 0 };
+	ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	ok = ok && (numLinks == 0 || fwrite(links.data(), sizeof(MotionCacheLink), numLinks, f) == (size_t)numLinks);
+	ok = ok && fwrite(names.data(), 1, names.size(), f) == names.size();
+	size_t pad = header.framesOffset - (header.namesOffset + names.size());
+	ok = ok && fwrite(zeros, 1, pad, f) == pad;
+	if (ok && header.numFrames > 0)
+	{
+		//frames are contiguous in memory, so this is a single write
+		ok = fwrite(rec->GetFrameData(0), 1, frameBytes, f) == frameBytes;
+	}
+	ok = (fclose(f) == 0) && ok;
+
+	if (ok)
+	{
+		remove(path.c_str());
+		ok = rename(tmpPath.c_str(), path.c_str()) == 0;
+	}
+	if (!ok)
+	{
+		remove(tmpPath.c_str());
+	}
+	return ok;
+}
+
+bool MotionCache::Read(const char* bvhFile, Skeleton* skel, AnimRec* rec, bool inToM)
+{
+	if (skel->GetNumLinks() != 0 || rec->GetNumFrames() != 0)
+	{
+		return false;
+	}
+
+	uint64_t sourceSize;
+	int64_t sourceMTime;
+	if (!GetFileInfo(bvhFile, sourceSize, sourceMTime))
+	{
+		return false;
+	}
+
+	MappedFile* file = new MappedFile();
+	std::string path = GetCachePath(bvhFile);
+	if (!file->Open(path.c_str(), true) || file->GetSize() < sizeof(MotionCacheHeader))
+	{
+		delete file;
+		return false;
+	}
+
+	//everything below has to check out before anything is built
+	char* data = file->GetWritableData();
+	size_t size = file->GetSize();
+	MotionCacheHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	bool valid = memcmp(header.magic, "BVHC", 4) == 0
+		&& header.version == MOTION_CACHE_VERSION
+		&& header.byteOrder == MOTION_CACHE_BYTE_ORDER
+		&& header.inToM == (inToM ? 1u : 0u)
+		&& header.sourceSize == sourceSize
+		&& header.fileSize == size
+		&& header.numLinks > 0
+		&& header.frameStride == (uint32_t)PadToCacheLine(header.numDOFs)
+		&& header.linksOffset == sizeof(header)
+		&& header.namesOffset == header.linksOffset + (uint64_t)sizeof(MotionCacheLink) * header.numLinks
+		&& header.framesOffset >= header.namesOffset + header.namesSize
+		&& header.framesOffset % CACHE_LINE_SIZE == 0
+		&& header.framesOffset + (uint64_t)header.numFrames * header.frameStride * sizeof(float) == size;
+
+	//the size and time match for an untouched file, otherwise fall back to the contents
+	if (valid && header.sourceMTime != sourceMTime)
+	{
+		bool ok;
+		valid = HashFile(bvhFile, ok) == header.sourceHash && ok;
+	}
+
+	//the links' channels have to add up to numDOFs, or posing would read
+	//past the end of every frame
+	const MotionCacheLink* links = (const MotionCacheLink*)(data + header.linksOffset);
+	const char* names = data + header.namesOffset;
+	uint64_t numChannels = 0;
+	for (uint32_t i = 0; valid && i < header.numLinks; i++)
+	{
+		const MotionCacheLink& l = links[i];
+		int channels = Link::GetNumChannels(l.jointType);
+		valid = (i == 0 ? l.parent == -1 : (l.parent >= 0 && (uint32_t)l.parent < i))
+			&& channels >= 0 && (channels < 6 || i == 0)
+			&& (uint64_t)l.nameOffset + l.nameLength <= header.namesSize
+			&& l.nameLength <= MAX_NAME_LEN;
+		for (int a = 0; valid && a < 3; a++)
+		{
+			valid = l.axisOrder[a] >= X_AXIS && l.axisOrder[a] <= Z_AXIS;
+		}
+		numChannels += channels > 0 ? channels : 0;
+	}
+	valid = valid && numChannels == header.numDOFs;
+	if (!valid)
+	{
+		delete file;
+		return false;
+	}
+
+	//build the skeleton, parents are always earlier in the table so the
+	//table index is also the skeleton index
+	for (uint32_t i = 0; i < header.numLinks; i++)
+	{
+		const MotionCacheLink& l = links[i];
+		char name[MAX_NAME_LEN + 1];
+		memcpy(name, names + l.nameOffset, l.nameLength);
+		name[l.nameLength] = '\0';
+
+		Link* link = skel->NewLink();
+		link->SetName(name);
+		link->SetJointType((int)l.jointType);
+		for (int a = 0; a < 3; a++)
+		{
+			link->SetAxisOrder(a, l.axisOrder[a]);
+		}
+		link->SetParTranslation(l.offset[0], l.offset[1], l.offset[2]);
+		skel->AddToSkeleton(link, l.parent);
+	}
+
+	//the frames are used in place
+	rec->SetFrameTime(header.frameTime);
+	rec->SetNumDOFs(header.numDOFs);
+	rec->AdoptMappedFrames(file, (float*)(data + header.framesOffset), header.numFrames);
+	return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+class Skeleton;
+class AnimRec;
+
+//Binary cache of a parsed bvh file, kept next to it as "<file>.bvhc".
+//
+//The cache holds the skeleton topology (names, offsets, axis orders, joint
+//types) and the AnimRec frames in their in-memory layout, so loading it is a
+//validated mmap with no text parsing.  It remembers the size, modification
+//time and a content hash of the bvh it was built from and is only used while
+//those still match (the hash is only computed when the time differs).
+//
+//File layout (all little endian):
+//   header
+//   one fixed size record per link, in skeleton order (parents first)
+//   link names
+//   padding to 64 bytes
+//   frames, exactly as AnimRec stores them (frame-major, padded stride)
+class MotionCache
+{
+public:
+	MotionCache();
+
+	//Loads bvhFile through its cache if the cache is fresh.  Otherwise parses
+	//the bvh with BVHReader and writes a new cache for next time.
+	//Returns false if the bvh could not be read at all.
+	bool Load(const char* bvhFile, Skeleton* skel, AnimRec* rec, bool inToM);
+
+	//Loads the cache of bvhFile into an empty skeleton and record.
+	//Returns false (leaving both untouched) if there is no fresh, valid cache.
+	bool Read(const char* bvhFile, Skeleton* skel, AnimRec* rec, bool inToM);
+
+	//Writes the cache for a skeleton and record that were parsed from bvhFile
+	bool Write(const char* bvhFile, Skeleton* skel, AnimRec* rec, bool inToM);
+
+	//When disabled Load always parses the bvh and never writes a cache
+	void SetEnabled(bool enabled);
+
+	//true if the last Load was served from the cache
+	bool LoadedFromCache();
+
+	static std::string GetCachePath(const char* bvhFile);
+
+	//64 bit hash used to key the cache to the bvh contents
+	static uint64_t HashBytes(const void* data, size_t size);
+
+private:
+	bool m_enabled;
+	bool m_loadedFromCache;
+};
@@ -1,4 +1,6 @@
 #include <memory>
+#include <string.h>
+#include <math.h>
 #include"MyMath.h"
 #include <assert.h>
 
@@ -0,0 +1,198 @@
+#include "QuatClip.h"
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "AlignedAlloc.h"
+
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QUAT_CLIP_SSE 1
+#include <xmmintrin.h>
+#endif
+
+QuatClip::QuatClip()
+{
+	m_frames = NULL;
+	m_numFrames = 0;
+	m_frameStride = 0;
+	m_poseSize = 0;
+	m_frameTime = 0;
+}
+
+QuatClip::~QuatClip()
+{
+	Release();
+}
+
+void QuatClip::Release()
+{
+	AlignedFree(m_frames);
+	m_frames = NULL;
+	m_numFrames = 0;
+}
+
+void QuatClip::Build(Skeleton* skel, AnimRec* rec)
+{
+	Release();
+	m_numFrames = rec->GetNumFrames();
+	m_frameTime = rec->GetFrameTime();
+	m_poseSize = skel->GetQuatPoseSize();
+	m_frameStride = PadToCacheLine(m_poseSize);
+	if (m_numFrames == 0)
+	{
+		return;
+	}
+	m_frames = (float*)AlignedAlloc((size_t)(m_numFrames + 1) * m_frameStride * sizeof(float));
+
+	for (int f = 0; f < m_numFrames; f++)
+	{
+		float * pose = m_frames + (size_t)f * m_frameStride;
+		skel->EulerToQuatPose(rec->GetFrameData(f), pose);
+		for (int i = m_poseSize; i < m_frameStride; i++) pose[i] = 0;
+		if (f == 0)
+		{
+			continue;
+		}
+
+		//q and -q are the same rotation, keep the one nearer the last frame
+		const float * prev = pose - m_frameStride;
+		for (int q = 4; q < m_poseSize; q += 4)
+		{
+			float dot = prev[q] * pose[q] + prev[q + 1] * pose[q + 1] + prev[q + 2] * pose[q + 2] + prev[q + 3] * pose[q + 3];
+			if (dot < 0)
+			{
+				for (int k = 0; k < 4; k++) pose[q + k] = -pose[q + k];
+			}
+		}
+	}
+	memcpy(m_frames + (size_t)m_numFrames * m_frameStride, m_frames + (size_t)(m_numFrames - 1) * m_frameStride,
+		(size_t)m_frameStride * sizeof(float));
+}
+
+int QuatClip::GetNumFrames()
+{
+	return m_numFrames;
+}
+
+float QuatClip::GetFrameTime()
+{
+	return m_frameTime;
+}
+
+int QuatClip::GetPoseSize()
+{
+	return m_poseSize;
+}
+
+const float * QuatClip::GetFrameData(int index)
+{
+	return m_frames + (size_t)index * m_frameStride;
+}
+
+int QuatClip::GetFrameStride()
+{
+	return m_frameStride;
+}
+
+size_t QuatClip::GetMemoryUsage()
+{
+	return m_frames ? (size_t)(m_numFrames + 1) * m_frameStride * sizeof(float) : 0;
+}
+
+const float * QuatClip::FindFrames(double time, float& weight)
+{
+	double pos = m_frameTime > 0 ? time / m_frameTime : 0;
+	double last = m_numFrames - 1;
+	pos = pos < 0 ? 0 : pos > last ? last : pos;
+	int frame = (int)pos;
+	weight = (float)(pos - frame);
+	return m_frames + (size_t)frame * m_frameStride;
+}
+
+void QuatClip::Sample(double time, float* out)
+{
+	if (m_numFrames == 0)
+	{
+		return;
+	}
+	float weight;
+	const float * a = FindFrames(time, weight);
+	const float * b = a + m_frameStride;
+
+#ifdef QUAT_CLIP_SSE
+	//translation: lerp only
+	__m128 w = _mm_set1_ps(weight);
+	__m128 ta = _mm_load_ps(a);
+	_mm_storeu_ps(out, _mm_add_ps(ta, _mm_mul_ps(w, _mm_sub_ps(_mm_load_ps(b), ta))));
+	for (int q = 4; q < m_poseSize; q += 4)
+	{
+		__m128 qa = _mm_load_ps(a + q);
+		__m128 v = _mm_add_ps(qa, _mm_mul_ps(w, _mm_sub_ps(_mm_load_ps(b + q), qa)));
+		//length in every lane: add the squares pairwise, then the pairs
+		__m128 sq = _mm_mul_ps(v, v);
+		sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 3, 0, 1)));
+		sq = _mm_add_ps(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 0, 3, 2)));
+		//1/sqrt estimate plus one Newton step, about float precision
+		__m128 r = _mm_rsqrt_ps(sq);
+		r = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(0.5f), r), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(sq, _mm_mul_ps(r, r))));
+		_mm_storeu_ps(out + q, _mm_mul_ps(v, r));
+	}
+#else
+	for (int i = 0; i < 3; i++)
+	{
+		out[i] = a[i] + weight * (b[i] - a[i]);
+	}
+	out[3] = 0;
+	for (int q = 4; q < m_poseSize; q += 4)
+	{
+		float v[4], len = 0;
+		for (int k = 0; k < 4; k++)
+		{
+			v[k] = a[q + k] + weight * (b[q + k] - a[q + k]);
+			len += v[k] * v[k];
+		}
+		len = sqrtf(len);
+		for (int k = 0; k < 4; k++) out[q + k] = v[k] / len;
+	}
+#endif
+}
+
+void QuatClip::SampleSlerp(double time, float* out)
+{
+	if (m_numFrames == 0)
+	{
+		return;
+	}
+	float weight;
+	const float * a = FindFrames(time, weight);
+	const float * b = a + m_frameStride;
+
+	for (int i = 0; i < 3; i++)
+	{
+		out[i] = a[i] + weight * (b[i] - a[i]);
+	}
+	out[3] = 0;
+	for (int q = 4; q < m_poseSize; q += 4)
+	{
+		//Build keeps neighbouring frames on the same side, so dot >= 0
+		double dot = a[q] * b[q] + a[q + 1] * b[q + 1] + a[q + 2] * b[q + 2] + a[q + 3] * b[q + 3];
+		double wa = 1.0 - weight, wb = weight;
+		if (dot < 0.9999)
+		{
+			double angle = acos(dot);
+			double s = sin(angle);
+			wa = sin((1.0 - weight) * angle) / s;
+			wb = sin(weight * angle) / s;
+		}
+		double v[4], len = 0;
+		for (int k = 0; k < 4; k++)
+		{
+			v[k] = wa * a[q + k] + wb * b[q + k];
+			len += v[k] * v[k];
+		}
+		//only rounding to take out, or the lerp's shortening for near frames
+		len = sqrt(len);
+		for (int k = 0; k < 4; k++) out[q + k] = (float)(v[k] / len);
+	}
+}
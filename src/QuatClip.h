@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+
+class Skeleton;
+class AnimRec;
+
+//A clip stored as quaternion poses (see Skeleton::GetQuatPoseSize) instead
+//of Euler angles.  Every rotation channel triple is turned into a unit
+//quaternion once, with the joint's own axis order, and each quaternion is
+//flipped to the same side as the one in the frame before, so blending two
+//frames never goes the long way round and needs no per joint checks.
+//Feed the samples to Skeleton::ComputePoseQuat.
+class QuatClip
+{
+public:
+	QuatClip();
+	~QuatClip();
+
+	//converts every frame of rec, which belongs to skel
+	void Build(Skeleton* skel, AnimRec* rec);
+
+	int GetNumFrames();
+	float GetFrameTime();
+	//floats in one pose, same as the skeleton's GetQuatPoseSize
+	int GetPoseSize();
+	//pose of frame index.  Frame index+1 starts GetFrameStride() floats later.
+	const float* GetFrameData(int index);
+	int GetFrameStride();
+
+	//Writes the pose at time seconds (clamped to the clip) into out,
+	//GetPoseSize() floats.  Sample blends the two frames around it with a
+	//normalized lerp: a few multiply-adds and one reciprocal square root per
+	//joint, 4 floats at a time.  SampleSlerp follows the arc exactly, at the
+	//cost of an acos and three sines per joint.
+	void Sample(double time, float* out);
+	void SampleSlerp(double time, float* out);
+
+	//bytes of pose storage held
+	size_t GetMemoryUsage();
+
+private:
+	QuatClip(const QuatClip&);
+	QuatClip& operator=(const QuatClip&);
+
+	void Release();
+	//first of the two frames around time and the weight of the second
+	const float* FindFrames(double time, float& weight);
+
+	//m_numFrames + 1 frames of m_frameStride floats, cache line aligned.
+	//The last frame is repeated so frame f + 1 always exists.
+	float* m_frames;
+	int m_numFrames;
+	int m_frameStride;
+	int m_poseSize;
+	float m_frameTime;
+};
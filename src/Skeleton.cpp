@@ -3,24 +3,51 @@
 #include <string.h>
 #include <iostream>
 #include "BVHReader.h"
+#include "MotionCache.h"
+#include "AlignedAlloc.h"
+#include "BatchFK.h"
+#include "AnimRec.h"
+#include "ThreadPool.h"
+#include "Trace.h"
 #include <assert.h>
+#include <math.h>
 
 Skeleton::Skeleton()
 {
+	m_pSkelRoot = NULL;
 	m_linkCnt = 0;
+	m_numNames = 0;
+	m_evalDirty = true;
+	m_worldMats = NULL;
+	m_boneGeom = NULL;
+	m_boneMats = NULL;
+	m_boneMatCnt = 0;
 }
 Skeleton::~Skeleton()
 {
+	AlignedFree(m_worldMats);
+	//m_arena's destructor runs the links' destructors and frees them along
+	//with the geometry
+}
 
+Link* Skeleton::NewLink()
+{
+	return m_arena.New<Link>();
+}
+
+const ArenaStats& Skeleton::GetMemoryStats()
+{
+	return m_arena.GetStats();
 }
 
 
 void Skeleton::CreateSkeletonFromBVH(char* filename, AnimRec* pAnimRec, bool inToM)//, CKinSkeleton * skel)
 {
-	BVHReader parser;
-	//load the bvh
-	std::ifstream file(filename);
-	parser.BuildSkelFromHeader(file, this, pAnimRec, inToM);
+	//load the bvh.  A fresh binary cache next to the file is mapped directly,
+	//otherwise the file is memory mapped and parsed in place and the cache is
+	//written for next time.
+	MotionCache cache;
+	cache.Load(filename, this, pAnimRec, inToM);
 
 }
 
@@ -32,7 +59,22 @@ void Skeleton::CreateSkeletonFromBVH(char* filename, AnimRec* pAnimRec, bool inT
 //access links to set their state, for instance
 bool Skeleton::AddToSkeleton(Link* addMe, char* parentName)
 {
-	if (strcmp(parentName, "$ground") == 0)
+	int parentIndex = -1;
+	if (strcmp(parentName, "$ground") != 0)
+	{
+		parentIndex = FindJointIndex(parentName);
+		if (parentIndex < 0)
+		{
+			std::cerr << "failed to find the parent, so could not add node to skeleton" << std::endl;
+			return false;
+		}
+	}
+	return AddToSkeleton(addMe, parentIndex) >= 0;
+}
+
+int Skeleton::AddToSkeleton(Link* addMe, int parentIndex)
+{
+	if (parentIndex < 0)
 	{
 		if (m_pSkelRoot)
 		{
@@ -43,26 +85,91 @@ bool Skeleton::AddToSkeleton(Link* addMe, char* parentName)
 	}
 	else
 	{
-		Link* par = FindNode(parentName, m_pSkelRoot);
-		if (par)
-		{
-			par->AddChild(addMe);
+		assert(parentIndex < m_linkCnt);
+		m_linkArray[parentIndex]->AddChild(addMe);
+	}
 
-		}
-		else
-		{
-			std::cerr << "failed to find the parent, so could not add node to skeleton" << std::endl;
-			return false;
-		}
+	//add link to array
+	int index = m_linkCnt;
+	m_linkArray.push_back(addMe);
+	m_linkParent.push_back(parentIndex);
+	m_linkCnt++;
+	m_evalDirty = true;
+	InsertName(index);
 
+	return index;
+}
+
+//FNV-1a
+uint32_t Skeleton::HashName(const char* name, size_t length)
+{
+	uint32_t h = 2166136261u;
+	for (size_t i = 0; i < length; i++)
+	{
+		h = (h ^ (unsigned char)name[i]) * 16777619u;
 	}
+	return h;
+}
 
+void Skeleton::InsertName(int index)
+{
+	const char* name = m_linkArray[index]->GetName();
+	size_t length = strlen(name);
+	if (length == 0 || FindJointIndex(std::string_view(name, length)) >= 0)
+	{
+		//unnamed, or a later link with the same name as an earlier one
+		return;
+	}
 
-	//add link to array
-	m_linkArray[m_linkCnt] = addMe;
-	m_linkCnt++;
+	if ((m_numNames + 1) * 2 > (int)m_nameTable.size())
+	{
+		//rehash everything into a table twice the size
+		size_t size = m_nameTable.empty() ? 64 : m_nameTable.size() * 2;
+		std::vector<NameSlot> old;
+		old.swap(m_nameTable);
+		NameSlot empty = { 0, -1 };
+		m_nameTable.assign(size, empty);
+		for (size_t i = 0; i < old.size(); i++)
+		{
+			if (old[i].index >= 0)
+			{
+				size_t slot = old[i].hash & (size - 1);
+				while (m_nameTable[slot].index >= 0) slot = (slot + 1) & (size - 1);
+				m_nameTable[slot] = old[i];
+			}
+		}
+	}
 
-	return true;
+	uint32_t hash = HashName(name, length);
+	size_t mask = m_nameTable.size() - 1;
+	size_t slot = hash & mask;
+	while (m_nameTable[slot].index >= 0) slot = (slot + 1) & mask;
+	m_nameTable[slot].hash = hash;
+	m_nameTable[slot].index = index;
+	m_numNames++;
+}
+
+int Skeleton::FindJointIndex(std::string_view name)
+{
+	if (m_nameTable.empty())
+	{
+		return -1;
+	}
+	uint32_t hash = HashName(name.data(), name.size());
+	size_t mask = m_nameTable.size() - 1;
+	for (size_t slot = hash & mask; m_nameTable[slot].index >= 0; slot = (slot + 1) & mask)
+	{
+		const NameSlot& s = m_nameTable[slot];
+		if (s.hash == hash)
+		{
+			const char* linkName = m_linkArray[s.index]->GetName();
+			if (strncmp(linkName, name.data(), name.size()) == 0 && linkName[name.size()] == '\0')
+			{
+				return s.index;
+			}
+		}
+	}
+	return -1;
 }
 
 
@@ -81,32 +188,18 @@ Link* Skeleton::FindNode(char* name, Link* curNode)
 		//recurse on each of the children until we find the desired node
 		//or exhaust the tree
 
-		int childCnt = 0;
-		Link* link;
-		while (childCnt < KL_MAX_CHILDREN)
+		for (Link* child = curNode->GetChild(0); child; child = child->GetNextSibling())
 		{
-			link = curNode->GetChild(childCnt);
-			if (link == NULL)
-			{
-				//there are no more children to search, so return NULL
-				return NULL;
-			}
-			else
-			{
-				//recurse on the child
-				link = FindNode(name, link);
-
-				//if we found the node, we are done
-				if (link)
-				{
-					return link;
-				}
+			//recurse on the child
+			Link* link = FindNode(name, child);
 
-				//othewise, we will progress through the rest of the children
-				childCnt++;
+			//if we found the node, we are done
+			if (link)
+			{
+				return link;
 			}
 
-
+			//othewise, we will progress through the rest of the children
 		}
 		return NULL; //no child contained node
 	}
@@ -181,17 +274,343 @@ void Skeleton::SetSkelState(double* state)
 
 }
 
+int Skeleton::GetNumLinks()
+{
+	return m_linkCnt;
+}
+
+Link* Skeleton::GetLink(int index)
+{
+	assert(index >= 0 && index < m_linkCnt);
+	return m_linkArray[index];
+}
+
 void Skeleton::CalcVertexLocations(int maxEntries, int* curLocation, VERTEX** outCoords)
 {
+	TRACE_SCOPE("CalcVertexLocations");
 	m_pSkelRoot->CalcVertexLocations(maxEntries, curLocation, outCoords);
 }
+int Skeleton::GetNumVertices()
+{
+	return 12 * m_linkCnt;
+}
 void Skeleton::AddGeometry()
 {
-	m_pSkelRoot->CalcParentGeomAndRecurse();
+	m_boneGeom = m_arena.AllocArray<VERTEX>(GetNumVertices());
+	m_boneMats = (mat4x4*)m_arena.Alloc(sizeof(mat4x4) * m_linkCnt, CACHE_LINE_SIZE);
+	m_boneMatCnt = m_linkCnt;
+	for (int i = 0; i < m_linkCnt; i++)
+	{
+		m_linkArray[i]->CalcParentGeom(&m_boneGeom[i * 12]);
+		m_linkArray[i]->CalcBoneMatrix(m_boneMats[i]);
+	}
 }
 void Skeleton::UpdateLinks()
 {
+	TRACE_SCOPE("UpdateLinks");
 	//Start at the root and have the skeleton update itself recursively
 	m_pSkelRoot->UpdateAndRecurse(this);
 
 }
+
+//Walks the links in the same order as SetSkelState to find where each joint's
+//values sit in a frame
+void Skeleton::BuildEvalData()
+{
+	m_jointParent.assign(m_linkCnt, -1);
+	m_jointOffset.assign(m_linkCnt * 3, 0.0f);
+	m_jointAxisOrder.assign(m_linkCnt * 3, X_AXIS);
+	m_jointNumRotations.assign(m_linkCnt, 0);
+	m_jointRotDOF.assign(m_linkCnt, 0);
+	m_jointTransDOF.assign(m_linkCnt, -1);
+	m_jointRotKernel.assign(m_linkCnt, (EulerKernel)NULL);
+
+	int stateCnt = 0;
+	for (int i = 0; i < m_linkCnt; i++)
+	{
+		Link* link = m_linkArray[i];
+		m_jointParent[i] = m_linkParent[i];
+
+		double v[3];
+		link->GetParTranslation(v);
+		for (int a = 0; a < 3; a++)
+		{
+			m_jointOffset[i * 3 + a] = (float)v[a];
+			m_jointAxisOrder[i * 3 + a] = link->GetAxisOrder(a);
+		}
+
+		int jntType = link->GetJointType();
+		if (jntType == J_FREE || jntType == J_EULER_SIX)
+		{
+			//translation followed by the rotation, only used for the root
+			m_jointTransDOF[i] = 0;
+			m_jointRotDOF[i] = 3;
+			m_jointNumRotations[i] = link->GetNumRotations();
+			stateCnt += 6;
+		}
+		else if (jntType == J_GIMBAL || jntType == J_PIN || jntType == J_BALL
+			|| jntType == J_UNIVERSAL)
+		{
+			m_jointRotDOF[i] = stateCnt;
+			m_jointNumRotations[i] = link->GetNumRotations();
+			stateCnt += link->GetNumRotations();
+		}
+		m_jointRotKernel[i] = GetEulerKernel(m_jointNumRotations[i], &m_jointAxisOrder[i * 3]);
+	}
+
+	AlignedFree(m_worldMats);
+	m_worldMats = (mat4x4*)AlignedAlloc(sizeof(mat4x4) * (m_linkCnt > 0 ? m_linkCnt : 1), CACHE_LINE_SIZE);
+	m_evalDirty = false;
+}
+
+//out = a * b for matrices whose last row is 0 0 0 1.  Leaves out the terms
+//that are known to be 0 or 1 and otherwise adds in the same order as
+//mat4x4_mul, so the result is the same.
+static inline void MulAffine(mat4x4 out, const mat4x4 a, const mat4x4 b)
+{
+	for (int c = 0; c < 3; c++)
+	{
+		for (int r = 0; r < 3; r++)
+		{
+			out[c][r] = a[0][r] * b[c][0] + a[1][r] * b[c][1] + a[2][r] * b[c][2];
+		}
+		out[c][3] = 0.0f;
+	}
+	for (int r = 0; r < 3; r++)
+	{
+		out[3][r] = a[0][r] * b[3][0] + a[1][r] * b[3][1] + a[2][r] * b[3][2] + a[3][r];
+	}
+	out[3][3] = 1.0f;
+}
+
+void Skeleton::ComputePose(const float* frame)
+{
+	if (m_evalDirty)
+	{
+		BuildEvalData();
+	}
+	ComputePoseInto(frame, m_worldMats);
+}
+
+void Skeleton::ComputePoseInto(const float* frame, mat4x4* world)
+{
+	if (m_linkCnt == 0)
+	{
+		return;
+	}
+
+	//the root is only translated, as in Link::UpdateAndRecurse
+	const float* t = m_jointTransDOF[0] >= 0 ? &frame[m_jointTransDOF[0]] : &m_jointOffset[0];
+	mat4x4_translate(world[0], t[0], t[1], t[2]);
+
+	for (int i = 1; i < m_linkCnt; i++)
+	{
+		//local = translate(offset) * R0 * R1 * R2.  The translation only fills
+		//the last column, so it is written in directly instead of multiplied.
+		mat4x4 local;
+		m_jointRotKernel[i](&frame[m_jointRotDOF[i]], local);
+		const float* offset = &m_jointOffset[i * 3];
+		local[3][0] = offset[0];
+		local[3][1] = offset[1];
+		local[3][2] = offset[2];
+
+		MulAffine(world[i], world[m_jointParent[i]], local);
+	}
+}
+
+int Skeleton::GetQuatPoseSize()
+{
+	return 4 + 4 * m_linkCnt;
+}
+
+void Skeleton::EulerToQuatPose(const float* frame, float* pose)
+{
+	if (m_evalDirty)
+	{
+		BuildEvalData();
+	}
+	if (m_linkCnt == 0)
+	{
+		return;
+	}
+	const float* t = m_jointTransDOF[0] >= 0 ? &frame[m_jointTransDOF[0]] : &m_jointOffset[0];
+	pose[0] = t[0];
+	pose[1] = t[1];
+	pose[2] = t[2];
+	pose[3] = 0.0f;
+
+	//R0 * R1 * R2 is the quaternion product q0 * q1 * q2
+	for (int i = 0; i < m_linkCnt; i++)
+	{
+		quat q;
+		quat_identity(q);
+		for (int r = 0; r < m_jointNumRotations[i]; r++)
+		{
+			double half = 0.5 * frame[m_jointRotDOF[i] + r];
+			quat axis = { 0.0f, 0.0f, 0.0f, (float)cos(half) };
+			axis[m_jointAxisOrder[i * 3 + r]] = (float)sin(half);
+			quat prod;
+			quat_mul(prod, q, axis);
+			memcpy(q, prod, sizeof(quat));
+		}
+		memcpy(&pose[4 + i * 4], q, sizeof(quat));
+	}
+}
+
+void Skeleton::ComputePoseQuat(const float* pose)
+{
+	if (m_evalDirty)
+	{
+		BuildEvalData();
+	}
+	if (m_linkCnt == 0)
+	{
+		return;
+	}
+	mat4x4* world = m_worldMats;
+	mat4x4_translate(world[0], pose[0], pose[1], pose[2]);
+	for (int i = 1; i < m_linkCnt; i++)
+	{
+		mat4x4 local;
+		mat4x4_from_quat(local, (float*)&pose[4 + i * 4]);
+		const float* offset = &m_jointOffset[i * 3];
+		local[3][0] = offset[0];
+		local[3][1] = offset[1];
+		local[3][2] = offset[2];
+
+		MulAffine(world[i], world[m_jointParent[i]], local);
+	}
+}
+
+void Skeleton::SetSkelStateQuat(const float* pose)
+{
+	if (m_linkCnt == 0)
+	{
+		return;
+	}
+	//the root only moves, as in SetSkelState
+	m_linkArray[0]->SetParTranslation(pose[0], pose[1], pose[2]);
+	for (int i = 0; i < m_linkCnt; i++)
+	{
+		m_linkArray[i]->SetRotation(&pose[4 + i * 4]);
+	}
+}
+
+void Skeleton::ComputePoses(const float* const* frames, int numPoses, mat4x4* out, int isa)
+{
+	TRACE_SCOPE("ComputePoses");
+	if (m_evalDirty)
+	{
+		BuildEvalData();
+	}
+	if (isa == FK_AUTO)
+	{
+		isa = GetBestFKInstructionSet();
+	}
+
+	BatchFKJoints joints;
+	joints.numJoints = m_linkCnt;
+	joints.parent = m_jointParent.data();
+	joints.offset = m_jointOffset.data();
+	joints.axisOrder = m_jointAxisOrder.data();
+	joints.numRotations = m_jointNumRotations.data();
+	joints.rotDOF = m_jointRotDOF.data();
+	joints.transDOF = m_jointTransDOF.data();
+
+	int done = 0;
+	if (isa == FK_AVX2 && BatchFKHasAVX2())
+	{
+		done = BatchFKAVX2(joints, frames, numPoses, out);
+	}
+	else if (isa >= FK_SSE && BatchFKHasSSE())
+	{
+		done = BatchFKSSE(joints, frames, numPoses, out);
+	}
+	for (int p = done; p < numPoses; p++)
+	{
+		ComputePoseInto(frames[p], out + p * m_linkCnt);
+	}
+}
+
+int Skeleton::GetBestFKInstructionSet()
+{
+	static const int best = BatchFKHasAVX2() ? FK_AVX2 : BatchFKHasSSE() ? FK_SSE : FK_SCALAR;
+	return best;
+}
+
+//frames per BakeClip task, a multiple of the widest SIMD batch so every
+//block but the last runs full batches
+#define BAKE_BLOCK_FRAMES 64
+
+void Skeleton::BakeClip(AnimRec* rec, mat4x4* out, ThreadPool* pool)
+{
+	//build the shared arrays before any thread reads them
+	if (m_evalDirty)
+	{
+		BuildEvalData();
+	}
+	if (pool == NULL)
+	{
+		pool = &ThreadPool::Shared();
+	}
+
+	int numFrames = rec->GetNumFrames();
+	int numBlocks = (numFrames + BAKE_BLOCK_FRAMES - 1) / BAKE_BLOCK_FRAMES;
+	std::vector<std::vector<const float*> > scratch(pool->GetNumThreads());
+
+	pool->RunWithThreadIndex(numBlocks, [&](int block, int thread)
+	{
+		int first = block * BAKE_BLOCK_FRAMES;
+		int count = numFrames - first < BAKE_BLOCK_FRAMES ? numFrames - first : BAKE_BLOCK_FRAMES;
+
+		std::vector<const float*>& frames = scratch[thread];
+		frames.resize(count);
+		for (int i = 0; i < count; i++)
+		{
+			frames[i] = rec->GetFrameData(first + i);
+		}
+		ComputePoses(frames.data(), count, out + (size_t)first * m_linkCnt);
+	});
+}
+
+int Skeleton::GetNumBones()
+{
+	return m_linkCnt > 0 ? m_linkCnt - 1 : 0;
+}
+
+void Skeleton::CalcBoneInstances(const mat4x4* world, mat4x4* out)
+{
+	if (m_evalDirty)
+	{
+		BuildEvalData();
+	}
+	assert(m_boneMatCnt == m_linkCnt);
+	//a bone sits in its parent's frame, as in Link::CalcVertexLocations
+	for (int i = 1; i < m_linkCnt; i++)
+	{
+		MulAffine(out[i - 1], world[m_jointParent[i]], m_boneMats[i]);
+	}
+}
+
+const mat4x4* Skeleton::GetWorldMatrices()
+{
+	return m_worldMats;
+}
+
+void Skeleton::PrepareForSharing()
+{
+	if (m_evalDirty)
+	{
+		BuildEvalData();
+	}
+}
+
+int Skeleton::GetJointParent(int joint)
+{
+	if (m_evalDirty)
+	{
+		BuildEvalData();
+	}
+	assert(joint >= 0 && joint < m_linkCnt);
+	return m_jointParent[joint];
+}
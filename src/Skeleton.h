@@ -1,40 +1,145 @@
 #pragma once
 
 #include "defs.h"
-
-#define MAX_NUM_LINKS 100
+#include "linmath.h"
+#include "EulerKernels.h"
+#include "Arena.h"
+#include <vector>
+#include <string_view>
+#include <stdint.h>
+
+//instruction sets Skeleton::ComputePoses can use
+#define FK_AUTO -1
+#define FK_SCALAR 0
+#define FK_SSE 1
+#define FK_AVX2 2
 
 class Link;
 class AnimRec;
+class ThreadPool;
 
 class Skeleton
 {
 public:
+	//Returns a new, blank link owned by the skeleton, to be set up and passed
+	//to AddToSkeleton.  Links come from the skeleton's arena rather than being
+	//allocated one by one, and are freed with the skeleton.  Links made with
+	//new and added directly still belong to the caller.
+	Link* NewLink();
+
 	//adds link addMe to the tree that defines the skeleton such that its
 	//parent in the tree is called parentName.  Note:  $ground is the parent
 	//of the root node.
 	//Returns true if node can be added, false otherwise
 	bool AddToSkeleton(Link* addMe, char* parentName);
 
+	//Same as above with the parent given by its index (GetLink order), -1 for
+	//the root.  Returns the index of addMe, or -1 if it could not be added.
+	//Loaders that know the parent (e.g. from their own nesting) use this and
+	//skip the name lookup.
+	int AddToSkeleton(Link* addMe, int parentIndex);
+
 	//Searches the tree for a node with the given name
 	//Returns a pointer to the node if it finds it, otherwise returns null
 	//The search is started at curNode
 	Link* FindNode(char* name, Link* curNode);
 
+	//Index of the link called name (the first one added if several share it),
+	//-1 if there is none.  Uses a hash table kept up to date by AddToSkeleton,
+	//so it is constant time.  Unnamed links (end sites) can't be found.
+	int FindJointIndex(std::string_view name);
+
 	//Create a skeleton based on the pre-amble of a bvh file
 	void CreateSkeletonFromBVH(char* filename, AnimRec* pAnimRec, bool inToM);
 
 	void SetSkelState(double* state);
 
+	//number of links (including end sites) in the skeleton
+	int GetNumLinks();
+	//links in the order they were added, parents always come before children
+	Link* GetLink(int index);
+
 	//maxEntries is the number of values that you can put in the outCoords array
 	//curLocation is the next empty location where you can start adding
 	void CalcVertexLocations(int maxEntries, int* curLocation, VERTEX** outCoords);
+	//number of vertices CalcVertexLocations writes, 12 per link
+	int GetNumVertices();
 
 	//recalculate all the transformations with the current joint data
 	void UpdateLinks();
 
+	//Computes the local to world matrix of every joint for one frame of motion
+	//(laid out like AnimRec::GetFrameData) into one contiguous array.  This runs
+	//a single loop over the flattened joint arrays below instead of recursing
+	//through the links, and gives the same matrices as SetSkelState followed
+	//by UpdateLinks.  The links themselves are not touched.
+	void ComputePose(const float* frame);
+
+	//one matrix per link (same index as GetLink), from the last ComputePose
+	const mat4x4* GetWorldMatrices();
+
+	//Quaternion poses (see QuatClip): the root translation x y z and one
+	//unused float, then the rotation of every link (GetLink order) as a unit
+	//quaternion x y z w.  GetQuatPoseSize() floats in all.
+	int GetQuatPoseSize();
+	//converts a frame of Euler angles (laid out like AnimRec::GetFrameData)
+	//to a quaternion pose, using each joint's axis order
+	void EulerToQuatPose(const float* frame, float* pose);
+	//ComputePose for a quaternion pose, each joint's rotation taken straight
+	//from its quaternion
+	void ComputePoseQuat(const float* pose);
+	//SetSkelState for a quaternion pose, for the links' own UpdateLinks
+	void SetSkelStateQuat(const float* pose);
+
+	//Computes the world matrices of many poses at once, for baking a whole
+	//clip or posing a crowd that shares this skeleton.  frames[p] is laid out
+	//like AnimRec::GetFrameData and the matrices of pose p go to
+	//out[p * GetNumLinks() + link].
+	//Poses are evaluated 4 (SSE) or 8 (AVX2) at a time with one pose per SIMD
+	//lane, the leftovers with the scalar loop.  The SIMD paths use a polynomial
+	//sine and cosine, so they agree with ComputePose to a few ulp, not bit for
+	//bit.  isa picks the path, FK_AUTO the widest one this CPU can run.
+	void ComputePoses(const float* const* frames, int numPoses, mat4x4* out, int isa = FK_AUTO);
+
+	//the widest FK_ instruction set this build and CPU support
+	static int GetBestFKInstructionSet();
+
+	//Computes the world matrix of every joint for every frame of rec, frame f
+	//joint j going to out[f * GetNumLinks() + j].  The clip is cut into blocks
+	//of frames that the threads of pool (the shared pool if NULL) take and
+	//steal from each other; each block goes through ComputePoses using the
+	//running thread's own scratch.  The result doesn't depend on the number
+	//of threads.
+	void BakeClip(AnimRec* rec, mat4x4* out, ThreadPool* pool = NULL);
+
+	//parent of a joint in the flattened arrays, -1 for the root
+	int GetJointParent(int joint);
+
+	//The flattened arrays are the rig definition every pose is computed
+	//from.  They are built on first use after links are added; this builds
+	//them now, so that afterwards ComputePoses, CalcBoneInstances and
+	//GetJointParent only read the skeleton and any number of threads can
+	//pose it at once (see Crowd).
+	void PrepareForSharing();
+
+	//builds the bone geometry of every link into one array owned by the
+	//skeleton, and the bone matrices for CalcBoneInstances.  Call again after
+	//adding links; the arrays it replaces stay in the arena until the
+	//skeleton goes away.
 	void AddGeometry();
 
+	//Instanced drawing: every bone (one per link except the root, as drawn by
+	//the player) is Link::MakeBonePyramid(1, mesh) transformed by its instance
+	//matrix.  CalcBoneInstances writes the GetNumBones() instance matrices for
+	//the world matrices world (e.g. GetWorldMatrices after ComputePose), bone
+	//b belonging to link b + 1.  Needs AddGeometry.
+	int GetNumBones();
+	void CalcBoneInstances(const mat4x4* world, mat4x4* out);
+
+	//Allocations behind the links and bone geometry, which all come from one
+	//arena per skeleton and are released together by the destructor
+	const ArenaStats& GetMemoryStats();
+
 	Skeleton();
 	~Skeleton();
 
@@ -44,12 +149,62 @@ private:
 
 	//an array of all the links that make up the skeleton.
 	//These are added as they are added to the skeleton.
-	Link* m_linkArray[MAX_NUM_LINKS];
-//DO I NEED THIS?
+	std::vector<Link*> m_linkArray;
 
 	//number of links in array
 	int m_linkCnt;
 
+	//storage for NewLink and AddGeometry.  Its blocks double in size, so a
+	//rig of n links takes about log2(n) allocations.
+	Arena m_arena;
+
+	//bone geometry for all links, 12 vertices each in link order, in m_arena
+	VERTEX* m_boneGeom;
+	//unit pyramid to bone in the parent frame, one per link (m_boneMatCnt
+	//of them, cache line aligned, in m_arena)
+	mat4x4* m_boneMats;
+	int m_boneMatCnt;
+
+	//parent index of every link, -1 for the root
+	std::vector<int> m_linkParent;
+
+	//open addressing hash table of the named links, linear probing.
+	//Its size is a power of two, an index of -1 marks an empty slot.
+	struct NameSlot
+	{
+		uint32_t hash;
+		int index;
+	};
+	std::vector<NameSlot> m_nameTable;
+	int m_numNames;
+
+	//adds m_linkArray[index] to m_nameTable, growing it when it gets half full
+	void InsertName(int index);
+	static uint32_t HashName(const char* name, size_t length);
+
+	//(re)builds the flattened arrays from the links
+	void BuildEvalData();
+	//ComputePose writing into world instead of m_worldMats
+	void ComputePoseInto(const float* frame, mat4x4* world);
+
+	//Flattened copy of the tree used by ComputePose, one entry per link in
+	//m_linkArray order.  Links are only ever added below an existing parent,
+	//so every parent precedes its children.
+	bool m_evalDirty;
+	std::vector<int> m_jointParent;
+	//parent translation, x y z per joint
+	std::vector<float> m_jointOffset;
+	//axis of each rotation in the order they are applied, 3 per joint
+	std::vector<int> m_jointAxisOrder;
+	std::vector<int> m_jointNumRotations;
+	//rotation kernel for the joint's axis order, resolved when the arrays are built
+	std::vector<EulerKernel> m_jointRotKernel;
+	//where the joint's rotations start in a frame (unused if it has none)
+	std::vector<int> m_jointRotDOF;
+	//where the joint's translation starts in a frame, -1 to use the offset
+	std::vector<int> m_jointTransDOF;
+	//m_linkCnt matrices, cache line aligned
+	mat4x4* m_worldMats;
 
 };
 
@@ -0,0 +1,143 @@
+#include "SoftRaster.h"
+#include <math.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+SoftRaster::SoftRaster(int width, int height)
+{
+	m_width = width > 0 ? width : 1;
+	m_height = height > 0 ? height : 1;
+	m_pixels.assign((size_t)m_width * m_height * 3, 0);
+	m_depth.assign((size_t)m_width * m_height, 1.0f);
+	SetViewport(0, 0, m_width, m_height);
+}
+
+int SoftRaster::GetWidth()
+{
+	return m_width;
+}
+
+int SoftRaster::GetHeight()
+{
+	return m_height;
+}
+
+const unsigned char* SoftRaster::GetPixels()
+{
+	return m_pixels.data();
+}
+
+void SoftRaster::Clear(unsigned char r, unsigned char g, unsigned char b)
+{
+	for (size_t i = 0; i < m_pixels.size(); i += 3)
+	{
+		m_pixels[i] = r;
+		m_pixels[i + 1] = g;
+		m_pixels[i + 2] = b;
+	}
+	m_depth.assign(m_depth.size(), 1.0f);
+}
+
+void SoftRaster::SetViewport(int x, int y, int width, int height)
+{
+	m_viewX = x;
+	m_viewY = y;
+	m_viewWidth = width;
+	m_viewHeight = height;
+}
+
+void SoftRaster::DrawTriangles(const VERTEX* verts, int count, const mat4x4 mvp)
+{
+	for (int i = 0; i + 2 < count; i += 3)
+	{
+		//clip space to window space.  Orthographic views keep w at 1, anything
+		//reaching behind the eye is dropped rather than clipped.
+		float win[3][3];
+		bool visible = true;
+		for (int k = 0; k < 3 && visible; k++)
+		{
+			const VERTEX& v = verts[i + k];
+			vec4 in = { v.x, v.y, v.z, 1.0f };
+			vec4 clip;
+			mat4x4_mul_vec4(clip, (vec4*)mvp, in);
+			visible = clip[3] > 1e-6f;
+			float invW = 1.0f / clip[3];
+			win[k][0] = m_viewX + (clip[0] * invW * 0.5f + 0.5f) * m_viewWidth;
+			win[k][1] = m_viewY + (0.5f - clip[1] * invW * 0.5f) * m_viewHeight;
+			win[k][2] = clip[2] * invW * 0.5f + 0.5f;
+		}
+		if (visible)
+		{
+			DrawTriangle(win[0], win[1], win[2], verts[i], verts[i + 1], verts[i + 2]);
+		}
+	}
+}
+
+static inline float Edge(const float* a, const float* b, float x, float y)
+{
+	return (b[0] - a[0]) * (y - a[1]) - (b[1] - a[1]) * (x - a[0]);
+}
+
+static inline unsigned char ToByte(float c)
+{
+	c = c < 0.0f ? 0.0f : (c > 1.0f ? 1.0f : c);
+	return (unsigned char)(c * 255.0f + 0.5f);
+}
+
+void SoftRaster::DrawTriangle(const float* p0, const float* p1, const float* p2, const VERTEX& v0, const VERTEX& v1, const VERTEX& v2)
+{
+	float area = Edge(p0, p1, p2[0], p2[1]);
+	if (fabsf(area) < 1e-12f)
+	{
+		return;
+	}
+	float invArea = 1.0f / area;
+
+	//bounding box, clamped to the viewport and the image
+	int minX = (int)floorf(fminf(p0[0], fminf(p1[0], p2[0])));
+	int maxX = (int)ceilf(fmaxf(p0[0], fmaxf(p1[0], p2[0])));
+	int minY = (int)floorf(fminf(p0[1], fminf(p1[1], p2[1])));
+	int maxY = (int)ceilf(fmaxf(p0[1], fmaxf(p1[1], p2[1])));
+	int left = m_viewX > 0 ? m_viewX : 0;
+	int top = m_viewY > 0 ? m_viewY : 0;
+	int right = m_viewX + m_viewWidth < m_width ? m_viewX + m_viewWidth : m_width;
+	int bottom = m_viewY + m_viewHeight < m_height ? m_viewY + m_viewHeight : m_height;
+	minX = minX > left ? minX : left;
+	minY = minY > top ? minY : top;
+	maxX = maxX < right ? maxX : right;
+	maxY = maxY < bottom ? maxY : bottom;
+
+	for (int y = minY; y < maxY; y++)
+	{
+		float py = y + 0.5f;
+		for (int x = minX; x < maxX; x++)
+		{
+			//sample at the pixel centre, either winding is drawn
+			float px = x + 0.5f;
+			float w0 = Edge(p1, p2, px, py) * invArea;
+			float w1 = Edge(p2, p0, px, py) * invArea;
+			float w2 = Edge(p0, p1, px, py) * invArea;
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+			{
+				continue;
+			}
+			float z = w0 * p0[2] + w1 * p1[2] + w2 * p2[2];
+			size_t index = (size_t)y * m_width + x;
+			if (z < 0.0f || z >= m_depth[index])
+			{
+				continue;
+			}
+			m_depth[index] = z;
+			unsigned char* rgb = &m_pixels[index * 3];
+			rgb[0] = ToByte(w0 * v0.r + w1 * v1.r + w2 * v2.r);
+			rgb[1] = ToByte(w0 * v0.g + w1 * v1.g + w2 * v2.g);
+			rgb[2] = ToByte(w0 * v0.b + w1 * v1.b + w2 * v2.b);
+		}
+	}
+}
+
+bool SoftRaster::WritePNG(const char* filename)
+{
+	return stbi_write_png(filename, m_width, m_height, 3, m_pixels.data(), m_width * 3) != 0;
+}
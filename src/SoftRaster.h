@@ -0,0 +1,41 @@
+#pragma once
+
+#include "defs.h"
+#include "linmath.h"
+#include <vector>
+
+//Small CPU triangle rasterizer for rendering without a display or GPU.
+//Draws VERTEX triangles the way the player's shaders do (position times
+//mvp, colour interpolated across the triangle) into an RGB image with a
+//depth buffer, and writes the image out as a PNG.
+class SoftRaster
+{
+public:
+	SoftRaster(int width, int height);
+
+	int GetWidth();
+	int GetHeight();
+	//width * height * 3 bytes, top row first
+	const unsigned char* GetPixels();
+
+	void Clear(unsigned char r, unsigned char g, unsigned char b);
+
+	//Draws count / 3 triangles.  Only the part of the image inside the
+	//viewport (x, y, width, height in pixels, y down) is touched, so several
+	//views can share one image, e.g. the cells of a contact sheet.
+	void SetViewport(int x, int y, int width, int height);
+	void DrawTriangles(const VERTEX* verts, int count, const mat4x4 mvp);
+
+	//Returns false if the file could not be written
+	bool WritePNG(const char* filename);
+
+private:
+	void DrawTriangle(const float* p0, const float* p1, const float* p2, const VERTEX& v0, const VERTEX& v1, const VERTEX& v2);
+
+	int m_width;
+	int m_height;
+	int m_viewX, m_viewY, m_viewWidth, m_viewHeight;
+	std::vector<unsigned char> m_pixels;
+	//window space depth, 0 near to 1 far
+	std::vector<float> m_depth;
+};
@@ -0,0 +1,231 @@
+#include "StreamBuffer.h"
+#include <string.h>
+
+//GL 4.4 names missing from the 3.3 glad header
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+typedef void (GLAD_API_PTR *BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+static BufferStorageProc s_bufferStorage = NULL;
+
+//region offsets stay aligned for any attribute or uniform buffer use
+#define STREAM_REGION_ALIGN 256
+
+void StreamBuffer::LoadBufferStorage(GLADloadfunc load)
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool supported = major > 4 || (major == 4 && minor >= 4);
+
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions && !supported; i++)
+	{
+		const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, i);
+		supported = ext && strcmp(ext, "GL_ARB_buffer_storage") == 0;
+	}
+
+	s_bufferStorage = supported ? (BufferStorageProc)load("glBufferStorage") : NULL;
+}
+
+StreamBuffer::StreamBuffer()
+{
+	m_target = GL_ARRAY_BUFFER;
+	m_buffer = 0;
+	m_regionSize = 0;
+	m_numRegions = 0;
+	m_region = 0;
+	m_numWaits = 0;
+	m_mapped = NULL;
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	Destroy();
+}
+
+bool StreamBuffer::Create(GLenum target, size_t regionSize, int numRegions, bool allowPersistent)
+{
+	Destroy();
+	m_target = target;
+	m_regionSize = (regionSize + STREAM_REGION_ALIGN - 1) / STREAM_REGION_ALIGN * STREAM_REGION_ALIGN;
+	if (m_regionSize == 0)
+	{
+		m_regionSize = STREAM_REGION_ALIGN;
+	}
+	m_numRegions = numRegions > 0 ? numRegions : 1;
+	m_region = 0;
+	m_numWaits = 0;
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(m_target, m_buffer);
+
+	if (allowPersistent && s_bufferStorage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		GLsizeiptr size = (GLsizeiptr)(m_regionSize * m_numRegions);
+		s_bufferStorage(m_target, size, NULL, flags);
+		m_mapped = (char*)glMapBufferRange(m_target, 0, size, flags);
+		if (m_mapped)
+		{
+			m_fences.assign(m_numRegions, (GLsync)NULL);
+			return true;
+		}
+		//storage made with glBufferStorage can't be respecified, start over
+		glDeleteBuffers(1, &m_buffer);
+		glGenBuffers(1, &m_buffer);
+		glBindBuffer(m_target, m_buffer);
+	}
+
+	//one region is enough, orphaning gives the driver the rotation
+	m_numRegions = 1;
+	//clear errors left by earlier calls (or a failed persistent mapping) so
+	//only glBufferData's own is checked.  GL keeps at most one per kind, the
+	//bound is in case there is no context to clear them.
+	for (int i = 0; i < 16 && glGetError() != GL_NO_ERROR; i++)
+	{
+	}
+	glBufferData(m_target, m_regionSize, NULL, GL_STREAM_DRAW);
+	m_staging.resize(m_regionSize);
+	return glGetError() == GL_NO_ERROR;
+}
+
+void StreamBuffer::Destroy()
+{
+	for (size_t i = 0; i < m_fences.size(); i++)
+	{
+		if (m_fences[i])
+		{
+			glDeleteSync(m_fences[i]);
+		}
+	}
+	m_fences.clear();
+	if (m_mapped)
+	{
+		glBindBuffer(m_target, m_buffer);
+		glUnmapBuffer(m_target);
+		m_mapped = NULL;
+	}
+	if (m_buffer)
+	{
+		glDeleteBuffers(1, &m_buffer);
+		m_buffer = 0;
+	}
+	m_staging.clear();
+}
+
+void* StreamBuffer::Begin()
+{
+	if (!m_mapped)
+	{
+		return m_staging.data();
+	}
+
+	GLsync fence = m_fences[m_region];
+	if (fence)
+	{
+		//the first poll doesn't flush, if it isn't done yet flush and block
+		if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+		{
+			m_numWaits++;
+			while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+			{
+			}
+		}
+		glDeleteSync(fence);
+		m_fences[m_region] = NULL;
+	}
+	return m_mapped + m_region * m_regionSize;
+}
+
+size_t StreamBuffer::End(size_t bytesWritten)
+{
+	if (m_mapped)
+	{
+		//coherent mapping, the writes are seen by commands issued from now on
+		return m_region * m_regionSize;
+	}
+
+	glBindBuffer(m_target, m_buffer);
+	glBufferData(m_target, m_regionSize, NULL, GL_STREAM_DRAW);
+	glBufferSubData(m_target, 0, bytesWritten, m_staging.data());
+	return 0;
+}
+
+void StreamBuffer::Fence()
+{
+	if (m_mapped)
+	{
+		m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_region = (m_region + 1) % m_numRegions;
+	}
+}
+
+void* StreamBuffer::GetRegion(int region)
+{
+	return m_mapped ? m_mapped + region * m_regionSize : NULL;
+}
+
+size_t StreamBuffer::GetRegionOffset(int region)
+{
+	return m_mapped ? region * m_regionSize : 0;
+}
+
+bool StreamBuffer::IsRegionIdle(int region)
+{
+	if (!m_mapped || !m_fences[region])
+	{
+		return true;
+	}
+	//the flush makes sure a pending fence gets there, the zero timeout that
+	//this never waits for it
+	if (glClientWaitSync(m_fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED)
+	{
+		return false;
+	}
+	glDeleteSync(m_fences[region]);
+	m_fences[region] = NULL;
+	return true;
+}
+
+void StreamBuffer::FenceRegion(int region)
+{
+	if (m_mapped)
+	{
+		if (m_fences[region])
+		{
+			glDeleteSync(m_fences[region]);
+		}
+		m_fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+int StreamBuffer::GetNumRegions()
+{
+	return m_numRegions;
+}
+
+GLuint StreamBuffer::GetBuffer()
+{
+	return m_buffer;
+}
+
+size_t StreamBuffer::GetRegionSize()
+{
+	return m_regionSize;
+}
+
+bool StreamBuffer::IsPersistent()
+{
+	return m_mapped != NULL;
+}
+
+int StreamBuffer::GetNumWaits()
+{
+	return m_numWaits;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <stddef.h>
+#include <vector>
+
+//GL buffer for data that is rewritten every frame (bone instances), split
+//into regions that are used round robin so the CPU writes one region while
+//the GPU may still be reading the others.
+//
+//Where glBufferStorage is available the whole buffer is mapped once,
+//persistently and coherently, and Begin hands out a pointer straight into
+//it; a fence per region keeps the CPU from overwriting data the GPU hasn't
+//drawn yet.  Otherwise Begin returns CPU memory and End orphans the buffer
+//and uploads with glBufferSubData, which lets the driver hand out fresh
+//storage instead of stalling.
+//
+//Per frame:
+//	void* dst = stream.Begin();
+//	... write up to GetRegionSize() bytes to dst ...
+//	size_t offset = stream.End(bytesWritten);
+//	... point the attributes at offset in GetBuffer() and draw ...
+//	stream.Fence();
+//
+//On the persistent path a region can also be written by another thread,
+//e.g. the animation thread writing instances with no copy in between.  The
+//caller then hands out regions itself: GetRegion is where to write,
+//IsRegionIdle says (without waiting) whether the GPU is done with it and
+//FenceRegion goes after the draws that read it.
+class StreamBuffer
+{
+public:
+	StreamBuffer();
+	~StreamBuffer();
+
+	//Looks up glBufferStorage (GL 4.4 or ARB_buffer_storage) with the same
+	//loader given to gladLoadGL.  Call once after making the context current;
+	//without it every StreamBuffer uses the glBufferSubData path.
+	static void LoadBufferStorage(GLADloadfunc load);
+
+	//Makes a buffer of numRegions regions of at least regionSize bytes.
+	//allowPersistent = false forces the glBufferSubData path.
+	//Returns false if GL couldn't create or map the buffer.
+	bool Create(GLenum target, size_t regionSize, int numRegions = 3, bool allowPersistent = true);
+	void Destroy();
+
+	//where to write this frame's data, waiting for the GPU first if it is
+	//still reading the region from numRegions frames ago
+	void* Begin();
+	//makes the bytes written since Begin visible to GL and returns their
+	//offset in GetBuffer()
+	size_t End(size_t bytesWritten);
+	//call after the draws that read this frame's region have been issued
+	void Fence();
+
+	//Regions by index, persistent path only (GetRegion is NULL otherwise)
+	void* GetRegion(int region);
+	size_t GetRegionOffset(int region);
+	//true once the draws fenced on region are done.  Never blocks.
+	bool IsRegionIdle(int region);
+	void FenceRegion(int region);
+	int GetNumRegions();
+
+	GLuint GetBuffer();
+	size_t GetRegionSize();
+	bool IsPersistent();
+	//number of times Begin had to wait for the GPU
+	int GetNumWaits();
+
+private:
+	StreamBuffer(const StreamBuffer&);
+	StreamBuffer& operator=(const StreamBuffer&);
+
+	GLenum m_target;
+	GLuint m_buffer;
+	size_t m_regionSize;
+	int m_numRegions;
+	int m_region;
+	int m_numWaits;
+
+	//persistent path: the mapping and one fence per region
+	char* m_mapped;
+	std::vector<GLsync> m_fences;
+
+	//glBufferSubData path: this frame's data before the upload
+	std::vector<char> m_staging;
+};
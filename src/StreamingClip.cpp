@@ -0,0 +1,414 @@
+#include "StreamingClip.h"
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "BVHReader.h"
+#include "BVHTokenizer.h"
+#include "AlignedAlloc.h"
+#include "Trace.h"
+#include "defs.h"
+
+#include <string.h>
+#include <math.h>
+
+//a row offset is kept for every ROW_INDEX_STRIDE rows, the rest are found
+//by scanning on from there
+#define ROW_INDEX_STRIDE 16
+//work done between looks at the playhead
+#define STREAM_DECODE_BATCH 64
+#define STREAM_INDEX_BATCH 1024
+
+StreamingClip::StreamingClip()
+{
+	m_end = NULL;
+	m_inToM = false;
+	m_numDOFs = 0;
+	m_frameStride = 0;
+	m_frameTime = 0;
+	m_numFrames = 0;
+	m_scanPos = NULL;
+	m_scanRows = 0;
+	m_scanDone = false;
+	m_indexedRows = 0;
+	m_indexBytes = 0;
+	m_cursor = NULL;
+	m_cursorFrame = -1;
+	m_window = NULL;
+	m_windowFrames = 0;
+	m_slotFrame = NULL;
+	m_playhead = 0;
+	m_quit = false;
+}
+
+StreamingClip::~StreamingClip()
+{
+	Close();
+}
+
+bool StreamingClip::Open(const char* filename, Skeleton* skel, bool inToM, int windowFrames)
+{
+	Close();
+	if (!m_file.Open(filename))
+	{
+		return false;
+	}
+	const char* begin = m_file.GetData();
+	m_end = begin + m_file.GetSize();
+
+	AnimRec header;
+	BVHReader reader;
+	int numFrames = 0;
+	const char* rows = reader.BuildSkelFromBufferHeader(begin, m_end, skel, &header, inToM, &numFrames);
+	if (rows == NULL || numFrames <= 0)
+	{
+		m_file.Close();
+		return false;
+	}
+
+	m_inToM = inToM;
+	m_numDOFs = header.GetNumDOFs();
+	m_frameStride = header.GetFrameStride();
+	m_frameTime = header.GetFrameTime();
+	m_numFrames = numFrames;
+
+	m_rowIndex.clear();
+	m_indexBytes = m_rowIndex.capacity() * sizeof(const char*);
+	m_scanPos = rows;
+	m_scanRows = 0;
+	m_scanDone = false;
+	m_indexedRows = 0;
+	m_cursor = NULL;
+	m_cursorFrame = -1;
+
+	m_windowFrames = windowFrames < numFrames ? windowFrames : numFrames;
+	if (m_windowFrames < 2) m_windowFrames = 2;
+	m_window = (float*)AlignedAlloc((size_t)m_windowFrames * m_frameStride * sizeof(float));
+	memset(m_window, 0, (size_t)m_windowFrames * m_frameStride * sizeof(float));
+	m_slotFrame = new std::atomic<int>[m_windowFrames];
+	for (int i = 0; i < m_windowFrames; i++)
+	{
+		m_slotFrame[i] = -1;
+	}
+
+	m_playhead = 0;
+	m_quit = false;
+	m_thread = std::thread(&StreamingClip::ThreadLoop, this);
+	return true;
+}
+
+void StreamingClip::Close()
+{
+	if (m_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_wake.notify_all();
+		m_thread.join();
+	}
+	AlignedFree(m_window);
+	m_window = NULL;
+	delete[] m_slotFrame;
+	m_slotFrame = NULL;
+	m_windowFrames = 0;
+	m_rowIndex.clear();
+	m_rowIndex.shrink_to_fit();
+	m_indexBytes = 0;
+	m_numFrames = 0;
+	m_file.Close();
+}
+
+int StreamingClip::GetNumFrames()
+{
+	return m_numFrames;
+}
+
+int StreamingClip::GetNumDOFs()
+{
+	return m_numDOFs;
+}
+
+float StreamingClip::GetFrameTime()
+{
+	return m_frameTime;
+}
+
+int StreamingClip::GetFrameStride()
+{
+	return m_frameStride;
+}
+
+int StreamingClip::GetNumIndexedFrames()
+{
+	return m_indexedRows;
+}
+
+size_t StreamingClip::GetMemoryUsage()
+{
+	//the index is growing on the stream thread, so only its byte count is read
+	return (size_t)m_windowFrames * (m_frameStride * sizeof(float) + sizeof(std::atomic<int>))
+		+ m_indexBytes.load(std::memory_order_relaxed);
+}
+
+void StreamingClip::SetPlayhead(double time)
+{
+	int numFrames = m_numFrames;
+	int frame = m_frameTime > 0 ? (int)(time / m_frameTime) : 0;
+	frame = frame < 0 ? 0 : numFrames > 0 && frame >= numFrames ? numFrames - 1 : frame;
+	if (m_playhead.load(std::memory_order_relaxed) != frame)
+	{
+		//under the lock so the thread can't miss it between checking and waiting
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_playhead = frame;
+		m_wake.notify_one();
+	}
+}
+
+bool StreamingClip::GetFrame(int frame, float* out)
+{
+	if (frame < 0 || frame >= m_numFrames || m_windowFrames == 0)
+	{
+		return false;
+	}
+	int slot = frame % m_windowFrames;
+	if (m_slotFrame[slot].load(std::memory_order_acquire) != frame)
+	{
+		return false;
+	}
+	memcpy(out, m_window + (size_t)slot * m_frameStride, m_numDOFs * sizeof(float));
+	//the thread may have started rewriting the slot while it was copied
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return m_slotFrame[slot].load(std::memory_order_relaxed) == frame;
+}
+
+bool StreamingClip::Sample(double time, float* out)
+{
+	int numFrames = m_numFrames;
+	if (numFrames == 0 || m_numDOFs == 0)
+	{
+		return false;
+	}
+	double pos = m_frameTime > 0 ? time / m_frameTime : 0;
+	double last = numFrames - 1;
+	pos = pos < 0 ? 0 : pos > last ? last : pos;
+	int frame = (int)pos;
+	float weight = (float)(pos - frame);
+	if (weight == 0 || frame + 1 >= numFrames)
+	{
+		return GetFrame(frame, out);
+	}
+
+	//blended straight out of the two slots, then checked like GetFrame
+	int slotA = frame % m_windowFrames;
+	int slotB = (frame + 1) % m_windowFrames;
+	if (m_slotFrame[slotA].load(std::memory_order_acquire) != frame
+		|| m_slotFrame[slotB].load(std::memory_order_acquire) != frame + 1)
+	{
+		return false;
+	}
+	const float* a = m_window + (size_t)slotA * m_frameStride;
+	const float* b = m_window + (size_t)slotB * m_frameStride;
+	for (int i = 0; i < 3 && i < m_numDOFs; i++)
+	{
+		out[i] = a[i] + weight * (b[i] - a[i]);
+	}
+	//angles take the short way round, like AnimRec's sample view
+	const float turn = (float)(2 * PI);
+	for (int i = 3; i < m_numDOFs; i++)
+	{
+		float to = b[i] - turn * floorf((b[i] - a[i]) / turn + 0.5f);
+		out[i] = a[i] + weight * (to - a[i]);
+	}
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return m_slotFrame[slotA].load(std::memory_order_relaxed) == frame
+		&& m_slotFrame[slotB].load(std::memory_order_relaxed) == frame + 1;
+}
+
+int StreamingClip::IndexRows(int maxRows)
+{
+	int found = 0;
+	int numFrames = m_numFrames;
+	while (!m_scanDone && found < maxRows)
+	{
+		if (m_scanPos >= m_end || m_scanRows >= numFrames)
+		{
+			//the file may hold fewer rows than the header says
+			m_scanDone = true;
+			m_numFrames = m_scanRows;
+			break;
+		}
+		const char* rowBegin = m_scanPos;
+		const char* lineEnd = BVHFindLineEnd(rowBegin, m_end);
+		m_scanPos = lineEnd + 1;
+
+		//blank lines are skipped, as in BVHReader
+		const char* p = rowBegin;
+		BVHToken tok;
+		if (!BVHNextToken(p, BVHTrimLineEnd(rowBegin, lineEnd), tok))
+		{
+			continue;
+		}
+		if (m_scanRows % ROW_INDEX_STRIDE == 0)
+		{
+			m_rowIndex.push_back(rowBegin);
+			m_indexBytes.store(m_rowIndex.capacity() * sizeof(const char*), std::memory_order_relaxed);
+		}
+		m_scanRows++;
+		found++;
+	}
+	m_indexedRows.store(m_scanRows, std::memory_order_release);
+	return found;
+}
+
+const char* StreamingClip::FindRow(int frame)
+{
+	if (frame == m_cursorFrame && m_cursor)
+	{
+		return m_cursor;
+	}
+	while (frame >= m_scanRows && !m_scanDone)
+	{
+		int needed = frame + 1 - m_scanRows;
+		IndexRows(needed < STREAM_INDEX_BATCH ? needed : STREAM_INDEX_BATCH);
+	}
+	if (frame >= m_scanRows)
+	{
+		return NULL;
+	}
+
+	//from the nearest indexed row, skip the rest (and any blank lines)
+	const char* row = m_rowIndex[frame / ROW_INDEX_STRIDE];
+	for (int skip = frame % ROW_INDEX_STRIDE; ; )
+	{
+		const char* lineEnd = BVHFindLineEnd(row, m_end);
+		const char* p = row;
+		BVHToken tok;
+		if (BVHNextToken(p, BVHTrimLineEnd(row, lineEnd), tok))
+		{
+			if (skip == 0)
+			{
+				return row;
+			}
+			skip--;
+		}
+		row = lineEnd + 1;
+	}
+}
+
+void StreamingClip::DecodeFrame(int frame)
+{
+	const char* row = FindRow(frame);
+	if (row == NULL)
+	{
+		return;
+	}
+	const char* lineEnd = BVHFindLineEnd(row, m_end);
+	int slot = frame % m_windowFrames;
+	float* dst = m_window + (size_t)slot * m_frameStride;
+
+	m_slotFrame[slot].store(-1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memset(dst, 0, m_numDOFs * sizeof(float));
+	AnimRec::ParseFrame(row, BVHTrimLineEnd(row, lineEnd), dst, m_numDOFs, m_inToM);
+	m_slotFrame[slot].store(frame, std::memory_order_release);
+
+	//the next frame's row usually follows (blank lines are skipped by FindRow
+	//when the cursor isn't used, so only a row that directly follows counts)
+	m_cursor = NULL;
+	m_cursorFrame = -1;
+	const char* next = lineEnd + 1;
+	if (next < m_end)
+	{
+		const char* nextEnd = BVHFindLineEnd(next, m_end);
+		const char* p = next;
+		BVHToken tok;
+		if (BVHNextToken(p, BVHTrimLineEnd(next, nextEnd), tok))
+		{
+			m_cursor = next;
+			m_cursorFrame = frame + 1;
+		}
+	}
+}
+
+int StreamingClip::WindowRank(int frame, int playhead)
+{
+	int numFrames = m_numFrames;
+	int ahead = m_windowFrames - m_windowFrames / 4;
+	int forward = ((frame - playhead) % numFrames + numFrames) % numFrames;
+	if (forward < ahead)
+	{
+		return forward;
+	}
+	int back = ((playhead - frame) % numFrames + numFrames) % numFrames;
+	return back <= m_windowFrames / 4 ? ahead - 1 + back : -1;
+}
+
+int StreamingClip::FillWindow(int playhead, int maxFrames)
+{
+	int numFrames = m_numFrames;
+	if (numFrames == 0)
+	{
+		return 0;
+	}
+	//ahead of the playhead first, then behind it
+	int ahead = m_windowFrames - m_windowFrames / 4;
+	int decoded = 0;
+	for (int k = 0; k < m_windowFrames && decoded < maxFrames; k++)
+	{
+		int offset = k < ahead ? k : ahead - 1 - k;
+		int frame = ((playhead + offset) % numFrames + numFrames) % numFrames;
+		//where the window wraps round the end of the clip two of its frames
+		//can share a slot; the one nearer the playhead keeps it
+		int held = m_slotFrame[frame % m_windowFrames].load(std::memory_order_relaxed);
+		if (held == frame)
+		{
+			continue;
+		}
+		int heldRank = held >= 0 ? WindowRank(held, playhead) : -1;
+		if (heldRank >= 0 && heldRank < k)
+		{
+			continue;
+		}
+		if (frame >= m_scanRows && m_scanDone)
+		{
+			continue;
+		}
+		DecodeFrame(frame);
+		decoded++;
+		if (m_playhead.load(std::memory_order_relaxed) != playhead)
+		{
+			break;
+		}
+	}
+	return decoded;
+}
+
+void StreamingClip::ThreadLoop()
+{
+	TRACE_THREAD_NAME("Stream");
+	for (;;)
+	{
+		int playhead = m_playhead.load();
+		int work;
+		{
+			TRACE_SCOPE("FillWindow");
+			work = FillWindow(playhead, STREAM_DECODE_BATCH);
+		}
+		if (work == 0)
+		{
+			//window full: index the rest of the file so later seeks are quick
+			TRACE_SCOPE("IndexRows");
+			work = IndexRows(STREAM_INDEX_BATCH);
+		}
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_quit)
+		{
+			return;
+		}
+		if (work == 0)
+		{
+			m_wake.wait(lock, [&] { return m_quit || m_playhead.load() != playhead; });
+		}
+	}
+}
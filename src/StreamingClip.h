@@ -0,0 +1,116 @@
+#pragma once
+
+#include "MappedFile.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+class Skeleton;
+
+//Plays a bvh file without reading all of its MOTION block first, for
+//captures too long to hold (or wait for) as an AnimRec.
+//
+//Open maps the file and parses only the hierarchy, so playback can start
+//right away.  A background thread then finds the rows (keeping the offset of
+//every ROW_INDEX_STRIDE-th one) and decodes a window of frames around the
+//playhead into a ring of frame slots, ahead of the playhead first.  The
+//mapping is only read where the window and the row scan are, so the file
+//can be larger than memory; the OS drops pages that aren't used any more.
+//
+//Frames are handed over without locks: a slot holds its frame number, which
+//the thread clears while it rewrites the slot, and readers check it before
+//and after copying.
+class StreamingClip
+{
+public:
+	StreamingClip();
+	~StreamingClip();
+
+	//Reads the hierarchy of filename into skel and starts streaming the
+	//frames (in metres if inToM).  windowFrames frames are kept decoded
+	//around the playhead.  Returns false if the file can't be opened or has
+	//no complete MOTION header.
+	bool Open(const char* filename, Skeleton* skel, bool inToM, int windowFrames = 1024);
+	void Close();
+
+	//frames in the clip, from the header until the row scan reaches the end
+	//of the file and finds out how many there really are
+	int GetNumFrames();
+	int GetNumDOFs();
+	float GetFrameTime();
+	//floats between frames copied out by GetFrame, laid out like
+	//AnimRec::GetFrameData
+	int GetFrameStride();
+	//rows found by the background scan so far
+	int GetNumIndexedFrames();
+
+	//Where playback is: the thread keeps the frames from a quarter of the
+	//window before time to three quarters after it decoded, wrapping round
+	//the end of the clip for looped playback.
+	void SetPlayhead(double time);
+
+	//Copies frame into out (GetNumDOFs() floats) if it is decoded.  Never
+	//waits; returns false if the frame isn't in the window yet.
+	bool GetFrame(int frame, float* out);
+	//the pose at time blended from the frames either side (see AnimRec::Sample),
+	//false if either isn't decoded yet.  out is only written once both are,
+	//but can still come back false and half written if the thread replaced
+	//a frame during the copy, which takes a seek away from it.
+	bool Sample(double time, float* out);
+
+	//bytes of window and row index held (the mapping is not counted)
+	size_t GetMemoryUsage();
+
+private:
+	StreamingClip(const StreamingClip&);
+	StreamingClip& operator=(const StreamingClip&);
+
+	void ThreadLoop();
+	//decodes up to maxFrames missing frames of the window, returns how many
+	int FillWindow(int playhead, int maxFrames);
+	//position of frame in the order FillWindow decodes the window around
+	//playhead, -1 if it is outside the window
+	int WindowRank(int frame, int playhead);
+	//finds up to maxRows more rows, returns how many
+	int IndexRows(int maxRows);
+	//start of the row of frame, scanning further if it hasn't been found yet.
+	//NULL if the file has fewer rows.
+	const char* FindRow(int frame);
+	void DecodeFrame(int frame);
+
+	MappedFile m_file;
+	const char* m_end;
+	bool m_inToM;
+	int m_numDOFs;
+	int m_frameStride;
+	float m_frameTime;
+	std::atomic<int> m_numFrames;
+
+	//row scan, only touched by the background thread (and Open)
+	std::vector<const char*> m_rowIndex;
+	const char* m_scanPos;
+	int m_scanRows;
+	bool m_scanDone;
+	std::atomic<int> m_indexedRows;
+	//bytes m_rowIndex holds, updated after it grows, for GetMemoryUsage
+	std::atomic<size_t> m_indexBytes;
+	//the row after the last one decoded, for decoding runs of frames
+	const char* m_cursor;
+	int m_cursorFrame;
+
+	//m_windowFrames slots of m_frameStride floats, frame f in slot f % count
+	float* m_window;
+	int m_windowFrames;
+	//frame held by each slot, -1 while empty or being written
+	std::atomic<int>* m_slotFrame;
+
+	std::atomic<int> m_playhead;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_quit;
+	std::thread m_thread;
+};
@@ -0,0 +1,221 @@
+#include "ThreadPool.h"
+
+static inline uint64_t PackRange(uint32_t begin, uint32_t end)
+{
+	return ((uint64_t)end << 32) | begin;
+}
+
+static inline uint32_t RangeBegin(uint64_t range)
+{
+	return (uint32_t)range;
+}
+
+static inline uint32_t RangeEnd(uint64_t range)
+{
+	return (uint32_t)(range >> 32);
+}
+
+ThreadPool::ThreadPool(int numThreads)
+{
+	m_job = NULL;
+	m_generation = 0;
+	m_active = 0;
+	m_quit = false;
+
+	if (numThreads <= 0)
+	{
+		numThreads = (int)std::thread::hardware_concurrency();
+		if (numThreads <= 0) numThreads = 1;
+	}
+	m_numThreads = numThreads;
+	m_shares = new Share[numThreads];
+	for (int i = 0; i < numThreads; i++)
+	{
+		m_shares[i].range = 0;
+	}
+
+	//the thread calling Run is thread 0
+	for (int i = 1; i < numThreads; i++)
+	{
+		m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_wake.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	delete[] m_shares;
+}
+
+int ThreadPool::GetNumThreads()
+{
+	return m_numThreads;
+}
+
+ThreadPool& ThreadPool::Shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+bool ThreadPool::PopOwn(int thread, int& task)
+{
+	std::atomic<uint64_t>& share = m_shares[thread].range;
+	uint64_t range = share.load();
+	while (RangeBegin(range) < RangeEnd(range))
+	{
+		if (share.compare_exchange_weak(range, PackRange(RangeBegin(range) + 1, RangeEnd(range))))
+		{
+			task = (int)RangeBegin(range);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ThreadPool::Steal(int thread)
+{
+	for (;;)
+	{
+		//the victim with the most work left
+		int victim = -1;
+		uint64_t victimRange = 0;
+		uint32_t most = 0;
+		for (int i = 1; i < m_numThreads; i++)
+		{
+			int t = (thread + i) % m_numThreads;
+			uint64_t range = m_shares[t].range.load();
+			uint32_t left = RangeEnd(range) - RangeBegin(range);
+			if (RangeBegin(range) < RangeEnd(range) && left > most)
+			{
+				most = left;
+				victim = t;
+				victimRange = range;
+			}
+		}
+		if (victim < 0)
+		{
+			return false;
+		}
+
+		//leave the victim the front half (rounded up), it is working from the front
+		uint32_t begin = RangeBegin(victimRange);
+		uint32_t end = RangeEnd(victimRange);
+		uint32_t mid = begin + (end - begin + 1) / 2;
+		if (mid == end)
+		{
+			mid = begin;
+		}
+		if (m_shares[victim].range.compare_exchange_strong(victimRange, PackRange(begin, mid)))
+		{
+			//only this thread refills its own share, and thieves skip it while it is empty
+			m_shares[thread].range.store(PackRange(mid, end));
+			return true;
+		}
+		//the victim or another thief got there first, look again
+	}
+}
+
+void ThreadPool::Work(Job& job, int thread)
+{
+	int task;
+	for (;;)
+	{
+		while (PopOwn(thread, task))
+		{
+			(*job.task)(task, thread);
+		}
+		if (!Steal(thread))
+		{
+			return;
+		}
+	}
+}
+
+void ThreadPool::Run(int numTasks, const std::function<void(int)>& task)
+{
+	RunWithThreadIndex(numTasks, [&task](int i, int) { task(i); });
+}
+
+void ThreadPool::RunWithThreadIndex(int numTasks, const std::function<void(int task, int thread)>& task)
+{
+	if (numTasks <= 0)
+	{
+		return;
+	}
+	if (numTasks == 1 || m_workers.empty())
+	{
+		for (int i = 0; i < numTasks; i++) task(i, 0);
+		return;
+	}
+
+	std::lock_guard<std::mutex> runLock(m_runMutex);
+
+	//hand every thread an equal share up front
+	for (int t = 0; t < m_numThreads; t++)
+	{
+		uint32_t begin = (uint32_t)((int64_t)numTasks * t / m_numThreads);
+		uint32_t end = (uint32_t)((int64_t)numTasks * (t + 1) / m_numThreads);
+		m_shares[t].range.store(PackRange(begin, end));
+	}
+
+	Job job;
+	job.task = &task;
+	job.numTasks = numTasks;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = &job;
+		m_generation++;
+	}
+	m_wake.notify_all();
+
+	Work(job, 0);
+
+	//stop late workers from picking up the job, then wait for the ones that did
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_job = NULL;
+	m_done.wait(lock, [this] { return m_active == 0; });
+}
+
+void ThreadPool::WorkerLoop(int thread)
+{
+	unsigned int seen = 0;
+	for (;;)
+	{
+		Job* job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&] { return m_quit || m_generation != seen; });
+			if (m_quit)
+			{
+				return;
+			}
+			seen = m_generation;
+			job = m_job;
+			if (job == NULL)
+			{
+				continue;
+			}
+			m_active++;
+		}
+
+		Work(*job, thread);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_active--;
+			if (m_active == 0)
+			{
+				m_done.notify_all();
+			}
+		}
+	}
+}
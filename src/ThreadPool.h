@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+
+//Fixed set of worker threads that run batches of indexed tasks.
+//Run is blocking and the calling thread helps with the work, so a pool
+//with N workers keeps N+1 threads busy.
+//
+//Each thread starts with an equal, contiguous share of the task indices and
+//works through it front to back.  A thread that runs out steals the back
+//half of whichever share still has the most left, so uneven tasks and
+//threads that wake up late even out without a shared queue.
+class ThreadPool
+{
+public:
+	//numThreads is the total number of threads doing work, including the
+	//caller of Run.  0 means one per hardware thread.
+	ThreadPool(int numThreads = 0);
+	~ThreadPool();
+
+	int GetNumThreads();
+
+	//Calls task(i) for every i in [0, numTasks) and returns once they have all
+	//finished.  Tasks must not call Run on the same pool.
+	void Run(int numTasks, const std::function<void(int)>& task);
+
+	//Same as Run, but also passes the index of the thread running the task,
+	//0 to GetNumThreads()-1, so tasks can use per-thread scratch memory.
+	void RunWithThreadIndex(int numTasks, const std::function<void(int task, int thread)>& task);
+
+	//Process wide pool used by the loaders
+	static ThreadPool& Shared();
+
+private:
+	struct Job
+	{
+		const std::function<void(int, int)>* task;
+		int numTasks;
+	};
+
+	//one thread's remaining task indices, begin in the low and end in the high
+	//32 bits so both change in a single compare-and-swap.  Padded so the
+	//shares don't share cache lines.
+	struct alignas(64) Share
+	{
+		std::atomic<uint64_t> range;
+	};
+
+	void WorkerLoop(int thread);
+	void Work(Job& job, int thread);
+	//takes the next index of thread's own share, false if it is empty
+	bool PopOwn(int thread, int& task);
+	//moves the back half of the largest other share into thread's share
+	bool Steal(int thread);
+
+	std::vector<std::thread> m_workers;
+	Share* m_shares;
+	int m_numThreads;
+
+	//serializes concurrent callers of Run
+	std::mutex m_runMutex;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	Job* m_job;
+	unsigned int m_generation;
+	int m_active;
+	bool m_quit;
+};
@@ -0,0 +1,126 @@
+#include "Thumbnails.h"
+#include "SoftRaster.h"
+#include "Link.h"
+#include "BVHReader.h"
+#include <math.h>
+
+//frames looked at when framing the camera
+#define THUMB_FIT_SAMPLES 64
+
+ThumbnailRenderer::ThumbnailRenderer()
+{
+	mat4x4_identity(m_viewProj);
+	Link::MakeBonePyramid(1.0f, m_mesh);
+}
+
+bool ThumbnailRenderer::Load(const char* bvhFile)
+{
+	//files are rendered in parallel, so each one is decoded on its own thread
+	BVHReader reader;
+	reader.SetNumThreads(1);
+	if (!reader.BuildSkelFromFile(bvhFile, &m_skel, &m_rec, false) || m_rec.GetNumFrames() == 0 || m_skel.GetNumLinks() == 0)
+	{
+		return false;
+	}
+	m_skel.AddGeometry();
+	m_instances = std::vector<mat4x4>(m_skel.GetNumBones() > 0 ? m_skel.GetNumBones() : 1);
+	m_verts.resize(m_instances.size() * 12);
+	FitCamera(1.0f);
+	return true;
+}
+
+int ThumbnailRenderer::GetNumFrames()
+{
+	return m_rec.GetNumFrames();
+}
+
+void ThumbnailRenderer::FitCamera(float aspect)
+{
+	float lo[3] = { 1e30f, 1e30f, 1e30f };
+	float hi[3] = { -1e30f, -1e30f, -1e30f };
+	int numFrames = m_rec.GetNumFrames();
+	int step = numFrames > THUMB_FIT_SAMPLES ? numFrames / THUMB_FIT_SAMPLES : 1;
+	for (int f = 0; f < numFrames; f += step)
+	{
+		m_skel.ComputePose(m_rec.GetFrameData(f));
+		const mat4x4* world = m_skel.GetWorldMatrices();
+		for (int j = 0; j < m_skel.GetNumLinks(); j++)
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				lo[a] = fminf(lo[a], world[j][3][a]);
+				hi[a] = fmaxf(hi[a], world[j][3][a]);
+			}
+		}
+	}
+	if (lo[0] > hi[0])
+	{
+		mat4x4_identity(m_viewProj);
+		return;
+	}
+
+	//square up the x / y extent to the view's shape with a margin around it
+	float cx = 0.5f * (lo[0] + hi[0]);
+	float cy = 0.5f * (lo[1] + hi[1]);
+	float halfW = 0.5f * (hi[0] - lo[0]);
+	float halfH = 0.5f * (hi[1] - lo[1]);
+	if (aspect <= 0.0f) aspect = 1.0f;
+	if (halfW < halfH * aspect) halfW = halfH * aspect;
+	else halfH = halfW / aspect;
+	float margin = 1.1f;
+	halfW = halfW * margin + 1e-3f;
+	halfH = halfH * margin + 1e-3f;
+	float depth = 0.5f * (hi[2] - lo[2]) + 1.0f;
+	float cz = 0.5f * (lo[2] + hi[2]);
+
+	//looking down -z, nearer points have larger z
+	mat4x4_ortho(m_viewProj, cx - halfW, cx + halfW, cy - halfH, cy + halfH, -(cz + depth), -(cz - depth));
+}
+
+void ThumbnailRenderer::RenderFrame(SoftRaster& raster, int frame)
+{
+	if (frame < 0) frame = 0;
+	if (frame >= m_rec.GetNumFrames()) frame = m_rec.GetNumFrames() - 1;
+	m_skel.ComputePose(m_rec.GetFrameData(frame));
+	int numBones = m_skel.GetNumBones();
+	m_skel.CalcBoneInstances(m_skel.GetWorldMatrices(), m_instances.data());
+
+	for (int b = 0; b < numBones; b++)
+	{
+		for (int v = 0; v < 12; v++)
+		{
+			const VERTEX& in = m_mesh[v];
+			VERTEX& out = m_verts[b * 12 + v];
+			vec4 p = { in.x, in.y, in.z, 1.0f };
+			vec4 q;
+			mat4x4_mul_vec4(q, m_instances[b], p);
+			out.x = q[0];
+			out.y = q[1];
+			out.z = q[2];
+			out.r = in.r;
+			out.g = in.g;
+			out.b = in.b;
+		}
+	}
+	raster.DrawTriangles(m_verts.data(), numBones * 12, m_viewProj);
+}
+
+int ThumbnailRenderer::RenderContactSheet(SoftRaster& raster, int cols, int rows)
+{
+	if (cols < 1) cols = 1;
+	if (rows < 1) rows = 1;
+	int cellW = raster.GetWidth() / cols;
+	int cellH = raster.GetHeight() / rows;
+	FitCamera(cellH > 0 ? (float)cellW / cellH : 1.0f);
+
+	int cells = cols * rows;
+	int numFrames = m_rec.GetNumFrames();
+	for (int i = 0; i < cells; i++)
+	{
+		int frame = cells > 1 ? (int)((long long)i * (numFrames - 1) / (cells - 1)) : 0;
+		raster.SetViewport((i % cols) * cellW, (i / cols) * cellH, cellW, cellH);
+		RenderFrame(raster, frame);
+	}
+	raster.SetViewport(0, 0, raster.GetWidth(), raster.GetHeight());
+	return cells;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Skeleton.h"
+#include "AnimRec.h"
+#include "defs.h"
+#include "linmath.h"
+#include <vector>
+
+class SoftRaster;
+
+//Renders the bones of a clip with SoftRaster, for previews made without a
+//display: single frames or contact sheets of frames spread over the clip.
+//The geometry is the player's, the unit bone pyramid placed by
+//Skeleton::CalcBoneInstances, seen from the front with an orthographic
+//camera that frames the whole clip.
+class ThumbnailRenderer
+{
+public:
+	ThumbnailRenderer();
+
+	//Loads a bvh file on the calling thread without writing a motion cache
+	//next to it.  Returns false if it has no frames.
+	bool Load(const char* bvhFile);
+
+	int GetNumFrames();
+
+	//aims the camera at everything the clip reaches, for views of the
+	//given width / height
+	void FitCamera(float aspect);
+
+	//draws frame into the raster's current viewport
+	void RenderFrame(SoftRaster& raster, int frame);
+
+	//Splits the raster into cols x rows cells and draws frames spread evenly
+	//from the first to the last, left to right and top to bottom.  Fits the
+	//camera to the cell shape.  Returns the number of frames drawn.
+	int RenderContactSheet(SoftRaster& raster, int cols, int rows);
+
+private:
+	ThumbnailRenderer(const ThumbnailRenderer&);
+	ThumbnailRenderer& operator=(const ThumbnailRenderer&);
+
+	Skeleton m_skel;
+	AnimRec m_rec;
+	mat4x4 m_viewProj;
+	VERTEX m_mesh[12];
+	std::vector<mat4x4> m_instances;
+	std::vector<VERTEX> m_verts;
+};
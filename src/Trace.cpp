@@ -0,0 +1,181 @@
+#include "Trace.h"
+
+#ifdef BVH_TRACE
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <stdio.h>
+
+struct TraceEvent
+{
+	const char* name;
+	uint64_t start;
+	uint64_t end;
+};
+
+//One thread's events.  Only that thread writes to it; head counts every
+//event it ever recorded, event i being at events[i % TRACE_RING_EVENTS], and
+//is published after the event is written.
+struct TraceRing
+{
+	std::atomic<uint64_t> head;
+	std::atomic<const char*> threadName;
+	int tid;
+	TraceEvent events[TRACE_RING_EVENTS];
+};
+
+static_assert((TRACE_RING_EVENTS & (TRACE_RING_EVENTS - 1)) == 0, "TRACE_RING_EVENTS must be a power of two");
+
+//every ring made so far.  They are never freed, so the events of threads
+//that have finished still make it into the trace.
+static std::mutex s_ringsMutex;
+static std::vector<TraceRing*> s_rings;
+std::atomic<bool> g_traceEnabled(true);
+
+static thread_local TraceRing* t_ring = NULL;
+
+//a tick count and the steady clock read together when the first ring is
+//made, to get the tick rate from at export
+static uint64_t s_calibrationTicks;
+static std::chrono::steady_clock::time_point s_calibrationTime;
+
+static TraceRing* GetRing()
+{
+	if (t_ring == NULL)
+	{
+		TraceRing* ring = new TraceRing;
+		ring->head = 0;
+		ring->threadName = NULL;
+		std::lock_guard<std::mutex> lock(s_ringsMutex);
+		if (s_rings.empty())
+		{
+			s_calibrationTicks = TraceNow();
+			s_calibrationTime = std::chrono::steady_clock::now();
+		}
+		ring->tid = (int)s_rings.size() + 1;
+		s_rings.push_back(ring);
+		t_ring = ring;
+	}
+	return t_ring;
+}
+
+void TraceSetEnabled(bool enabled)
+{
+	g_traceEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void TraceRecord(const char* name, uint64_t start, uint64_t end)
+{
+	TraceRing* ring = GetRing();
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+	TraceEvent& e = ring->events[head & (TRACE_RING_EVENTS - 1)];
+	e.name = name;
+	e.start = start;
+	e.end = end;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void TraceSetThreadName(const char* name)
+{
+	GetRing()->threadName.store(name, std::memory_order_relaxed);
+}
+
+uint64_t TraceEventCount()
+{
+	std::lock_guard<std::mutex> lock(s_ringsMutex);
+	uint64_t count = 0;
+	for (size_t i = 0; i < s_rings.size(); i++)
+	{
+		count += s_rings[i]->head.load(std::memory_order_acquire);
+	}
+	return count;
+}
+
+bool TraceWriteJSON(const char* filename)
+{
+	std::vector<TraceRing*> rings;
+	uint64_t calibrationTicks;
+	std::chrono::steady_clock::time_point calibrationTime;
+	{
+		std::lock_guard<std::mutex> lock(s_ringsMutex);
+		rings = s_rings;
+		calibrationTicks = s_calibrationTicks;
+		calibrationTime = s_calibrationTime;
+	}
+	if (rings.empty())
+	{
+		calibrationTicks = TraceNow();
+		calibrationTime = std::chrono::steady_clock::now();
+	}
+
+	//ticks per microsecond, over at least 10 ms so the rate is good to a few
+	//parts per million
+	double elapsedUs;
+	uint64_t ticks;
+	for (;;)
+	{
+		ticks = TraceNow();
+		elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - calibrationTime).count();
+		if (elapsedUs >= 10000.0) break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	double ticksPerUs = (double)(ticks - calibrationTicks) / elapsedUs;
+
+	//copy what each ring holds, then drop the oldest events if the owner
+	//wrapped around onto them while they were being copied
+	std::vector<std::vector<TraceEvent> > events(rings.size());
+	uint64_t base = UINT64_MAX;
+	for (size_t r = 0; r < rings.size(); r++)
+	{
+		TraceRing* ring = rings[r];
+		uint64_t end = ring->head.load(std::memory_order_acquire);
+		uint64_t begin = end > TRACE_RING_EVENTS ? end - TRACE_RING_EVENTS : 0;
+		std::vector<TraceEvent> copy;
+		copy.reserve((size_t)(end - begin));
+		for (uint64_t i = begin; i < end; i++)
+		{
+			copy.push_back(ring->events[i & (TRACE_RING_EVENTS - 1)]);
+		}
+		//the event being written now overwrites index head - TRACE_RING_EVENTS
+		uint64_t after = ring->head.load(std::memory_order_acquire);
+		uint64_t firstIntact = after >= TRACE_RING_EVENTS ? after - TRACE_RING_EVENTS + 1 : 0;
+		size_t skip = firstIntact > begin ? (size_t)(firstIntact - begin) : 0;
+		if (skip > copy.size()) skip = copy.size();
+		events[r].assign(copy.begin() + skip, copy.end());
+		for (size_t i = 0; i < events[r].size(); i++)
+		{
+			if (events[r][i].start < base) base = events[r][i].start;
+		}
+	}
+
+	FILE* file = fopen(filename, "wb");
+	if (file == NULL)
+	{
+		return false;
+	}
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first = true;
+	for (size_t r = 0; r < rings.size(); r++)
+	{
+		const char* threadName = rings[r]->threadName.load(std::memory_order_relaxed);
+		if (threadName != NULL)
+		{
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", rings[r]->tid, threadName);
+			first = false;
+		}
+		for (size_t i = 0; i < events[r].size(); i++)
+		{
+			const TraceEvent& e = events[r][i];
+			fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+				first ? "" : ",\n", e.name, rings[r]->tid, (e.start - base) / ticksPerUs, (e.end - e.start) / ticksPerUs);
+			first = false;
+		}
+	}
+	fprintf(file, "\n]}\n");
+	return fclose(file) == 0;
+}
+
+#endif
@@ -0,0 +1,102 @@
+#pragma once
+
+//Scoped timers for finding out where a frame's time goes, written out as
+//Chrome trace JSON for chrome://tracing or ui.perfetto.dev.
+//
+//Only compiled in when BVH_TRACE is defined (configure with -DBVH_TRACE=ON).
+//Without it the macros expand to nothing and none of this exists in the
+//binary.  With it, a TRACE_SCOPE costs two clock reads and one store into
+//the calling thread's own ring buffer; there are no locks or allocations
+//after a thread's first event.
+//
+//   void Skeleton::UpdateLinks()
+//   {
+//       TRACE_SCOPE("UpdateLinks");
+//       ...
+//
+//Names must be string literals (or otherwise live as long as the process),
+//only the pointer is kept.
+
+#ifdef BVH_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define TRACE_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRACE_RDTSC 1
+#endif
+
+//events kept per thread, the oldest are overwritten
+#define TRACE_RING_EVENTS (1 << 16)
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) TraceSetThreadName(name)
+#define TRACE_WRITE(filename) TraceWriteJSON(filename)
+
+//Timestamp in ticks: the time stamp counter on x86, a few times cheaper to
+//read than the steady clock, and nanoseconds on the steady clock elsewhere.
+//TraceWriteJSON converts ticks to time.
+static inline uint64_t TraceNow()
+{
+#ifdef TRACE_RDTSC
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//adds a complete event to the calling thread's ring buffer
+void TraceRecord(const char* name, uint64_t start, uint64_t end);
+
+//Recording can be paused at run time, e.g. to measure its cost; a paused
+//TRACE_SCOPE is one relaxed load and a branch.  On by default.
+void TraceSetEnabled(bool enabled);
+extern std::atomic<bool> g_traceEnabled;
+
+//events recorded so far by all threads, including ones since overwritten
+uint64_t TraceEventCount();
+
+//names the calling thread in the trace
+void TraceSetThreadName(const char* name);
+
+//Writes the events of every thread that recorded any as Chrome trace JSON.
+//Can be called at any time from any thread, the others keep recording.
+//Returns false if the file couldn't be written.
+bool TraceWriteJSON(const char* filename);
+
+class TraceScope
+{
+public:
+	TraceScope(const char* name)
+	{
+		m_name = g_traceEnabled.load(std::memory_order_relaxed) ? name : NULL;
+		m_start = m_name != NULL ? TraceNow() : 0;
+	}
+	~TraceScope()
+	{
+		if (m_name != NULL)
+		{
+			TraceRecord(m_name, m_start, TraceNow());
+		}
+	}
+
+private:
+	const char* m_name;
+	uint64_t m_start;
+};
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#define TRACE_WRITE(filename) (false)
+
+#endif
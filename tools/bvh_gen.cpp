@@ -0,0 +1,127 @@
+// bvh_gen.cpp : writes synthetic bvh files for scale and stress testing with
+// BVHGenerator.  The same options and seed always give the same file.
+//
+// usage: bvh_gen [options] out.bvh
+//   -n N      joints, end sites not counted (default 100)
+//   -b N      children per hub of the spine: N - 1 chains and the next hub,
+//             1 for a single chain (default 8)
+//   -c N      joints per chain (default 4)
+//   -f N      frames (default 100)
+//   -m MB     pick the number of frames for a file of about MB megabytes
+//   -r FPS    frame rate (default 30)
+//   -s SEED   seed (default 1)
+//   -o ORDERS channel orders: bvh (ZXY), taitbryan or all (the 12 Euler
+//             orders) (default bvh)
+//   -6 F      share of non-root joints with 6 channels (default 0).  BVHReader
+//             refuses positions below the root, so the player can't load
+//             files written with anything above 0.
+//   -d N      digits after the decimal point (default 4)
+//   -j N      threads, 0 for one per hardware thread (default 0)
+
+#include "BVHGenerator.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void PrintUsage()
+{
+	printf("usage: bvh_gen [options] out.bvh\n");
+	printf("  -n N      joints, end sites not counted (default 100)\n");
+	printf("  -b N      children per hub: N - 1 chains and the next hub, 1 for a single chain (default 8)\n");
+	printf("  -c N      joints per chain (default 4)\n");
+	printf("  -f N      frames (default 100)\n");
+	printf("  -m MB     pick the number of frames for a file of about MB megabytes\n");
+	printf("  -r FPS    frame rate (default 30)\n");
+	printf("  -s SEED   seed (default 1)\n");
+	printf("  -o ORDERS channel orders: bvh (ZXY), taitbryan or all (default bvh)\n");
+	printf("  -6 F      share of non-root joints with 6 channels (default 0, the player loads\n");
+	printf("            positions on the root only)\n");
+	printf("  -d N      digits after the decimal point (default 4)\n");
+	printf("  -j N      threads, 0 for one per hardware thread (default 0)\n");
+}
+
+int main(int argc, char** argv)
+{
+	BVHGeneratorSettings settings;
+	double targetMB = 0;
+	int threads = 0;
+	const char* out = NULL;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(arg, "-n") == 0 && hasValue) settings.numJoints = atoi(argv[++i]);
+		else if (strcmp(arg, "-b") == 0 && hasValue) settings.branching = atoi(argv[++i]);
+		else if (strcmp(arg, "-c") == 0 && hasValue) settings.chainLength = atoi(argv[++i]);
+		else if (strcmp(arg, "-f") == 0 && hasValue) settings.numFrames = atoi(argv[++i]);
+		else if (strcmp(arg, "-m") == 0 && hasValue) targetMB = atof(argv[++i]);
+		else if (strcmp(arg, "-r") == 0 && hasValue) settings.frameRate = atof(argv[++i]);
+		else if (strcmp(arg, "-s") == 0 && hasValue) settings.seed = (uint32_t)strtoul(argv[++i], NULL, 10);
+		else if (strcmp(arg, "-6") == 0 && hasValue) settings.sixChannelFraction = atof(argv[++i]);
+		else if (strcmp(arg, "-d") == 0 && hasValue) settings.decimals = atoi(argv[++i]);
+		else if (strcmp(arg, "-j") == 0 && hasValue) threads = atoi(argv[++i]);
+		else if (strcmp(arg, "-o") == 0 && hasValue)
+		{
+			const char* orders = argv[++i];
+			if (strcmp(orders, "bvh") == 0) settings.channelOrders = GEN_ORDERS_BVH;
+			else if (strcmp(orders, "taitbryan") == 0) settings.channelOrders = GEN_ORDERS_TAIT_BRYAN;
+			else if (strcmp(orders, "all") == 0) settings.channelOrders = GEN_ORDERS_ALL;
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (arg[0] == '-' || out != NULL)
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			out = arg;
+		}
+	}
+	if (out == NULL)
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (settings.sixChannelFraction > 0)
+	{
+		fprintf(stderr, "warning: -6 %g gives joints below the root position channels, which BVHReader won't load\n",
+			settings.sixChannelFraction);
+	}
+
+	if (targetMB > 0)
+	{
+		//size of a row from a sample of them
+		const int sampleFrames = 64;
+		BVHGenerator sizer(settings);
+		std::string rows;
+		sizer.AppendFrames(0, sampleFrames, rows);
+		double rowBytes = (double)rows.size() / sampleFrames;
+		double frames = (targetMB * 1024.0 * 1024.0 - sizer.GetHeader().size()) / rowBytes;
+		settings.numFrames = frames < 1 ? 1 : frames > 2e9 ? 2000000000 : (int)frames;
+	}
+
+	ThreadPool pool(threads);
+	BVHGenerator generator(settings);
+	auto start = std::chrono::steady_clock::now();
+	uint64_t bytes = generator.WriteFile(out, &pool);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (bytes == 0)
+	{
+		fprintf(stderr, "could not write %s\n", out);
+		return 1;
+	}
+	double mb = bytes / (1024.0 * 1024.0);
+	printf("%s: %d joints, %d dofs, %d frames, %.1f MB in %.3f s on %d threads: %.1f MB/s\n", out,
+		generator.GetNumJoints(), generator.GetNumDOFs(), settings.numFrames, mb, seconds, pool.GetNumThreads(),
+		seconds > 0 ? mb / seconds : 0);
+	return 0;
+}
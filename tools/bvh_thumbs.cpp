@@ -0,0 +1,190 @@
+// bvh_thumbs.cpp : renders bvh files without a display.  Every file becomes a
+// contact sheet of frames spread over the clip, or a run of single frame
+// PNGs, drawn by SoftRaster.  Files are spread over a ThreadPool, one file
+// per task, and the throughput is reported per thread.
+//
+// usage: bvh_thumbs [-o dir] [-s WxH] [-g CxR] [-f N] [-j N] file.bvh ...
+//   -o dir   where the PNGs go (default: next to each file)
+//   -s WxH   size of one frame in pixels (default 160x160)
+//   -g CxR   contact sheet of C columns and R rows (default 4x3)
+//   -f N     write N single frames as <name>_0000.png ... instead of a sheet
+//   -j N     threads, 0 for one per hardware thread (default 0)
+
+#include "Thumbnails.h"
+#include "SoftRaster.h"
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct ThumbOptions
+{
+	std::string outDir;
+	int width = 160;
+	int height = 160;
+	int cols = 4;
+	int rows = 3;
+	int singleFrames = 0;
+	int threads = 0;
+};
+
+static void PrintUsage()
+{
+	printf("usage: bvh_thumbs [-o dir] [-s WxH] [-g CxR] [-f N] [-j N] file.bvh ...\n");
+	printf("  -o dir   where the PNGs go (default: next to each file)\n");
+	printf("  -s WxH   size of one frame in pixels (default 160x160)\n");
+	printf("  -g CxR   contact sheet of C columns and R rows (default 4x3)\n");
+	printf("  -f N     write N single frames instead of a contact sheet\n");
+	printf("  -j N     threads, 0 for one per hardware thread (default 0)\n");
+}
+
+//output path without extension: outDir (or the file's own directory) plus
+//the file name without .bvh
+static std::string OutputStem(const std::string& file, const std::string& outDir)
+{
+	size_t slash = file.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? file : file.substr(slash + 1);
+	size_t dot = name.find_last_of('.');
+	if (dot != std::string::npos)
+	{
+		name = name.substr(0, dot);
+	}
+	if (outDir.empty())
+	{
+		return slash == std::string::npos ? name : file.substr(0, slash + 1) + name;
+	}
+	char last = outDir[outDir.size() - 1];
+	return last == '/' || last == '\\' ? outDir + name : outDir + "/" + name;
+}
+
+//renders one file, returns the number of frames drawn or -1 on failure
+static int RenderFile(const std::string& file, const ThumbOptions& opt)
+{
+	ThumbnailRenderer thumbs;
+	if (!thumbs.Load(file.c_str()))
+	{
+		return -1;
+	}
+	std::string stem = OutputStem(file, opt.outDir);
+
+	if (opt.singleFrames > 0)
+	{
+		SoftRaster raster(opt.width, opt.height);
+		thumbs.FitCamera((float)opt.width / opt.height);
+		int numFrames = thumbs.GetNumFrames();
+		int count = opt.singleFrames < numFrames ? opt.singleFrames : numFrames;
+		char suffix[32];
+		for (int i = 0; i < count; i++)
+		{
+			int frame = count > 1 ? (int)((long long)i * (numFrames - 1) / (count - 1)) : 0;
+			raster.Clear(255, 255, 255);
+			thumbs.RenderFrame(raster, frame);
+			snprintf(suffix, sizeof(suffix), "_%04d.png", frame);
+			if (!raster.WritePNG((stem + suffix).c_str()))
+			{
+				return -1;
+			}
+		}
+		return count;
+	}
+
+	SoftRaster raster(opt.width * opt.cols, opt.height * opt.rows);
+	raster.Clear(255, 255, 255);
+	int drawn = thumbs.RenderContactSheet(raster, opt.cols, opt.rows);
+	return raster.WritePNG((stem + "_sheet.png").c_str()) ? drawn : -1;
+}
+
+static bool ParsePair(const char* text, int& a, int& b)
+{
+	return sscanf(text, "%dx%d", &a, &b) == 2 && a > 0 && b > 0;
+}
+
+int main(int argc, char** argv)
+{
+	ThumbOptions opt;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (strcmp(arg, "-o") == 0 && hasValue)
+		{
+			opt.outDir = argv[++i];
+		}
+		else if (strcmp(arg, "-s") == 0 && hasValue)
+		{
+			if (!ParsePair(argv[++i], opt.width, opt.height))
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (strcmp(arg, "-g") == 0 && hasValue)
+		{
+			if (!ParsePair(argv[++i], opt.cols, opt.rows))
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (strcmp(arg, "-f") == 0 && hasValue)
+		{
+			opt.singleFrames = atoi(argv[++i]);
+		}
+		else if (strcmp(arg, "-j") == 0 && hasValue)
+		{
+			opt.threads = atoi(argv[++i]);
+		}
+		else if (arg[0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else
+		{
+			files.push_back(arg);
+		}
+	}
+	if (files.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	//the loaders report progress on std::cout, which is only noise here
+	std::cout.setstate(std::ios::failbit);
+
+	ThreadPool pool(opt.threads);
+	int numThreads = pool.GetNumThreads();
+	std::vector<int> drawn(files.size());
+	std::atomic<long long> totalFrames(0);
+	auto start = std::chrono::steady_clock::now();
+	pool.Run((int)files.size(), [&](int i) {
+		drawn[i] = RenderFile(files[i], opt);
+		if (drawn[i] > 0)
+		{
+			totalFrames += drawn[i];
+		}
+	});
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	int failed = 0;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (drawn[i] < 0)
+		{
+			fprintf(stderr, "could not render %s\n", files[i].c_str());
+			failed++;
+		}
+	}
+	double fps = seconds > 0 ? totalFrames / seconds : 0;
+	printf("%d files, %lld frames of %dx%d in %.3f s on %d threads: %.1f fps, %.1f fps per thread\n",
+		(int)files.size() - failed, (long long)totalFrames, opt.width, opt.height, seconds, numThreads, fps, fps / numThreads);
+	return failed == 0 ? 0 : 1;
+}